@@ -0,0 +1,92 @@
+#!/usr/bin/env python
+#
+
+"""
+call-overhead.py: measure the cost of calling the Context query
+methods themselves (argument parsing, the cache lookup and making
+the Result) by timing lookups that are all answered from the
+response cache, so that no query goes to getdns.
+
+Each pattern makes `count' calls per domain, and we report the
+mean time per call in nanoseconds.  Run it against two builds to
+compare them:
+
+    $ call-overhead.py -n 200000 www.example.com
+    pattern                     calls   nsec/call
+    general(name, type)        200000       612.4
+    general(name=, type=)      200000       701.9
+    ...
+
+"""
+
+import getdns, sys, getopt, time
+
+
+def usage():
+    print("""\
+Usage: call-overhead.py [-n count] [-s] <domain1> <domain2> ...
+
+    -n: number of calls per domain for each pattern (default 100000)
+    -s: use stub resolution rather than full recursion
+""")
+    sys.exit(1)
+
+
+A = getdns.RRTYPE_A
+SRV = getdns.RRTYPE_SRV
+
+patterns = [
+    ('general(name, type)', lambda ctx, d: ctx.general(d, A)),
+    ('general(name=, type=)', lambda ctx, d: ctx.general(name=d, request_type=A)),
+    ('address(name)', lambda ctx, d: ctx.address(d)),
+    ('address(name=)', lambda ctx, d: ctx.address(name=d)),
+    ('service(name)', lambda ctx, d: ctx.service(d)),
+]
+if hasattr(getdns, 'ADDRESS_MODE_PACKED'):
+    PACKED = getdns.ADDRESS_MODE_PACKED
+    patterns.append(('address(name, mode=)', lambda ctx, d: ctx.address(d, mode=PACKED)))
+EXTENSIONS = { 'dnssec_return_status': getdns.EXTENSION_TRUE,
+               'return_both_v4_and_v6': getdns.EXTENSION_TRUE }
+patterns.append(('general(..., dict)', lambda ctx, d: ctx.general(d, A, EXTENSIONS)))
+if hasattr(getdns, 'Extensions'):
+    PREPARED = getdns.Extensions(EXTENSIONS)
+    patterns.append(('general(..., Extensions)', lambda ctx, d: ctx.general(d, A, PREPARED)))
+
+
+def run(ctx, call, domains, count):
+    for domain in domains:      # fill the cache
+        call(ctx, domain)
+    clock = getattr(time, 'perf_counter', time.time)
+    start = clock()
+    for i in range(count):
+        for domain in domains:
+            call(ctx, domain)
+    return (clock() - start) * 1e9 / (count * len(domains))
+
+
+try:
+    (options, args) = getopt.getopt(sys.argv[1:], 'n:s')
+except getopt.GetoptError:
+    usage()
+else:
+    if not args:
+        usage()
+
+count = 100000
+stub = False
+
+for (opt, optval) in options:
+    if opt == "-n":
+        count = int(optval)
+    elif opt == "-s":
+        stub = True
+
+ctx = getdns.Context()
+if stub:
+    ctx.resolution_type = getdns.RESOLUTION_STUB
+ctx.cache_size = 1000
+
+print("pattern                     calls   nsec/call")
+for (name, call) in patterns:
+    print("{0:24s}  {1:8d}  {2:10.1f}".format(name, count * len(args),
+                                            run(ctx, call, args, count)))
@@ -0,0 +1,119 @@
+#!/usr/bin/env python
+#
+
+"""
+convert-bench.py: measure the converters in pygetdns_util.c that
+turn getdns dicts into Python objects, one at a time and without a
+resolver in the way.
+
+The responses are read from responses.json (alongside this script,
+or given with -f), in getdns response form with each bindata written
+as {"bindata": "<hex>"}, and are rebuilt as getdns dicts before
+timing starts.  For each response we time
+
+    gdict_to_pdict   the whole response dict
+    glist_to_plist   the response's replies_tree
+    convertBinData   each bindata in the response, one at a time
+
+and report nanoseconds and Python allocations per operation
+(allocations are counted on Python 3.5 and later only, and don't
+include anything getdns allocates itself).  For example:
+
+    $ convert-bench.py -n 300
+    response    converter           ops      ns/op  allocs/op
+    A           gdict_to_pdict       300    72216.0      180.3
+    A           glist_to_plist       300    67902.4      157.0
+    A           convertBinData      8100      243.3        1.4
+    ...
+"""
+
+import getdns, sys, os, getopt, json, binascii, time, platform
+
+
+def usage():
+    print("""\
+Usage: convert-bench.py [-n iterations] [-r responses] [-c converters] [-f file] [-o file]
+
+    -n: iterations of each converter per response (default 1000)
+    -r: comma-separated response names (default all in the file)
+    -c: comma-separated converters, from gdict_to_pdict, glist_to_plist
+        and convertBinData (default all)
+    -f: read the responses from this file (default responses.json)
+    -o: write the results as JSON to this file
+""")
+    sys.exit(1)
+
+
+converters = [ 'gdict_to_pdict', 'glist_to_plist', 'convertBinData' ]
+
+
+def decode(value):
+    """turn {"bindata": "<hex>"} back into bytes, recursively"""
+    if isinstance(value, dict):
+        if list(value.keys()) == [ 'bindata' ]:
+            return binascii.unhexlify(value['bindata'])
+        return dict((k, decode(v)) for (k, v) in value.items())
+    if isinstance(value, list):
+        return [ decode(v) for v in value ]
+    return value
+
+
+try:
+    (options, args) = getopt.getopt(sys.argv[1:], 'n:r:c:f:o:')
+except getopt.GetoptError:
+    usage()
+if args:
+    usage()
+
+iterations = 1000
+names = None
+use = converters
+filename = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'responses.json')
+output = None
+
+for (opt, optval) in options:
+    if opt == "-n":
+        iterations = int(optval)
+    elif opt == "-r":
+        names = optval.split(',')
+    elif opt == "-c":
+        use = optval.split(',')
+    elif opt == "-f":
+        filename = optval
+    elif opt == "-o":
+        output = optval
+for name in use:
+    if name not in converters:
+        usage()
+
+with open(filename) as f:
+    responses = dict((k, decode(v)) for (k, v) in json.load(f).items())
+if names is None:
+    names = sorted(responses.keys())
+
+results = []
+print("response    converter           ops      ns/op  allocs/op")
+for name in names:
+    for converter in use:
+        r = getdns._bench_converter(converter, responses[name], iterations)
+        entry = { 'response': name,
+                  'converter': converter,
+                  'ops': r['ops'],
+                  'ns_per_op': round(r['ns'] / float(r['ops']), 1),
+                  'allocs_per_op': None if r['allocs'] is None else round(r['allocs'] / float(r['ops']), 1) }
+        results.append(entry)
+        print("{0:10s}  {1:15s}  {2:7d}  {3:9.1f}  {4:>9s}".format(
+            name, converter, entry['ops'], entry['ns_per_op'],
+            '-' if entry['allocs_per_op'] is None else '%.1f' % entry['allocs_per_op']))
+
+if output:
+    report = { 'benchmark': 'convert-bench',
+               'timestamp': time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime()),
+               'bindings_version': getdns.__version__,
+               'python': platform.python_version(),
+               'platform': platform.platform(),
+               'iterations': iterations,
+               'results': results }
+    with open(output, 'w') as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+        f.write('\n')
@@ -0,0 +1,213 @@
+#!/usr/bin/env python
+#
+
+"""
+dnsresponder.py: a small authoritative DNS responder for benchmarking,
+answering over UDP and TCP on 127.0.0.1 from a synthetic zone, so that
+results don't depend on the network or on someone else's resolver.
+
+The zone is bench.test:
+
+    h<N>.bench.test     A     10.<N / 65536>.<N / 256 % 256>.<N % 256>
+                        AAAA  fd00::<N>
+                        MX    10 mx.bench.test
+                        TXT   "bench <N>"
+    anything else       NXDOMAIN, with the zone's SOA in authority
+
+Names outside the zone are REFUSED.  Run it by hand with
+
+    $ dnsresponder.py -p 5353
+
+or start it from another script with start_responder(), which runs it
+in a child process and returns (process, port).
+"""
+
+import socket, struct, sys, getopt, threading, multiprocessing
+
+ZONE = (b'bench', b'test')
+TTL = 300
+
+TYPE_A = 1
+TYPE_SOA = 6
+TYPE_MX = 15
+TYPE_TXT = 16
+TYPE_AAAA = 28
+
+RCODE_NXDOMAIN = 3
+RCODE_REFUSED = 5
+
+
+def encode_name(labels):
+    return b''.join(struct.pack('!B', len(l)) + l for l in labels) + b'\0'
+
+
+SOA_RDATA = (encode_name((b'ns',) + ZONE) + encode_name((b'hostmaster',) + ZONE) +
+             struct.pack('!IIIII', 1, 3600, 600, 86400, TTL))
+MX_RDATA = struct.pack('!H', 10) + encode_name((b'mx',) + ZONE)
+
+
+def parse_query(msg):
+    """return (id, flags, labels, qtype, question), or None"""
+    if len(msg) < 17:
+        return None
+    (qid, flags, qdcount) = struct.unpack('!HHH', msg[:6])
+    if qdcount != 1:
+        return None
+    pos = 12
+    labels = []
+    while True:
+        n = bytearray(msg[pos:pos + 1])[0]
+        pos += 1
+        if n == 0:
+            break
+        labels.append(msg[pos:pos + n].lower())
+        pos += n
+    (qtype,) = struct.unpack('!H', msg[pos:pos + 2])
+    return (qid, flags, labels, qtype, msg[12:pos + 4])
+
+
+def host_number(labels):
+    if len(labels) != 3 or tuple(labels[1:]) != ZONE or not labels[0].startswith(b'h'):
+        return None
+    try:
+        return int(labels[0][1:])
+    except ValueError:
+        return None
+
+
+def rdata_for(n, qtype):
+    if qtype == TYPE_A:
+        return [ struct.pack('!BBBB', 10, (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff) ]
+    if qtype == TYPE_AAAA:
+        return [ b'\xfd' + b'\0' * 11 + struct.pack('!I', n) ]
+    if qtype == TYPE_MX:
+        return [ MX_RDATA ]
+    if qtype == TYPE_TXT:
+        text = ('bench %d' % n).encode('ascii')
+        return [ struct.pack('!B', len(text)) + text ]
+    return []
+
+
+def answer(msg):
+    query = parse_query(msg)
+    if query is None:
+        return None
+    (qid, flags, labels, qtype, question) = query
+    rcode = 0
+    answers = []
+    authority = []
+    n = host_number(labels)
+    if tuple(labels[-2:]) != ZONE:
+        rcode = RCODE_REFUSED
+    elif n is None:
+        rcode = RCODE_NXDOMAIN
+        authority = [ encode_name(ZONE) + struct.pack('!HHIH', TYPE_SOA, 1, TTL, len(SOA_RDATA)) +
+                      SOA_RDATA ]
+    else:
+        answers = [ struct.pack('!HHHIH', 0xc00c, qtype, 1, TTL, len(rdata)) + rdata
+                    for rdata in rdata_for(n, qtype) ]
+        if not answers:
+            authority = [ encode_name(ZONE) + struct.pack('!HHIH', TYPE_SOA, 1, TTL, len(SOA_RDATA)) +
+                          SOA_RDATA ]
+    flags = 0x8400 | (flags & 0x0100) | rcode      # QR, AA, copy RD
+    header = struct.pack('!HHHHHH', qid, flags, 1, len(answers), len(authority), 0)
+    return header + question + b''.join(answers) + b''.join(authority)
+
+
+def serve_udp(sock):
+    while True:
+        (msg, addr) = sock.recvfrom(4096)
+        try:
+            reply = answer(msg)
+        except Exception:
+            reply = None
+        if reply is not None:
+            sock.sendto(reply, addr)
+
+
+def recv_exactly(conn, n):
+    data = b''
+    while len(data) < n:
+        chunk = conn.recv(n - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+
+def serve_tcp_connection(conn):
+    try:
+        while True:
+            length = recv_exactly(conn, 2)
+            if length is None:
+                break
+            msg = recv_exactly(conn, struct.unpack('!H', length)[0])
+            if msg is None:
+                break
+            reply = answer(msg)
+            if reply is not None:
+                conn.sendall(struct.pack('!H', len(reply)) + reply)
+    except (socket.error, ValueError, IndexError, struct.error):
+        pass
+    conn.close()
+
+
+def serve_tcp(sock):
+    while True:
+        (conn, addr) = sock.accept()
+        t = threading.Thread(target=serve_tcp_connection, args=(conn,))
+        t.daemon = True
+        t.start()
+
+
+def bind(port):
+    """bind UDP and TCP sockets to the same port on 127.0.0.1"""
+    while True:
+        udp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        udp.bind(('127.0.0.1', port))
+        tcp = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        tcp.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        try:
+            tcp.bind(('127.0.0.1', udp.getsockname()[1]))
+        except socket.error:
+            udp.close()
+            tcp.close()
+            if port:
+                raise
+            continue
+        tcp.listen(128)
+        return (udp, tcp)
+
+
+def serve(udp, tcp):
+    t = threading.Thread(target=serve_tcp, args=(tcp,))
+    t.daemon = True
+    t.start()
+    serve_udp(udp)
+
+
+def start_responder(port=0):
+    """run the responder in a child process; returns (process, port)"""
+    (udp, tcp) = bind(port)
+    port = udp.getsockname()[1]
+    proc = multiprocessing.get_context('fork').Process(target=serve, args=(udp, tcp))
+    proc.daemon = True
+    proc.start()
+    udp.close()
+    tcp.close()
+    return (proc, port)
+
+
+if __name__ == '__main__':
+    port = 5353
+    try:
+        (options, args) = getopt.getopt(sys.argv[1:], 'p:')
+    except getopt.GetoptError:
+        print("Usage: dnsresponder.py [-p port]")
+        sys.exit(1)
+    for (opt, optval) in options:
+        if opt == '-p':
+            port = int(optval)
+    (udp, tcp) = bind(port)
+    print("answering for bench.test on 127.0.0.1 port %d" % port)
+    serve(udp, tcp)
@@ -0,0 +1,102 @@
+#!/usr/bin/env python
+#
+
+"""
+result-access.py: measure what it costs to read a Result, by access
+pattern.  Results are converted from the getdns response lazily, one
+attribute at a time, so a caller that only wants the addresses never
+pays for building replies_full and replies_tree.
+
+Lookups are made up front and aren't counted.  Each access pattern
+then gets its own fresh set of results, and we report the CPU time
+per result and the Python memory retained per result (as seen by
+tracemalloc) once the attributes have been read.
+
+An example run:
+
+    $ result-access.py -n 500 www.example.com www.example.org
+    pattern     results  usec/result  bytes/result
+    status         1000         1.16            32
+    address        1000        14.06           718
+    wire           1000         3.02            32
+    full           1000       278.14         11654
+
+"""
+
+import getdns, sys, getopt, time, tracemalloc
+
+
+def usage():
+    print("""\
+Usage: result-access.py [-n count] [-s] <domain1> <domain2> ...
+
+    -n: number of lookups of each domain per access pattern (default 200)
+    -s: use stub resolution rather than full recursion
+""")
+    sys.exit(1)
+
+
+def read_status(r):
+    r.status
+
+def read_address(r):
+    r.status
+    r.just_address_answers
+
+def read_wire(r):
+    r.status
+    len(r.wire)
+
+def read_records(r):
+    r.status
+    r.records(getdns.RRTYPE_A)
+
+def read_full(r):
+    r.status
+    r.answer_type
+    r.canonical_name
+    r.just_address_answers
+    r.replies_tree
+    r.replies_full
+    r.validation_chain
+
+patterns = [ ('status', read_status), ('address', read_address), ('wire', read_wire),
+             ('records', read_records), ('full', read_full) ]
+
+
+try:
+    (options, args) = getopt.getopt(sys.argv[1:], 'n:s')
+except getopt.GetoptError:
+    usage()
+else:
+    if not args:
+        usage()
+
+count = 200
+stub = False
+
+for (opt, optval) in options:
+    if opt == "-n":
+        count = int(optval)
+    elif opt == "-s":
+        stub = True
+
+ctx = getdns.Context()
+if stub:
+    ctx.resolution_type = getdns.RESOLUTION_STUB
+
+print("pattern     results  usec/result  bytes/result")
+for (name, read) in patterns:
+    results = [ ctx.address(name=domain) for i in range(count) for domain in args ]
+    tracemalloc.start()
+    before = tracemalloc.get_traced_memory()[0]
+    start = time.time()
+    for r in results:
+        read(r)
+    elapsed = time.time() - start
+    retained = tracemalloc.get_traced_memory()[0] - before
+    tracemalloc.stop()
+    n = len(results)
+    print("{0:10s}  {1:7d}  {2:11.2f}  {3:12d}".format(name, n, elapsed * 1e6 / n,
+                                                       retained // n))
+    del results
@@ -0,0 +1,290 @@
+#!/usr/bin/env python
+#
+
+"""
+stub-bench.py: measure query throughput and latency in stub mode
+against a local responder (see dnsresponder.py), which is started on
+127.0.0.1 for the duration of the run, so that results are repeatable
+and comparable between releases.
+
+Three ways of using the bindings are measured, each over UDP and TCP
+and at several concurrency levels:
+
+    sync      <concurrency> threads, each with its own Context,
+              making synchronous Context.general() calls
+    callback  one Context with <concurrency> callback-style queries
+              outstanding, each completion issuing the next, driven
+              by Context.run()
+    bulk      Context.bulk() over batches of queries, with
+              concurrency=<concurrency>.  Latencies are per batch
+    resolver  Resolver.bulk() over the same batches, spread over
+              <workers> threads with <concurrency> queries
+              outstanding on each.  Latencies are per batch
+
+Results are written as JSON, one entry per (mode, transport,
+concurrency) with the queries per second and the p50, p99 and p99.9
+latencies in microseconds.  The suite needs Python 3.4 or later.
+For example:
+
+    $ stub-bench.py -n 5000 -c 1,16 -o bench-0.3.1.json
+    mode      transport  concurrency  queries   errors        qps   p50 usec   p99 usec
+    sync      udp                  1     5000        0     5821.4      167.2      251.9
+    sync      udp                 16     5000        0    14893.1      994.0     2310.5
+    ...
+"""
+
+import getdns, sys, getopt, json, time, threading, platform, multiprocessing
+from dnsresponder import start_responder
+
+# threading.Barrier, time.perf_counter() and the responder's
+# multiprocessing contexts all need Python 3
+if sys.version_info < (3, 4):
+    sys.exit("stub-bench.py needs Python 3.4 or later")
+
+
+def usage():
+    print("""\
+Usage: stub-bench.py [-n count] [-c concurrency] [-m modes] [-t transports]
+                     [-b batch] [-w workers] [-N names] [-p port] [-o file]
+
+    -n: number of queries per measurement (default 2000)
+    -c: comma-separated concurrency levels (default 1,8,64)
+    -m: comma-separated modes, from sync, callback, bulk and resolver
+        (default all)
+    -t: comma-separated transports, from udp and tcp (default both)
+    -b: queries per Context.bulk() or Resolver.bulk() call (default 500)
+    -w: Resolver worker threads (default one per CPU)
+    -N: number of distinct names queried (default 1000)
+    -p: use a responder already listening on this port rather
+        than starting one
+    -o: write the JSON results to this file rather than stdout
+""")
+    sys.exit(1)
+
+
+transports = { 'udp': getdns.TRANSPORT_UDP, 'tcp': getdns.TRANSPORT_TCP }
+
+
+def settings(port, transport):
+    return { 'resolution_type': getdns.RESOLUTION_STUB,
+             'upstream_recursive_servers': [ { 'address_type': 'IPv4',
+                                               'address_data': '127.0.0.1',
+                                               'port': port } ],
+             'dns_transport_list': [ transports[transport] ] }
+
+
+def make_context(port, transport):
+    ctx = getdns.Context()
+    for (name, value) in settings(port, transport).items():
+        setattr(ctx, name, value)
+    ctx.general('h0.bench.test', getdns.RRTYPE_A)   # warm up
+    return ctx
+
+
+def query_names(start, count, n_names):
+    return [ 'h%d.bench.test' % ((start + i) % n_names) for i in range(count) ]
+
+
+def failed(result):
+    return result is None or result.status != getdns.RESPSTATUS_GOOD
+
+
+def bench_sync(port, transport, concurrency, count, n_names, batch):
+    per_thread = count // concurrency
+    contexts = [ make_context(port, transport) for i in range(concurrency) ]
+    latencies = []
+    errors = [ 0 ]
+    lock = threading.Lock()
+    barrier = threading.Barrier(concurrency + 1)
+
+    def worker(ctx, names):
+        mine = []
+        bad = 0
+        barrier.wait()
+        for name in names:
+            start = time.perf_counter()
+            try:
+                if failed(ctx.general(name, getdns.RRTYPE_A)):
+                    bad += 1
+            except getdns.error:
+                bad += 1
+            mine.append(time.perf_counter() - start)
+        with lock:
+            latencies.extend(mine)
+            errors[0] += bad
+
+    threads = [ threading.Thread(target=worker,
+                                 args=(contexts[i], query_names(i * per_thread, per_thread, n_names)))
+                for i in range(concurrency) ]
+    for t in threads:
+        t.start()
+    barrier.wait()
+    start = time.perf_counter()
+    for t in threads:
+        t.join()
+    return (time.perf_counter() - start, latencies, errors[0])
+
+
+def bench_callback(port, transport, concurrency, count, n_names, batch):
+    ctx = make_context(port, transport)
+    names = query_names(0, count, n_names)
+    latencies = []
+    state = { 'next': 0, 'errors': 0 }
+
+    def submit():
+        name = names[state['next']]
+        state['next'] += 1
+        ctx.general(name, getdns.RRTYPE_A, userarg=time.perf_counter(), callback=callback)
+
+    def callback(cb_type, result, started, tid):
+        latencies.append(time.perf_counter() - started)
+        if cb_type != getdns.CALLBACK_COMPLETE or failed(result):
+            state['errors'] += 1
+        if state['next'] < len(names):
+            submit()
+
+    start = time.perf_counter()
+    for i in range(min(concurrency, len(names))):
+        submit()
+    ctx.run()
+    return (time.perf_counter() - start, latencies, state['errors'] + len(names) - len(latencies))
+
+
+def bench_bulk(port, transport, concurrency, count, n_names, batch):
+    ctx = make_context(port, transport)
+    latencies = []
+    errors = 0
+    start = time.perf_counter()
+    for first in range(0, count, batch):
+        queries = [ (name, getdns.RRTYPE_A)
+                    for name in query_names(first, min(batch, count - first), n_names) ]
+        batch_start = time.perf_counter()
+        results = ctx.bulk(queries, concurrency=concurrency)
+        latencies.append(time.perf_counter() - batch_start)
+        errors += sum(1 for r in results if failed(r))
+    return (time.perf_counter() - start, latencies, errors)
+
+
+def bench_resolver(port, transport, concurrency, count, n_names, batch):
+    resolver = getdns.Resolver(workers=workers, concurrency=concurrency,
+                               **settings(port, transport))
+    resolver.bulk([ ('h0.bench.test', getdns.RRTYPE_A) ] * resolver.workers)   # warm up
+    latencies = []
+    errors = 0
+    start = time.perf_counter()
+    for first in range(0, count, batch):
+        queries = [ (name, getdns.RRTYPE_A)
+                    for name in query_names(first, min(batch, count - first), n_names) ]
+        batch_start = time.perf_counter()
+        results = resolver.bulk(queries)
+        latencies.append(time.perf_counter() - batch_start)
+        errors += sum(1 for r in results if failed(r))
+    elapsed = time.perf_counter() - start
+    resolver.close()
+    return (elapsed, latencies, errors)
+
+
+modes = { 'sync': bench_sync, 'callback': bench_callback, 'bulk': bench_bulk,
+          'resolver': bench_resolver }
+
+
+def percentile(ordered, p):
+    if not ordered:
+        return None
+    return round(ordered[min(len(ordered) - 1, int(p * len(ordered)))] * 1e6, 1)
+
+
+try:
+    (options, args) = getopt.getopt(sys.argv[1:], 'n:c:m:t:b:w:N:p:o:')
+except getopt.GetoptError:
+    usage()
+if args:
+    usage()
+
+count = 2000
+levels = [ 1, 8, 64 ]
+mode_names = [ 'sync', 'callback', 'bulk', 'resolver' ]
+transport_names = [ 'udp', 'tcp' ]
+batch = 500
+workers = 0
+n_names = 1000
+port = None
+output = None
+
+for (opt, optval) in options:
+    if opt == "-n":
+        count = int(optval)
+    elif opt == "-c":
+        levels = [ int(c) for c in optval.split(',') ]
+    elif opt == "-m":
+        mode_names = optval.split(',')
+    elif opt == "-t":
+        transport_names = optval.split(',')
+    elif opt == "-b":
+        batch = int(optval)
+    elif opt == "-w":
+        workers = int(optval)
+    elif opt == "-N":
+        n_names = int(optval)
+    elif opt == "-p":
+        port = int(optval)
+    elif opt == "-o":
+        output = optval
+for name in mode_names:
+    if name not in modes:
+        usage()
+for name in transport_names:
+    if name not in transports:
+        usage()
+
+responder = None
+if port is None:
+    (responder, port) = start_responder()
+
+results = []
+sys.stderr.write("mode      transport  concurrency  queries   errors        qps   p50 usec   p99 usec\n")
+for mode in mode_names:
+    for transport in transport_names:
+        for concurrency in levels:
+            (elapsed, latencies, errors) = modes[mode](port, transport, concurrency, count,
+                                                       n_names, batch)
+            latencies.sort()
+            queries = count if mode != 'sync' else (count // concurrency) * concurrency
+            entry = { 'mode': mode,
+                      'transport': transport,
+                      'concurrency': concurrency,
+                      'queries': queries,
+                      'errors': errors,
+                      'seconds': round(elapsed, 6),
+                      'qps': round(queries / elapsed, 1),
+                      'latency': 'batch' if mode in ('bulk', 'resolver') else 'query',
+                      'p50_usec': percentile(latencies, 0.5),
+                      'p99_usec': percentile(latencies, 0.99),
+                      'p999_usec': percentile(latencies, 0.999) }
+            results.append(entry)
+            sys.stderr.write("{mode:8s}  {transport:9s}  {concurrency:11d}  {queries:7d}  {errors:7d}  "
+                             "{qps:9.1f}  {p50_usec:9.1f}  {p99_usec:9.1f}\n".format(**entry))
+
+if responder is not None:
+    responder.terminate()
+
+ctx = getdns.Context()
+report = { 'benchmark': 'stub-bench',
+           'timestamp': time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime()),
+           'bindings_version': getdns.__version__,
+           'getdns_version': ctx.version_string,
+           'getdns_implementation': ctx.implementation_string,
+           'python': platform.python_version(),
+           'platform': platform.platform(),
+           'queries_per_run': count,
+           'names': n_names,
+           'bulk_batch': batch,
+           'resolver_workers': workers or multiprocessing.cpu_count(),
+           'results': results }
+if output:
+    with open(output, 'w') as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+        f.write('\n')
+else:
+    json.dump(report, sys.stdout, indent=2, sort_keys=True)
+    sys.stdout.write('\n')
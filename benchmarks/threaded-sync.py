@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+#
+
+"""
+threaded-sync.py: measure synchronous lookup throughput as the number
+of Python threads grows.  Each thread owns its own getdns.Context and
+issues Context.address() calls back to back; since the bindings drop
+the GIL for the network round-trip, throughput should scale past 1x
+until the upstream resolver becomes the bottleneck.
+
+An example run:
+
+    $ threaded-sync.py -n 200 -t 1,2,4,8 www.example.com www.example.org
+    threads  queries  seconds      qps  scale
+          1      400    4.112     97.3   1.00
+          2      800    4.207    190.2   1.95
+          4     1600    4.301    372.0   3.82
+          8     3200    4.508    709.8   7.30
+
+"""
+
+import getdns, sys, getopt, threading, time
+
+
+def usage():
+    print("""\
+Usage: threaded-sync.py [-n count] [-t threads] [-s] <domain1> <domain2> ...
+
+    -n: number of passes over the domain list made by each thread (default 100)
+    -t: comma-separated list of thread counts to try (default 1,2,4,8)
+    -s: use stub resolution rather than full recursion
+""")
+    sys.exit(1)
+
+
+class StartGate(object):
+    """
+    Holds the workers until all of them and the timing thread have
+    arrived, like threading.Barrier (which Python 2 doesn't have)
+    """
+    def __init__(self, parties):
+        self.waiting = parties
+        self.cond = threading.Condition()
+
+    def wait(self):
+        with self.cond:
+            self.waiting -= 1
+            if self.waiting == 0:
+                self.cond.notify_all()
+            while self.waiting > 0:
+                self.cond.wait()
+
+
+def worker(names, passes, stub, barrier, errors):
+    ctx = getdns.Context()
+    if stub:
+        ctx.resolution_type = getdns.RESOLUTION_STUB
+    barrier.wait()
+    for i in range(passes):
+        for name in names:
+            try:
+                ctx.address(name=name)
+            except getdns.error:
+                errors.append(name)
+
+
+def run(nthreads, names, passes, stub):
+    errors = []
+    barrier = StartGate(nthreads + 1)
+    threads = [ threading.Thread(target=worker, args=(names, passes, stub, barrier, errors))
+                for i in range(nthreads) ]
+    for t in threads:
+        t.start()
+    barrier.wait()
+    start = time.time()
+    for t in threads:
+        t.join()
+    elapsed = time.time() - start
+    return (nthreads * passes * len(names) - len(errors), elapsed)
+
+
+try:
+    (options, args) = getopt.getopt(sys.argv[1:], 'n:t:s')
+except getopt.GetoptError:
+    usage()
+else:
+    if not args:
+        usage()
+
+passes = 100
+thread_counts = [ 1, 2, 4, 8 ]
+stub = False
+
+for (opt, optval) in options:
+    if opt == "-n":
+        passes = int(optval)
+    elif opt == "-t":
+        thread_counts = [ int(n) for n in optval.split(',') ]
+    elif opt == "-s":
+        stub = True
+
+base_qps = None
+print("threads  queries  seconds      qps  scale")
+for nthreads in thread_counts:
+    (queries, elapsed) = run(nthreads, args, passes, stub)
+    qps = queries / elapsed
+    if base_qps is None:
+        base_qps = qps / nthreads
+    print("{0:7d}  {1:7d}  {2:7.3f}  {3:7.1f}  {4:5.2f}".format(nthreads, queries, elapsed,
+                                                              qps, qps / base_qps))
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <Python.h>
+#include <getdns/getdns.h>
+#include "pygetdns.h"
+
+/*
+ * Bindata objects are what convertBinData() returns for opaque
+ * binary data (keys, signatures, digests, raw rdata and so on).
+ * They point straight into the getdns response the data came
+ * from and expose it through the buffer protocol, holding a
+ * reference to the response (see result_keeper()) so that it
+ * outlives them.  Data that didn't come from a Result, such as
+ * context settings, is copied, and freed with the Bindata.
+ */
+
+PyObject *
+bindata_create(getdns_bindata *data, PyObject *keeper)
+{
+    getdns_BindataObject *self;
+
+    if ((self = PyObject_New(getdns_BindataObject, &getdns_BindataType)) == NULL)
+        return NULL;
+    self->size = (Py_ssize_t)data->size;
+    if (keeper)  {
+        Py_INCREF(keeper);
+        self->keeper = keeper;
+        self->data = data->data;
+    }  else  {
+        self->keeper = 0;
+        if ((self->data = (uint8_t *)PyMem_Malloc(data->size ? data->size : 1)) == NULL)  {
+            PyObject_Del(self);
+            return PyErr_NoMemory();
+        }
+        memcpy(self->data, data->data, data->size);
+    }
+    return (PyObject *)self;
+}
+
+
+void
+bindata_dealloc(getdns_BindataObject *self)
+{
+    if (self->keeper)
+        Py_DECREF(self->keeper);
+    else
+        PyMem_Free(self->data);
+    PyObject_Del(self);
+}
+
+
+int
+bindata_getbuffer(getdns_BindataObject *self, Py_buffer *view, int flags)
+{
+    return PyBuffer_FillInfo(view, (PyObject *)self, self->data, self->size, 1, flags);
+}
+
+
+Py_ssize_t
+bindata_length(getdns_BindataObject *self)
+{
+    return self->size;
+}
+
+
+PyObject *
+bindata_item(getdns_BindataObject *self, Py_ssize_t i)
+{
+    if (i < 0 || i >= self->size)  {
+        PyErr_SetString(PyExc_IndexError, "Bindata index out of range");
+        return NULL;
+    }
+#if PY_MAJOR_VERSION >= 3
+    return PyLong_FromLong((long)self->data[i]);
+#else
+    return PyInt_FromLong((long)self->data[i]);
+#endif
+}
+
+
+PyObject *
+bindata_tobytes(getdns_BindataObject *self, PyObject *unused)
+{
+    return PyBytes_FromStringAndSize((char *)self->data, self->size);
+}
+
+
+PyObject *
+bindata_hex(getdns_BindataObject *self, PyObject *unused)
+{
+    static const char digits[] = "0123456789abcdef";
+    PyObject *hex;
+    char *p;
+    Py_ssize_t i;
+
+#if PY_MAJOR_VERSION >= 3
+    if ((hex = PyUnicode_New(self->size * 2, 127)) == NULL)
+        return NULL;
+    p = (char *)PyUnicode_DATA(hex);
+#else
+    if ((hex = PyString_FromStringAndSize(NULL, self->size * 2)) == NULL)
+        return NULL;
+    p = PyString_AS_STRING(hex);
+#endif
+    for (i = 0 ; i < self->size ; i++)  {
+        *p++ = digits[self->data[i] >> 4];
+        *p++ = digits[self->data[i] & 0xf];
+    }
+    return hex;
+}
+
+
+/*
+ * Bindata compares equal to anything else holding the same
+ * bytes, as the memoryviews it replaces did
+ */
+
+PyObject *
+bindata_richcompare(PyObject *self, PyObject *other, int op)
+{
+    getdns_BindataObject *me = (getdns_BindataObject *)self;
+    Py_buffer view;
+    int equal;
+
+    if ((op != Py_EQ && op != Py_NE) || !PyObject_CheckBuffer(other))  {
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+    if (PyObject_GetBuffer(other, &view, PyBUF_SIMPLE) < 0)  {
+        PyErr_Clear();
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+    equal = view.len == me->size && !memcmp(view.buf, me->data, (size_t)me->size);
+    PyBuffer_Release(&view);
+    if (equal == (op == Py_EQ))
+        Py_RETURN_TRUE;
+    Py_RETURN_FALSE;
+}
+
+
+/* the same as hash(bytes(self)), so Bindata and bytes mix in sets */
+
+Py_hash_t
+bindata_hash(getdns_BindataObject *self)
+{
+    PyObject *bytes;
+    Py_hash_t hash;
+
+    if ((bytes = bindata_tobytes(self, NULL)) == NULL)
+        return -1;
+    hash = PyObject_Hash(bytes);
+    Py_DECREF(bytes);
+    return hash;
+}
+
+
+PyObject *
+bindata_repr(getdns_BindataObject *self)
+{
+    PyObject *hex;
+    PyObject *repr;
+
+    if ((hex = bindata_hex(self, NULL)) == NULL)
+        return NULL;
+#if PY_MAJOR_VERSION >= 3
+    repr = PyUnicode_FromFormat("<getdns.Bindata %U>", hex);
+#else
+    repr = PyString_FromFormat("<getdns.Bindata %s>", PyString_AS_STRING(hex));
+#endif
+    Py_DECREF(hex);
+    return repr;
+}
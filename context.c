@@ -30,6 +30,7 @@
 #include <arpa/inet.h>
 #include <event2/event.h>
 #include <getdns/getdns_ext_libevent.h>
+#include <getdns/getdns_extra.h>
 #include <sys/wait.h>
 #include "pygetdns.h"
 
@@ -58,10 +59,26 @@ context_init(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
         PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
         return -1;
     }
+    if ((self->lock = PyThread_allocate_lock()) == NULL)  {
+        getdns_context_destroy(context);
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        return -1;
+    }
+    if ((self->stats = context_stats_new()) == NULL)  {
+        PyThread_free_lock(self->lock);
+        self->lock = 0;
+        getdns_context_destroy(context);
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        return -1;
+    }
+    self->trace_sample = 1.0;
+    self->trace_random = (uint64_t)(size_t)self ^ context_stats_now();
+    if (self->trace_random == 0)
+        self->trace_random = 1;
     py_context = PyCapsule_New(context, "context", 0);
     Py_INCREF(py_context);
     self->py_context = py_context;
-    return 0;
+    return context_update_settings(self, context);
 }
 
 
@@ -76,7 +93,24 @@ context_dealloc(getdns_ContextObject *self)
     }
     Py_XDECREF(self->py_context);
     getdns_context_destroy(context);
-    (void)wait(&status);        /* reap the process spun off by unbound */
+    if (self->lock)
+        PyThread_free_lock(self->lock);
+    context_stats_free(self->stats);    /* after the cancellation callbacks */
+    Py_XDECREF(self->trace_hook);
+    Py_XDECREF(self->batch);
+    context_cache_free(self);
+    Py_XDECREF(self->inflight);
+    Py_XDECREF(self->suffix);
+    Py_XDECREF(self->namespaces);
+    Py_XDECREF(self->dns_root_servers);
+    Py_XDECREF(self->dnssec_trust_anchors);
+    Py_XDECREF(self->upstream_recursive_servers);
+    Py_XDECREF(self->dns_transport_list);
+    PyMem_Free(self->implementation_string);
+    PyMem_Free(self->version_string);
+    (void)waitpid(-1, &status, WNOHANG); /* reap the process spun off by unbound, */
+                                /* without hanging if some other child */
+                                /* of ours is still running */
                                 /* TODO: this has just been fixed in unbound and */
                                 /* this wait() should be removed once the new */
                                 /* libunbound is distributed */
@@ -796,306 +830,218 @@ context_set_dns_transport_list(getdns_context *context, PyObject *py_value)
 }
             
 
-PyObject *
-context_getattro(PyObject *self, PyObject *nameobj)
+/*
+ * The context's settings are mirrored in the Context object
+ * so that reading an attribute goes through the generic getattr
+ * path rather than back to getdns_context_get_api_information().
+ * context_update_settings() refreshes them, and is called when
+ * the context is created and after each successful setattr.
+ */
+
+static int
+update_string(char **slot, getdns_dict *dict, char *name)
+{
+    getdns_bindata *bindata;
+    char *value;
+
+    if (getdns_dict_get_bindata(dict, name, &bindata) != GETDNS_RETURN_GOOD)
+        return 0;
+    if ((value = (char *)PyMem_Malloc(bindata->size + 1)) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        return -1;
+    }
+    memcpy(value, bindata->data, bindata->size);
+    value[bindata->size] = 0;
+    PyMem_Free(*slot);
+    *slot = value;
+    return 0;
+}
+
+
+/* settings don't belong to a Result, so any bindata is copied */
+
+static PyObject *
+settings_list(getdns_list *list)
+{
+    return glist_to_plist(list, NULL);
+}
+
+
+static int
+update_list(PyObject **slot, getdns_dict *dict, char *name,
+            PyObject *(*convert)(getdns_list *))
+{
+    getdns_list *list;
+    PyObject *value = 0;
+
+    if (getdns_dict_get_list(dict, name, &list) == GETDNS_RETURN_GOOD)  {
+        if ((value = convert(list)) == NULL)
+            return -1;
+    }
+    Py_XDECREF(*slot);
+    *slot = value;
+    return 0;
+}
+
+
+int
+context_update_settings(getdns_ContextObject *self, getdns_context *context)
 {
-    getdns_ContextObject *myself = (getdns_ContextObject *)self;
-    struct getdns_context *context;
     getdns_dict *api_info;
     getdns_dict *all_context;
+    getdns_transport_list_t *transports = 0;
+    size_t transport_count = 0;
+    PyObject *py_transports;
+    PyObject *item;
+    uint64_t idle_timeout = 0;
+    uint32_t value;
     getdns_return_t ret;
-    char *attrname;
+    int i;
 
-#if PY_MAJOR_VERSION >= 3
-    attrname = PyBytes_AsString(PyUnicode_AsEncodedString(PyObject_Str(nameobj), "ascii", NULL));
-#else
-    attrname = PyString_AsString(nameobj);
-#endif
-    context = PyCapsule_GetPointer(myself->py_context, "context");
+    context_lock(self);
     api_info = getdns_context_get_api_information(context);
-    if (!strncmp(attrname, "resolution_type", strlen("resolution_type")))  {
-        uint32_t resolution_type;
-        if ((ret = getdns_dict_get_int(api_info, "resolution_type", &resolution_type)) != GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong((long)resolution_type);
-#else
-        return PyInt_FromLong((long)resolution_type);
-#endif
+    if ((ret = getdns_context_get_idle_timeout(context, &idle_timeout)) == GETDNS_RETURN_GOOD)
+        ret = getdns_context_get_dns_transport_list(context, &transport_count, &transports);
+    context_unlock(self);
+    if (api_info == NULL)  {
+        free(transports);
+        PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
+        return -1;
     }
-    if ((ret = getdns_dict_get_dict(api_info, "all_context", &all_context)) != GETDNS_RETURN_GOOD)  {
+    if (ret == GETDNS_RETURN_GOOD)
+        ret = getdns_dict_get_dict(api_info, "all_context", &all_context);
+    if (ret != GETDNS_RETURN_GOOD)  {
+        free(transports);
+        getdns_dict_destroy(api_info);
         PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-        return NULL;
-    }
-    if (!strncmp(attrname, "implementation_string", strlen("implementation_string")))  {
-        getdns_bindata *implementation_string;
-        if ((ret = getdns_dict_get_bindata(api_info, "implementation_string", &implementation_string)) != GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyUnicode_FromStringAndSize((char *)implementation_string->data,
-                                           (Py_ssize_t)implementation_string->size);
-#else
-        return PyString_FromStringAndSize((char *)implementation_string->data,
-                                          (Py_ssize_t)implementation_string->size);
-#endif
-    }
-    if (!strncmp(attrname, "version_string", strlen("version_string")))  {
-        getdns_bindata *version_string;
-        if ((ret = getdns_dict_get_bindata(api_info, "version_string", &version_string)) != GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyUnicode_FromStringAndSize((char *)version_string->data,
-                                           (Py_ssize_t)version_string->size);
-#else
-        return PyString_FromStringAndSize((char *)version_string->data,
-                                          (Py_ssize_t)version_string->size);
-#endif
-    }
-        
-    if (!strncmp(attrname, "timeout", strlen("timeout")))  {
-        uint32_t timeout;
-        if ((ret = getdns_dict_get_int(all_context, "timeout", &timeout)) != GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-        return PyLong_FromLong((long)timeout);
-    }
-    if (!strncmp(attrname, "idle_timeout", strlen("idle_timeout")))  {
-        uint64_t timeout;
-        if ((ret = getdns_context_get_idle_timeout(context, &timeout)) != GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-        return PyLong_FromLong((long)timeout);
-    }
-    if (!strncmp(attrname, "dns_transport_list", strlen("dns_transport_list")))  {
-        getdns_transport_list_t *transports;
-        PyObject *py_transports;
-        size_t transport_count;
-        int i;
-        if ((ret = getdns_context_get_dns_transport_list(context, &transport_count, &transports)) != 
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-        if ((py_transports = PyList_New((Py_ssize_t)transport_count)) == NULL)  {
-            PyErr_SetString(getdns_error, "Could not create PyList");
-            return NULL;
-        }
-        for ( i = 0 ; i < transport_count ; i++ )  {
-            PyList_SetItem(py_transports, (Py_ssize_t)i, PyLong_FromLong((long)transports[i]));
-        }
-        return py_transports;
-    }
-#if 0
-    if (!strncmp(attrname, "dns_transport", strlen("dns_transport")))  {
-        uint32_t dns_transport;
-        if ((ret = getdns_dict_get_int(all_context, "dns_transport", &dns_transport)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong((long)dns_transport);
-#else
-        return PyInt_FromLong((long)dns_transport);
-#endif
-    }
-#endif    
-    if (!strncmp(attrname, "limit_outstanding_queries", strlen("limit_outstanding_queries")))  {
-        uint32_t limit_outstanding_queries;
-        if ((ret = getdns_dict_get_int(all_context, "limit_outstanding_queries",
-                                       &limit_outstanding_queries)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong(limit_outstanding_queries);
-#else
-        return PyInt_FromLong(limit_outstanding_queries);
-#endif
-    }
-    if (!strncmp(attrname, "follow_redirects", strlen("follow_redirects")))  {
-        uint32_t follow_redirects;
-        if ((ret = getdns_dict_get_int(all_context, "follow_redirects",
-                                       &follow_redirects)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong(follow_redirects);
-#else
-        return PyInt_FromLong(follow_redirects);
-#endif
-    }
-    if (!strncmp(attrname, "append_name", strlen("append_name")))  {
-        uint32_t append_name;
-        if ((ret = getdns_dict_get_int(all_context, "append_name",
-                                       &append_name)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong(append_name);
-#else
-        return PyInt_FromLong(append_name);
-#endif
-    }
-    if (!strncmp(attrname, "dnssec_allowed_skew", strlen("dnssec_allowed_skew")))  {
-        uint32_t dnssec_allowed_skew;
-        if ((ret = getdns_dict_get_int(all_context, "dnssec_allowed_skew", &dnssec_allowed_skew)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong((long)dnssec_allowed_skew);
-#else
-        return PyInt_FromLong((long)dnssec_allowed_skew);
-#endif
-    }
-    if (!strncmp(attrname, "edns_maximum_udp_payload_size", strlen("edns_maximum_udp_payload_size")))  {
-        uint32_t edns_maximum_udp_payload_size;
-        if ((ret = getdns_dict_get_int(all_context, "edns_maximum_udp_payload_size",
-                                       &edns_maximum_udp_payload_size)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong((long)edns_maximum_udp_payload_size);
-#else
-        return PyInt_FromLong((long)edns_maximum_udp_payload_size);
-#endif
-    }
-    if (!strncmp(attrname, "edns_extended_rcode", strlen("edns_extended_rcode")))  {
-        uint32_t edns_extended_rcode;
-        if ((ret = getdns_dict_get_int(all_context, "edns_extended_rcode",
-                                       &edns_extended_rcode)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong((long)edns_extended_rcode);
-#else
-        return PyInt_FromLong((long)edns_extended_rcode);
-#endif
-    }
-    if (!strncmp(attrname, "edns_version", strlen("edns_version")))  {
-        uint32_t edns_version;
-        if ((ret = getdns_dict_get_int(all_context, "edns_version",
-                                       &edns_version)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-#if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong((long)edns_version);
-#else
-        return PyInt_FromLong((long)edns_version);
-#endif
+        return -1;
     }
-    if (!strncmp(attrname, "edns_do_bit", strlen("edns_do_bit")))  {
-        uint32_t edns_do_bit;
-        if ((ret = getdns_dict_get_int(all_context, "edns_do_bit",
-                                       &edns_do_bit)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
+
+    self->idle_timeout = idle_timeout;
+    if (getdns_dict_get_int(api_info, "resolution_type", &value) == GETDNS_RETURN_GOOD)
+        self->resolution_type = value;
+    if (getdns_dict_get_int(all_context, "timeout", &value) == GETDNS_RETURN_GOOD)
+        self->timeout = value;
+    if (getdns_dict_get_int(all_context, "limit_outstanding_queries", &value) == GETDNS_RETURN_GOOD)
+        self->limit_outstanding_queries = value;
+    if (getdns_dict_get_int(all_context, "follow_redirects", &value) == GETDNS_RETURN_GOOD)
+        self->follow_redirects = value;
+    if (getdns_dict_get_int(all_context, "append_name", &value) == GETDNS_RETURN_GOOD)
+        self->append_name = value;
+    if (getdns_dict_get_int(all_context, "dnssec_allowed_skew", &value) == GETDNS_RETURN_GOOD)
+        self->dnssec_allowed_skew = value;
+    if (getdns_dict_get_int(all_context, "edns_maximum_udp_payload_size", &value) == GETDNS_RETURN_GOOD)
+        self->edns_maximum_udp_payload_size = value;
+    if (getdns_dict_get_int(all_context, "edns_extended_rcode", &value) == GETDNS_RETURN_GOOD)
+        self->edns_extended_rcode = value;
+    if (getdns_dict_get_int(all_context, "edns_version", &value) == GETDNS_RETURN_GOOD)
+        self->edns_version = value;
+    if (getdns_dict_get_int(all_context, "edns_do_bit", &value) == GETDNS_RETURN_GOOD)
+        self->edns_do_bit = value;
+
+    if ((py_transports = PyList_New((Py_ssize_t)transport_count)) == NULL)
+        goto error;
+    for ( i = 0 ; i < (int)transport_count ; i++ )  {
 #if PY_MAJOR_VERSION >= 3
-        return PyLong_FromLong((long)edns_do_bit);
+        if ((item = PyLong_FromLong((long)transports[i])) == NULL)  {
 #else
-        return PyInt_FromLong((long)edns_do_bit);
+        if ((item = PyInt_FromLong((long)transports[i])) == NULL)  {
 #endif
-    }
-    if (!strncmp(attrname, "namespaces", strlen("namespaces")))  {
-        PyObject *py_namespaces;
-        getdns_list *namespaces;
-        getdns_return_t ret;
-        if ((ret = getdns_dict_get_list(all_context, "namespaces",
-                                        &namespaces)) != GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
+            Py_DECREF(py_transports);
+            goto error;
         }
-        if ((py_namespaces = glist_to_plist(namespaces)) == NULL)  
-            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
-        return py_namespaces;
-    }
-    if (!strncmp(attrname, "suffix", strlen("suffix")))  {
-        PyObject *py_suffix;
-        getdns_list *suffix;
-        if ((ret = getdns_dict_get_list(all_context, "suffix",
-                                        &suffix)) != GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-        if ((py_suffix = glist_to_plist(suffix)) == NULL)
-            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
-        return py_suffix;
-    }
-    if (!strncmp(attrname, "dns_root_servers", strlen("dns_root_servers")))  {
-        PyObject *py_rootservers;
-        getdns_list *dns_root_servers;
-        getdns_return_t ret;
-        if ((ret = getdns_dict_get_list(all_context, "dns_root_servers", &dns_root_servers)) !=
-            GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-        if ((py_rootservers = glist_to_plist(dns_root_servers)) == NULL)  {
-            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
-        }
-        return py_rootservers;
-    }
-    if (!strncmp(attrname, "upstream_recursive_servers", strlen("upstream_recursive_servers")))  {
-        PyObject *py_upstream_servers;
-        getdns_list *upstream_list;
-        getdns_return_t ret;
+        PyList_SET_ITEM(py_transports, (Py_ssize_t)i, item);
+    }
+    Py_XDECREF(self->dns_transport_list);
+    self->dns_transport_list = py_transports;
+
+    if (update_string(&self->implementation_string, api_info, "implementation_string") < 0 ||
+        update_string(&self->version_string, api_info, "version_string") < 0 ||
+        update_list(&self->suffix, all_context, "suffix", settings_list) < 0 ||
+        update_list(&self->namespaces, all_context, "namespaces", settings_list) < 0 ||
+        update_list(&self->dns_root_servers, all_context, "dns_root_servers", settings_list) < 0 ||
+        update_list(&self->dnssec_trust_anchors, all_context, "dnssec_trust_anchors",
+                    settings_list) < 0 ||
+        update_list(&self->upstream_recursive_servers, all_context, "upstream_recursive_servers",
+                    pythonify_address_list) < 0)
+        goto error;
+    free(transports);
+    getdns_dict_destroy(api_info);
+    return 0;
 
-        if ((ret = getdns_dict_get_list(all_context, "upstream_recursive_servers",
-                                        &upstream_list)) != GETDNS_RETURN_GOOD)  {
-            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
-        }
-        if ((py_upstream_servers = pythonify_address_list(upstream_list)) == NULL)  {
-            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
-            return NULL;
-        }
-        return py_upstream_servers;
-    }
+error:
+    free(transports);
+    getdns_dict_destroy(api_info);
+    return -1;
+}
+
+
+/*
+ * list-valued settings hand back a copy, so that changing
+ * the list doesn't look like it changed the context
+ */
+
+PyObject *
+context_get_list_setting(getdns_ContextObject *self, void *closure)
+{
+    PyObject *value = *(PyObject **)((char *)self + (size_t)closure);
 
-    return PyObject_GenericGetAttr((PyObject *)self, nameobj);
+    if (value == NULL)
+        Py_RETURN_NONE;
+    return PySequence_List(value);
 }
 
 
 
+static int context_set_attribute(getdns_context *context, char *name, PyObject *py_value);
+
+
 int
 context_setattro(PyObject *self, PyObject *attrname, PyObject *py_value)
 {
     getdns_ContextObject *myself = (getdns_ContextObject *)self;
     struct getdns_context *context;
     char *name;
+    int ret;
 
 #if PY_MAJOR_VERSION >= 3
     name = PyBytes_AsString(PyUnicode_AsEncodedString(PyObject_Str(attrname), "ascii", NULL));
 #else
     name = PyString_AsString(attrname);
 #endif
-    if ((context = PyCapsule_GetPointer(myself->py_context, "context")) == NULL)  {
-        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+    if ((context = context_get(myself)) == NULL)
         return -1;
+    myself->settings_changes++;
+    if (!strcmp(name, "cache_size"))
+        return context_set_cache_size(myself, py_value);
+    if (!strcmp(name, "trace_hook"))
+        return context_set_trace_hook(myself, py_value);
+    if (!strcmp(name, "trace_sample"))
+        return context_set_trace_sample(myself, py_value);
+    if (!strcmp(name, "batch_callbacks"))  {
+        int batch;
+
+        if (py_value == NULL || (batch = PyObject_IsTrue(py_value)) < 0)  {
+            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+            return -1;
+        }
+        myself->batch_callbacks = (char)batch;
+        return 0;
+    }
+    context_lock(myself);
+    ret = context_set_attribute(context, name, py_value);
+    context_unlock(myself);
+    if (ret == 0)  {
+        context_cache_flush(myself);
+        ret = context_update_settings(myself, context);
     }
+    return ret;
+}
+
+
+static int
+context_set_attribute(getdns_context *context, char *name, PyObject *py_value)
+{
     if (!strncmp(name, "timeout", strlen("timeout")))  {
         return(context_set_timeout(context, py_value));
     }
@@ -1153,12 +1099,195 @@ context_setattro(PyObject *self, PyObject *attrname, PyObject *py_value)
 }
 
 
+/*
+ * lazily hook the context up to its private libevent
+ * event_base for callback-style queries, unless fileno() has
+ * given it a selector loop, which they use instead.  A context
+ * that's already being driven by an asyncio loop can't be
+ * switched over, since that would orphan its outstanding futures
+ */
+
+int
+context_attach_libevent(getdns_ContextObject *self, getdns_context *context)
+{
+    getdns_return_t ret;
+
+    if (self->event_base || self->selector)
+        return 0;
+    if (self->asyncio_loop)  {
+        PyErr_SetString(getdns_error, "Context is bound to an asyncio event loop");
+        return -1;
+    }
+    if ((self->event_base = event_base_new()) == 0)  {
+        PyErr_SetString(getdns_error, "Can't create event base");
+        return -1;
+    }
+    context_lock(self);
+    ret = getdns_extension_set_libevent_base(context, self->event_base);
+    context_unlock(self);
+    if (ret != GETDNS_RETURN_GOOD)  {
+        event_base_free(self->event_base);
+        self->event_base = 0;
+        PyErr_SetString(getdns_error, "Can't set event base");
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * driving the event base for callback-style queries.  The loop
+ * is stepped with EVLOOP_ONCE (or EVLOOP_NONBLOCK) rather than
+ * handed over to event_base_dispatch(), so that we can stop at a
+ * deadline and check for signals between steps, and the GIL is
+ * released while libevent waits; callback_shim() takes it back
+ * to run each callback.  The deadline is a timer of our own, as
+ * event_base_loopexit() would leave its timer behind to cut a
+ * later run short.  Batched callbacks (see context_batch_flush())
+ * are delivered after each step.  A context with a selector loop (see
+ * context_selector.c) is stepped through that instead.  Every
+ * flavour returns the number of queries still outstanding
+ */
+
+#define RUN_ALL 0               /* until nothing is outstanding */
+#define RUN_ONCE 1              /* one batch of events */
+#define RUN_NONBLOCK 2          /* whatever is ready now */
+
+static void
+run_timer_cb(evutil_socket_t fd, short what, void *arg)
+{
+}
+
+
+static int
+run_deadline(PyObject *timeout, uint64_t *deadline)
+{
+    double seconds;
+
+    *deadline = 0;
+    if (timeout == NULL || timeout == Py_None)
+        return 0;
+    if ((seconds = PyFloat_AsDouble(timeout)) == -1.0 && PyErr_Occurred())
+        return -1;
+    if (seconds != seconds)  {
+        PyErr_SetString(getdns_error, "timeout must not be NaN");
+        return -1;
+    }
+    if (seconds < 0.0)  {
+        PyErr_SetString(getdns_error, "timeout must not be negative");
+        return -1;
+    }
+    *deadline = context_stats_deadline(seconds);
+    return 0;
+}
+
+
+static PyObject *
+context_run_loop(getdns_ContextObject *self, PyObject *timeout, int mode)
+{
+    getdns_context *context;
+    struct event *timer = 0;
+    struct timeval tv;
+    uint64_t deadline;
+    uint64_t now;
+    uint32_t pending;
+    int batching;
+    int ret;
+
+    if ((context = context_get(self)) == NULL)
+        return NULL;
+    if (run_deadline(timeout, &deadline) < 0)
+        return NULL;
+    if (!self->event_base && !self->selector)
+        return PyLong_FromLong(0);
+    if (self->event_base && deadline && (timer = evtimer_new(self->event_base, run_timer_cb, NULL)) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        return NULL;
+    }
+    context_lock(self);
+    batching = self->batching;
+    for (;;)  {
+        if (mode != RUN_NONBLOCK && getdns_context_get_num_pending_requests(context, NULL) == 0)
+            break;
+        self->batching = 1;
+        now = context_stats_now();
+        now = deadline > now ? deadline - now : 0;
+        if (self->selector)  {
+            ret = context_selector_step(self, mode == RUN_NONBLOCK ? 0 : deadline ? (int64_t)now : -1);
+        }  else  {
+            if (timer)  {
+                tv.tv_sec = (time_t)(now / 1000000000ULL);
+                tv.tv_usec = (suseconds_t)(now % 1000000000ULL / 1000);
+                evtimer_add(timer, &tv);
+            }
+            Py_BEGIN_ALLOW_THREADS
+            ret = event_base_loop(self->event_base, mode == RUN_NONBLOCK ? EVLOOP_NONBLOCK : EVLOOP_ONCE);
+            Py_END_ALLOW_THREADS
+            if (timer)
+                evtimer_del(timer);
+        }
+        self->batching = batching;
+        if (!batching)
+            context_batch_flush(self);
+        if ((ret < 0 && PyErr_Occurred()) || PyErr_CheckSignals() < 0)  {
+            context_unlock(self);
+            if (timer)
+                event_free(timer);
+            return NULL;
+        }
+        if (ret != 0 || mode != RUN_ALL || (deadline && context_stats_now() >= deadline))
+            break;
+    }
+    pending = getdns_context_get_num_pending_requests(context, NULL);
+    context_unlock(self);
+    if (timer)
+        event_free(timer);
+#if PY_MAJOR_VERSION >= 3
+    return PyLong_FromUnsignedLong((unsigned long)pending);
+#else
+    return PyInt_FromLong((long)pending);
+#endif
+}
+
+
 PyObject *
 context_run(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
 {
-    if (self->event_base)  
-        (void)event_base_dispatch(self->event_base);
-    Py_RETURN_NONE;
+    static char *kwlist[] = {
+        "timeout",
+        0
+    };
+    PyObject *timeout = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O", kwlist, &timeout))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    return context_run_loop(self, timeout, RUN_ALL);
+}
+
+
+PyObject *
+context_run_once(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "timeout",
+        0
+    };
+    PyObject *timeout = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O", kwlist, &timeout))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    return context_run_loop(self, timeout, RUN_ONCE);
+}
+
+
+PyObject *
+context_process_events(getdns_ContextObject *self, PyObject *unused)
+{
+    return context_run_loop(self, NULL, RUN_NONBLOCK);
 }
 
 
@@ -1173,15 +1302,16 @@ context_cancel_callback(getdns_ContextObject *self, PyObject *args, PyObject *ke
     getdns_transaction_t tid = 0;
     getdns_return_t ret;
 
-    if ((context = PyCapsule_GetPointer(self->py_context, "context")) == NULL)  {
-        PyErr_SetString(getdns_error, GETDNS_RETURN_BAD_CONTEXT_TEXT);
+    if ((context = context_get(self)) == NULL)
         return NULL;
-    }
     if (!PyArg_ParseTupleAndKeywords(args, keywds, "L", kwlist, &tid))  {
         PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
         return NULL;
     }
-    if ((ret = getdns_cancel_callback(context, tid)) != GETDNS_RETURN_GOOD)  {
+    context_lock(self);
+    ret = getdns_cancel_callback(context, tid);
+    context_unlock(self);
+    if (ret != GETDNS_RETURN_GOOD)  {
         PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
         return NULL;
     }
@@ -1196,23 +1326,30 @@ context_str(PyObject *self)
     struct getdns_context *context;
     getdns_dict *api_info;
     char *str_api_dict;
+    PyObject *py_str;
 
     context = PyCapsule_GetPointer(myself->py_context, "context");
+    context_lock(myself);
     api_info = getdns_context_get_api_information(context);
-    if ((str_api_dict = getdns_print_json_dict(api_info, 0)) == NULL)  {
+    context_unlock(myself);
+    str_api_dict = getdns_print_json_dict(api_info, 0);
+    getdns_dict_destroy(api_info);
+    if (str_api_dict == NULL)  {
         PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
         return NULL;
     }
 #if PY_MAJOR_VERSION >= 3
-    return(PyUnicode_FromString(str_api_dict));    
+    py_str = PyUnicode_FromString(str_api_dict);
 #else
-    return(PyString_FromString(str_api_dict));    
+    py_str = PyString_FromString(str_api_dict);
 #endif
+    free(str_api_dict);
+    return py_str;
 }
 
 
 PyObject *
-context_general(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+context_general(getdns_ContextObject *self, QUERY_ARGS)
 {
     static char *kwlist[] = {
         "name",
@@ -1223,54 +1360,51 @@ context_general(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
         "callback",
         0
     };
+    static query_arg_parser parser = { "sH|OOLO", kwlist };
     getdns_context *context;
     char *name;
     uint16_t  request_type;
-    PyDictObject *extensions_obj = 0;
+    PyObject *extensions_obj = 0;
     struct getdns_dict *extensions_dict = 0;
     getdns_return_t ret;
-    void *userarg = 0;
+    PyObject *userarg = 0;
     getdns_transaction_t tid = 0;
     PyObject *callback = 0;
     struct getdns_dict *resp;
+    uint64_t started;
+    query_trace trace = { 0, 0 };
     PyObject *callback_func;
+    PyObject *query_key = 0;
+    PyObject *result;
 
-    if ((context = PyCapsule_GetPointer(self->py_context, "context")) == NULL)  {
-        PyErr_SetString(getdns_error, GETDNS_RETURN_BAD_CONTEXT_TEXT);
+    if ((context = context_get(self)) == NULL)
         return NULL;
-    }
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "sH|OsLO", kwlist,
-                                     &name, &request_type,
-                                     &extensions_obj, &userarg, &tid, &callback))  {
+    if (!QUERY_PARSE(parser, &name, &request_type,
+                         &extensions_obj, &userarg, &tid, &callback))  {
         PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
         return NULL;
     }
-    if (extensions_obj)  {
-        if ((extensions_dict = extensions_to_getdnsdict(extensions_obj)) == 0)  {
-            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+    if (!callback)  {
+        if ((query_key = context_query_key("general", name, request_type, extensions_obj)) == NULL)
             return NULL;
+        if (self->cache &&
+            ((result = context_cache_lookup(self, query_key)) != NULL || PyErr_Occurred()))  {
+            Py_DECREF(query_key);
+            return result;
         }
     }
+    if (extensions_get(extensions_obj, &extensions_dict) < 0)  {
+        Py_XDECREF(query_key);
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
     if (callback)  {
         userarg_blob *blob;
 
-        if (!self->event_base)  {
-            if ((self->event_base = event_base_new()) == 0)  {
-                PyErr_SetString(getdns_error, "Can't create event base");
-                return NULL;
-            }
-            if ((ret = getdns_extension_set_libevent_base(context, self->event_base)) !=
-                GETDNS_RETURN_GOOD)  {
-                PyErr_SetString(getdns_error, "Can't set event base");
-                return NULL;
-            }
-        }
-        if ((blob = (userarg_blob *)malloc(sizeof(userarg_blob))) == (userarg_blob *)0)  {
-            PyErr_SetString(getdns_error, "Memory allocation failed");
+        if (context_attach_libevent(self, context) < 0)  {
+            extensions_put(extensions_obj, extensions_dict);
             return NULL;
         }
-        if (userarg)  
-            strncpy(blob->userarg, userarg, BUFSIZ-1);
 #if PY_MAJOR_VERSION >= 3
         if (PyUnicode_Check(callback))  {
             if ((callback_func = get_callback("__main__", PyBytes_AsString(PyUnicode_AsEncodedString(PyObject_Str(callback), "ascii", NULL)))) == (PyObject *)NULL)  {
@@ -1281,19 +1415,32 @@ context_general(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
                 PyObject *err_type, *err_value, *err_traceback;
                 PyErr_Fetch(&err_type, &err_value, &err_traceback);
                 PyErr_Restore(err_type, err_value, err_traceback);
+                extensions_put(extensions_obj, extensions_dict);
                 return NULL;
             }
-            blob->callback_func = callback_func;
         }  else if (PyCallable_Check(callback))  {
-            blob->callback_func = callback;
+            callback_func = callback;
         }  else  {
             PyErr_SetString(getdns_error, "Invalid callback value");
+            extensions_put(extensions_obj, extensions_dict);
+            return NULL;
+        }
+        if ((blob = userarg_blob_new(self, callback_func, userarg, request_type)) == NULL)  {
+            extensions_put(extensions_obj, extensions_dict);
             return NULL;
         }
 
-        if ((ret = getdns_general(context, name, request_type,
-                                  extensions_dict, (void *)blob, &tid, callback_shim)) !=
-            GETDNS_RETURN_GOOD)  {
+        if (self->trace_hook)
+            context_trace_begin(self, name, NULL, &blob->trace);
+        context_lock(self);
+        blob->started = context_stats_submit(self->stats);
+        ret = getdns_general(context, name, request_type, extensions_dict, (void *)blob, &tid, callback_shim);
+        context_unlock(self);
+        extensions_put(extensions_obj, extensions_dict);
+        if (ret != GETDNS_RETURN_GOOD)  {
+            context_stats_done(self->stats, request_type, blob->started, context_stats_now(),
+                               GETDNS_CALLBACK_ERROR, NULL);
+            userarg_blob_release(blob);
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
             return NULL;
         }
@@ -1303,18 +1450,57 @@ context_general(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
         return(PyInt_FromLong((long)tid));
 #endif
     } else  {
-        if ((ret = getdns_general_sync(context, name, request_type,
-                                       extensions_dict, &resp)) != GETDNS_RETURN_GOOD)  {
+        PyObject *flight;
+
+        if (!context_flight_sync_begin(self, query_key, &flight, &result))  {
+            Py_DECREF(query_key);
+            extensions_put(extensions_obj, extensions_dict);
+            return result;
+        }
+        if (self->trace_hook)
+            context_trace_begin(self, name, NULL, &trace);
+        context_lock(self);
+        started = context_stats_submit(self->stats);
+        Py_BEGIN_ALLOW_THREADS
+        ret = getdns_general_sync(context, name, request_type, extensions_dict, &resp);
+        Py_END_ALLOW_THREADS
+        context_unlock(self);
+        extensions_put(extensions_obj, extensions_dict);
+        context_sync_done(self, &trace, request_type, started, ret, resp);
+        if (ret != GETDNS_RETURN_GOOD)  {
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
+            result = NULL;
+        }  else  {
+            result = context_cache_insert(self, query_key, result_create(resp));
         }
-        return result_create(resp);
+        context_flight_sync_end(self, flight, ret, result);
+        Py_DECREF(query_key);
+        return result;
     }
 }
 
 
+/*
+ * what a synchronous address() hands back.  The Result is made
+ * (and cached, and shared with coalesced queries) as usual, but
+ * in the packed modes only its addresses are converted
+ */
+
+static PyObject *
+address_result(PyObject *result, int mode)
+{
+    PyObject *addresses;
+
+    if (result == NULL || mode == ADDRESS_MODE_RESULT)
+        return result;
+    addresses = get_address_tuple(((getdns_ResultObject *)result)->response, mode);
+    Py_DECREF(result);
+    return addresses;
+}
+
+
 PyObject *
-context_address(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+context_address(getdns_ContextObject *self, QUERY_ARGS)
 {
     static char *kwlist[] = {
         "name",
@@ -1322,58 +1508,59 @@ context_address(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
         "userarg",
         "transaction_id",
         "callback",
+        "mode",
         0
     };
+    static query_arg_parser parser = { "s|OOLOi", kwlist };
     getdns_return_t ret;
     getdns_context *context;
     char *name;
     PyObject *callback_func;
-    PyDictObject *extensions_obj = 0;
+    PyObject *query_key = 0;
+    PyObject *result;
+    PyObject *extensions_obj = 0;
     struct getdns_dict *extensions_dict = 0;
-    char *userarg = 0;
+    PyObject *userarg = 0;
     getdns_transaction_t tid;
     PyObject *callback = 0;
+    int mode = ADDRESS_MODE_RESULT;
     struct getdns_dict *resp;
+    uint64_t started;
+    query_trace trace = { 0, 0 };
 
-    if ((context = PyCapsule_GetPointer(self->py_context, "context")) == NULL)  {
-        PyErr_SetString(getdns_error, GETDNS_RETURN_BAD_CONTEXT_TEXT);
+    if ((context = context_get(self)) == NULL)
+        return NULL;
+    if (!QUERY_PARSE(parser, &name,
+                         &extensions_obj, &userarg, &tid, &callback, &mode))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
         return NULL;
     }
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|OsLO", kwlist,
-                                     &name, 
-                                     &extensions_obj, &userarg, &tid, &callback))  {
+    if (mode < ADDRESS_MODE_RESULT || mode > ADDRESS_MODE_IPADDRESS ||
+        (callback && mode != ADDRESS_MODE_RESULT))  {
         PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
         return NULL;
     }
-    if (extensions_obj)  {
-        if ((extensions_dict = extensions_to_getdnsdict(extensions_obj)) == 0)  {
-            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+    if (!callback)  {
+        if ((query_key = context_query_key("address", name, 0, extensions_obj)) == NULL)
             return NULL;
+        if (self->cache &&
+            ((result = context_cache_lookup(self, query_key)) != NULL || PyErr_Occurred()))  {
+            Py_DECREF(query_key);
+            return address_result(result, mode);
         }
     }
+    if (extensions_get(extensions_obj, &extensions_dict) < 0)  {
+        Py_XDECREF(query_key);
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
     if (callback)  {
         userarg_blob *blob;
 
-        if (!self->event_base)  {
-            if ((self->event_base = event_base_new()) == 0)  {
-                PyErr_SetString(getdns_error, "Can't create event base");
-                return NULL;
-            }
-            if ((ret = getdns_extension_set_libevent_base(context, self->event_base)) !=
-                GETDNS_RETURN_GOOD)  {
-                PyErr_SetString(getdns_error, "Can't set event base");
-                return NULL;
-            }
-        }
-        if ((blob = (userarg_blob *)malloc(sizeof(userarg_blob))) == (userarg_blob *)0)  {
-            PyErr_SetString(getdns_error, "Memory allocation failed");
+        if (context_attach_libevent(self, context) < 0)  {
+            extensions_put(extensions_obj, extensions_dict);
             return NULL;
         }
-        if (userarg)  {
-            strncpy(blob->userarg, userarg, BUFSIZ-1);
-        }  else  {
-            blob->userarg[0] = 0;
-        }
 #if PY_MAJOR_VERSION >= 3
         if (PyUnicode_Check(callback))  {
             if ((callback_func = get_callback("__main__", PyBytes_AsString(PyUnicode_AsEncodedString(PyObject_Str(callback), "ascii", NULL)))) == (PyObject *)NULL)  {
@@ -1384,18 +1571,32 @@ context_address(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
                 PyObject *err_type, *err_value, *err_traceback;
                 PyErr_Fetch(&err_type, &err_value, &err_traceback);
                 PyErr_Restore(err_type, err_value, err_traceback);
+                extensions_put(extensions_obj, extensions_dict);
                 return NULL;
             }
-            blob->callback_func = callback_func;
         }  else if (PyCallable_Check(callback))  {
-            blob->callback_func = callback;
+            callback_func = callback;
         }  else  {
             PyErr_SetString(getdns_error, "Invalid callback value");
+            extensions_put(extensions_obj, extensions_dict);
+            return NULL;
+        }
+        if ((blob = userarg_blob_new(self, callback_func, userarg, 0)) == NULL)  {
+            extensions_put(extensions_obj, extensions_dict);
             return NULL;
         }
                                       
-        if ((ret = getdns_address(context, name, extensions_dict, (void *)blob, &tid, callback_shim)) !=
-            GETDNS_RETURN_GOOD)  {
+        if (self->trace_hook)
+            context_trace_begin(self, name, NULL, &blob->trace);
+        context_lock(self);
+        blob->started = context_stats_submit(self->stats);
+        ret = getdns_address(context, name, extensions_dict, (void *)blob, &tid, callback_shim);
+        context_unlock(self);
+        extensions_put(extensions_obj, extensions_dict);
+        if (ret != GETDNS_RETURN_GOOD)  {
+            context_stats_done(self->stats, 0, blob->started, context_stats_now(),
+                               GETDNS_CALLBACK_ERROR, NULL);
+            userarg_blob_release(blob);
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
             return NULL;
         }
@@ -1405,17 +1606,38 @@ context_address(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
         return(PyInt_FromLong((long)tid));
 #endif
     } else  {
-        if ((ret = getdns_address_sync(context, name, extensions_dict, &resp)) != GETDNS_RETURN_GOOD)  {
+        PyObject *flight;
+
+        if (!context_flight_sync_begin(self, query_key, &flight, &result))  {
+            Py_DECREF(query_key);
+            extensions_put(extensions_obj, extensions_dict);
+            return address_result(result, mode);
+        }
+        if (self->trace_hook)
+            context_trace_begin(self, name, NULL, &trace);
+        context_lock(self);
+        started = context_stats_submit(self->stats);
+        Py_BEGIN_ALLOW_THREADS
+        ret = getdns_address_sync(context, name, extensions_dict, &resp);
+        Py_END_ALLOW_THREADS
+        context_unlock(self);
+        extensions_put(extensions_obj, extensions_dict);
+        context_sync_done(self, &trace, 0, started, ret, resp);
+        if (ret != GETDNS_RETURN_GOOD)  {
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
+            result = NULL;
+        }  else  {
+            result = context_cache_insert(self, query_key, result_create(resp));
         }
-        return result_create(resp);
+        context_flight_sync_end(self, flight, ret, result);
+        Py_DECREF(query_key);
+        return address_result(result, mode);
     }
 }
 
 
 PyObject *
-context_hostname(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+context_hostname(getdns_ContextObject *self, QUERY_ARGS)
 {
     static char *kwlist[] = {
         "address",
@@ -1425,63 +1647,46 @@ context_hostname(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
         "callback",
         0
     };
+    static query_arg_parser parser = { "O|OOLO", kwlist };
     void *address;
-    PyDictObject *extensions_obj = 0;
+    PyObject *extensions_obj = 0;
     struct getdns_dict *extensions_dict = 0;
-    void *userarg = 0;
+    PyObject *userarg = 0;
     getdns_transaction_t tid;
     PyObject* callback = 0;
     struct getdns_dict *resp;
+    uint64_t started;
+    query_trace trace = { 0, 0 };
     getdns_context *context;
     struct getdns_dict *addr_dict;
     getdns_return_t ret;
     PyObject *callback_func;
 
-    if ((context = PyCapsule_GetPointer(self->py_context, "context")) == NULL)  {
-        PyErr_SetString(getdns_error, GETDNS_RETURN_BAD_CONTEXT_TEXT);
+    if ((context = context_get(self)) == NULL)
         return NULL;
-    }
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OsLO", kwlist,
-                                     &address, 
-                                     &extensions_obj, &userarg, &tid, &callback))  {
+    if (!QUERY_PARSE(parser, &address,
+                         &extensions_obj, &userarg, &tid, &callback))  {
         PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
         return NULL; 
     }
-    if (extensions_obj)  {
-        if ((extensions_dict = extensions_to_getdnsdict(extensions_obj)) == 0)  {
-            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
-            return NULL;
-        }
+    if (extensions_get(extensions_obj, &extensions_dict) < 0)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
     }
     if ((addr_dict = getdnsify_addressdict((PyObject *)address)) == NULL)  {
         PyObject *err_type, *err_value, *err_traceback;
         PyErr_Fetch(&err_type, &err_value, &err_traceback);
         PyErr_Restore(err_type, err_value, err_traceback);
+        extensions_put(extensions_obj, extensions_dict);
         return NULL;
     }
     if (callback)  {
         userarg_blob *blob;
 
-        if (!self->event_base)  {
-            if ((self->event_base = event_base_new()) == 0)  {
-                PyErr_SetString(getdns_error, "Can't create event base");
-                return NULL;
-            }
-            if ((ret = getdns_extension_set_libevent_base(context, self->event_base)) !=
-                GETDNS_RETURN_GOOD)  {
-                PyErr_SetString(getdns_error, "Can't set event base");
-                return NULL;
-            }
-        }
-        if ((blob = (userarg_blob *)malloc(sizeof(userarg_blob))) == (userarg_blob *)0)  {
-            PyErr_SetString(getdns_error, "Memory allocation failed");
+        if (context_attach_libevent(self, context) < 0)  {
+            extensions_put(extensions_obj, extensions_dict);
             return NULL;
         }
-        if (userarg)  {
-            strncpy(blob->userarg, userarg, BUFSIZ-1);
-        }  else  {
-            blob->userarg[0] = 0;
-        }
 #if PY_MAJOR_VERSION >= 3
         if (PyUnicode_Check(callback))  {
             if ((callback_func = get_callback("__main__", PyBytes_AsString(PyUnicode_AsEncodedString(PyObject_Str(callback), "ascii", NULL)))) == (PyObject *)NULL)  {
@@ -1492,18 +1697,32 @@ context_hostname(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
                 PyObject *err_type, *err_value, *err_traceback;
                 PyErr_Fetch(&err_type, &err_value, &err_traceback);
                 PyErr_Restore(err_type, err_value, err_traceback);
+                extensions_put(extensions_obj, extensions_dict);
                 return NULL;
             }
-            blob->callback_func = callback_func;
         }  else if (PyCallable_Check(callback))  {
-            blob->callback_func = callback;
+            callback_func = callback;
         }  else  {
             PyErr_SetString(getdns_error, "Invalid callback value");
+            extensions_put(extensions_obj, extensions_dict);
+            return NULL;
+        }
+        if ((blob = userarg_blob_new(self, callback_func, userarg, GETDNS_RRTYPE_PTR)) == NULL)  {
+            extensions_put(extensions_obj, extensions_dict);
             return NULL;
         }
 
-        if ((ret = getdns_hostname(context, addr_dict, extensions_dict, (void *)blob, &tid, callback_shim)) !=
-            GETDNS_RETURN_GOOD)  {
+        if (self->trace_hook)
+            context_trace_begin(self, NULL, (PyObject *)address, &blob->trace);
+        context_lock(self);
+        blob->started = context_stats_submit(self->stats);
+        ret = getdns_hostname(context, addr_dict, extensions_dict, (void *)blob, &tid, callback_shim);
+        context_unlock(self);
+        extensions_put(extensions_obj, extensions_dict);
+        if (ret != GETDNS_RETURN_GOOD)  {
+            context_stats_done(self->stats, GETDNS_RRTYPE_PTR, blob->started, context_stats_now(),
+                               GETDNS_CALLBACK_ERROR, NULL);
+            userarg_blob_release(blob);
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
             return NULL;
         }
@@ -1513,7 +1732,17 @@ context_hostname(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
         return(PyInt_FromLong((long)tid));
 #endif
     } else  {
-        if ((ret = getdns_hostname_sync(context, addr_dict, extensions_dict, &resp)) != GETDNS_RETURN_GOOD)  {
+        if (self->trace_hook)
+            context_trace_begin(self, NULL, (PyObject *)address, &trace);
+        context_lock(self);
+        started = context_stats_submit(self->stats);
+        Py_BEGIN_ALLOW_THREADS
+        ret = getdns_hostname_sync(context, addr_dict, extensions_dict, &resp);
+        Py_END_ALLOW_THREADS
+        context_unlock(self);
+        extensions_put(extensions_obj, extensions_dict);
+        context_sync_done(self, &trace, GETDNS_RRTYPE_PTR, started, ret, resp);
+        if (ret != GETDNS_RETURN_GOOD)  {
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
             return NULL;
         }
@@ -1523,7 +1752,7 @@ context_hostname(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
 
 
 PyObject *
-context_service(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+context_service(getdns_ContextObject *self, QUERY_ARGS)
 {
     static char *kwlist[] = {
         "name",
@@ -1533,56 +1762,50 @@ context_service(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
         "callback",
         0
     };
+    static query_arg_parser parser = { "s|OOLO", kwlist };
     char *name;
-    PyDictObject *extensions_obj = 0;
+    PyObject *extensions_obj = 0;
     struct getdns_dict *extensions_dict = 0;
     getdns_return_t ret;
-    void *userarg;
+    PyObject *userarg = 0;
     getdns_transaction_t tid;
     PyObject *callback = 0;
     struct getdns_dict *resp;
+    uint64_t started;
+    query_trace trace = { 0, 0 };
     getdns_context *context;
     PyObject *callback_func;
+    PyObject *query_key = 0;
+    PyObject *result;
 
-    if ((context = PyCapsule_GetPointer(self->py_context, "context")) == NULL)  {
-        PyErr_SetString(getdns_error, GETDNS_RETURN_BAD_CONTEXT_TEXT);
+    if ((context = context_get(self)) == NULL)
         return NULL;
-    }
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|OsLO", kwlist,
-                                     &name, 
-                                     &extensions_obj, &userarg, &tid, &callback))  {
+    if (!QUERY_PARSE(parser, &name,
+                         &extensions_obj, &userarg, &tid, &callback))  {
         PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
         return NULL;            
     }
-    if (extensions_obj)  {
-        if ((extensions_dict = extensions_to_getdnsdict(extensions_obj)) == 0)  {
-            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+    if (!callback)  {
+        if ((query_key = context_query_key("service", name, 0, extensions_obj)) == NULL)
             return NULL;
+        if (self->cache &&
+            ((result = context_cache_lookup(self, query_key)) != NULL || PyErr_Occurred()))  {
+            Py_DECREF(query_key);
+            return result;
         }
     }
+    if (extensions_get(extensions_obj, &extensions_dict) < 0)  {
+        Py_XDECREF(query_key);
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
     if (callback)  {
         userarg_blob *blob;
 
-        if (!self->event_base)  {
-            if ((self->event_base = event_base_new()) == 0)  {
-                PyErr_SetString(getdns_error, "Can't create event base");
-                return NULL;
-            }
-            if ((ret = getdns_extension_set_libevent_base(context, self->event_base)) !=
-                GETDNS_RETURN_GOOD)  {
-                PyErr_SetString(getdns_error, "Can't set event base");
-                return NULL;
-            }
-        }
-        if ((blob = (userarg_blob *)malloc(sizeof(userarg_blob))) == (userarg_blob *)0)  {
-            PyErr_SetString(getdns_error, "Memory allocation failed");
+        if (context_attach_libevent(self, context) < 0)  {
+            extensions_put(extensions_obj, extensions_dict);
             return NULL;
         }
-        if (userarg)  {
-            strncpy(blob->userarg, userarg, BUFSIZ-1);
-        }  else  {
-            blob->userarg[0] = 0;
-        }
 #if PY_MAJOR_VERSION >= 3
         if (PyUnicode_Check(callback))  {
             if ((callback_func = get_callback("__main__", PyBytes_AsString(PyUnicode_AsEncodedString(PyObject_Str(callback), "ascii", NULL)))) == (PyObject *)NULL)  {
@@ -1593,18 +1816,32 @@ context_service(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
                 PyObject *err_type, *err_value, *err_traceback;
                 PyErr_Fetch(&err_type, &err_value, &err_traceback);
                 PyErr_Restore(err_type, err_value, err_traceback);
+                extensions_put(extensions_obj, extensions_dict);
                 return NULL;
             }
-            blob->callback_func = callback_func;
         }  else if (PyCallable_Check(callback))  {
-            blob->callback_func = callback;
+            callback_func = callback;
         }  else  {
             PyErr_SetString(getdns_error, "Invalid callback value");
+            extensions_put(extensions_obj, extensions_dict);
+            return NULL;
+        }
+        if ((blob = userarg_blob_new(self, callback_func, userarg, GETDNS_RRTYPE_SRV)) == NULL)  {
+            extensions_put(extensions_obj, extensions_dict);
             return NULL;
         }
 
-        if ((ret = getdns_service(context, name, extensions_dict, (void *)blob, &tid, callback_shim)) !=
-            GETDNS_RETURN_GOOD)  {
+        if (self->trace_hook)
+            context_trace_begin(self, name, NULL, &blob->trace);
+        context_lock(self);
+        blob->started = context_stats_submit(self->stats);
+        ret = getdns_service(context, name, extensions_dict, (void *)blob, &tid, callback_shim);
+        context_unlock(self);
+        extensions_put(extensions_obj, extensions_dict);
+        if (ret != GETDNS_RETURN_GOOD)  {
+            context_stats_done(self->stats, GETDNS_RRTYPE_SRV, blob->started, context_stats_now(),
+                               GETDNS_CALLBACK_ERROR, NULL);
+            userarg_blob_release(blob);
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
             return NULL;
         }
@@ -1614,11 +1851,32 @@ context_service(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
         return(PyInt_FromLong((long)tid));
 #endif
     } else  {
-        if ((ret = getdns_service_sync(context, name, extensions_dict, &resp)) != GETDNS_RETURN_GOOD)  {
+        PyObject *flight;
+
+        if (!context_flight_sync_begin(self, query_key, &flight, &result))  {
+            Py_DECREF(query_key);
+            extensions_put(extensions_obj, extensions_dict);
+            return result;
+        }
+        if (self->trace_hook)
+            context_trace_begin(self, name, NULL, &trace);
+        context_lock(self);
+        started = context_stats_submit(self->stats);
+        Py_BEGIN_ALLOW_THREADS
+        ret = getdns_service_sync(context, name, extensions_dict, &resp);
+        Py_END_ALLOW_THREADS
+        context_unlock(self);
+        extensions_put(extensions_obj, extensions_dict);
+        context_sync_done(self, &trace, GETDNS_RRTYPE_SRV, started, ret, resp);
+        if (ret != GETDNS_RETURN_GOOD)  {
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
+            result = NULL;
+        }  else  {
+            result = context_cache_insert(self, query_key, result_create(resp));
         }
-        return result_create(resp);
+        context_flight_sync_end(self, flight, ret, result);
+        Py_DECREF(query_key);
+        return result;
     }
 }
 
@@ -1637,15 +1895,15 @@ context_get_api_information(getdns_ContextObject *self, PyObject *unused)
     getdns_return_t ret;
 
 
-    if ((context = PyCapsule_GetPointer(self->py_context, "context")) == NULL)  {
-        PyErr_SetString(getdns_error, GETDNS_RETURN_BAD_CONTEXT_TEXT);
+    if ((context = context_get(self)) == NULL)
         return NULL;
-    }
     py_api = PyDict_New();
+    context_lock(self);
     api_info = getdns_context_get_api_information(context);
+    context_unlock(self);
     if ((ret = getdns_dict_get_bindata(api_info, "version_string", &version_string)) != GETDNS_RETURN_GOOD)  {
         PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-        return NULL;
+        goto error;
     }
 #if PY_MAJOR_VERSION >= 3
     if (PyDict_SetItemString(py_api, "version_string",
@@ -1657,11 +1915,11 @@ context_get_api_information(getdns_ContextObject *self, PyObject *unused)
                                                         (Py_ssize_t)version_string->size)))  {
 #endif
         PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-        return NULL;
+        goto error;
     }
     if ((ret = getdns_dict_get_bindata(api_info, "implementation_string", &imp_string)) != GETDNS_RETURN_GOOD)  {
         PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-        return NULL;
+        goto error;
     }
 #if PY_MAJOR_VERSION >= 3
     if (PyDict_SetItemString(py_api, "implementation_string",
@@ -1673,11 +1931,11 @@ context_get_api_information(getdns_ContextObject *self, PyObject *unused)
                                                         (Py_ssize_t)imp_string->size)))  {
 #endif
         PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-        return NULL;
+        goto error;
     }
     if ((ret = getdns_dict_get_int(api_info, "resolution_type", &resolution_type)) != GETDNS_RETURN_GOOD)  {
         PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-        return NULL;
+        goto error;
     }
 #if PY_MAJOR_VERSION >= 3
     if (PyDict_SetItemString(py_api, "resolution_type", PyLong_FromLong((long)resolution_type)))  {
@@ -1685,16 +1943,22 @@ context_get_api_information(getdns_ContextObject *self, PyObject *unused)
     if (PyDict_SetItemString(py_api, "resolution_type", PyInt_FromLong((long)resolution_type)))  {
 #endif
         PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-        return NULL;
+        goto error;
     }
     if ((ret = getdns_dict_get_dict(api_info, "all_context", &all_context)) != GETDNS_RETURN_GOOD)  {
         PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-        return NULL;
+        goto error;
     }
-    if ((py_all_context = gdict_to_pdict(all_context)) == NULL)  {
+    if ((py_all_context = gdict_to_pdict(all_context, NULL)) == NULL)  {
         PyErr_SetString(getdns_error, "Unable to convert all_context dict");
-        return NULL;
+        goto error;
     }
     PyDict_SetItemString(py_api, "all_context", py_all_context);
+    getdns_dict_destroy(api_info);
     return(py_api);
+
+error:
+    Py_DECREF(py_api);
+    getdns_dict_destroy(api_info);
+    return NULL;
 }        
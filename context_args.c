@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <Python.h>
+#include <getdns/getdns.h>
+#include "pygetdns.h"
+
+/*
+ * Argument parsing for the query methods (general(), address(),
+ * hostname() and service()).  On Python 3.7 and later they're
+ * METH_FASTCALL, and query_args_parse() takes their arguments
+ * straight off the stack, matching keywords against names that
+ * were interned the first time through, so a call doesn't build
+ * an argument tuple and keyword dict only to take them apart
+ * again.  It understands the subset of PyArg_ParseTupleAndKeywords()
+ * formats the query methods use (s, H, i, L and O, with | before
+ * the optional ones), and like it leaves optional arguments that
+ * weren't passed alone.  Older Pythons use PyArg_ParseTupleAndKeywords()
+ * itself, with the same format (see QUERY_PARSE() in pygetdns.h).
+ */
+
+#ifdef QUERY_FASTCALL
+
+/* guards the first time through each parser, with no GIL to do it */
+PYGETDNS_MUTEX(query_args_mutex);
+
+
+static int
+query_args_keys(query_arg_parser *parser)
+{
+    const char *p;
+    int n = 0;
+
+    for (p = parser->format ; *p ; p++)  {
+        if (*p == '|')  {
+            parser->n_required = n;
+            continue;
+        }
+        if (n == QUERY_MAX_ARGS)
+            return -1;
+        if ((parser->keys[n] = PyUnicode_InternFromString(parser->names[n])) == NULL)
+            return -1;
+        n++;
+    }
+    if (!strchr(parser->format, '|'))
+        parser->n_required = n;
+    PYGETDNS_STORE(parser->n_args, n);
+    return 0;
+}
+
+
+static int
+query_args_index(query_arg_parser *parser, PyObject *key)
+{
+    int i;
+
+    for (i = 0 ; i < parser->n_args ; i++)
+        if (parser->keys[i] == key)
+            return i;
+    for (i = 0 ; i < parser->n_args ; i++)
+        if (PyUnicode_Compare(parser->keys[i], key) == 0)
+            return i;
+    PyErr_Clear();
+    return -1;
+}
+
+
+static int
+query_args_convert(char format, PyObject *value, void *out)
+{
+    const char *s;
+    Py_ssize_t size;
+    long n;
+
+    switch (format)  {
+    case 's':
+        if (!PyUnicode_Check(value) || (s = PyUnicode_AsUTF8AndSize(value, &size)) == NULL ||
+            strlen(s) != (size_t)size)
+            return -1;
+        *(const char **)out = s;
+        return 0;
+
+    case 'H':
+        if (!PyLong_Check(value))
+            return -1;
+        *(unsigned short *)out = (unsigned short)PyLong_AsUnsignedLongMask(value);
+        return PyErr_Occurred() ? -1 : 0;
+
+    case 'i':
+        if (!PyLong_Check(value))
+            return -1;
+        n = PyLong_AsLong(value);
+        if ((n == -1 && PyErr_Occurred()) || n < INT_MIN || n > INT_MAX)
+            return -1;
+        *(int *)out = (int)n;
+        return 0;
+
+    case 'L':
+        if (!PyLong_Check(value))
+            return -1;
+        *(long long *)out = PyLong_AsLongLong(value);
+        return PyErr_Occurred() ? -1 : 0;
+
+    case 'O':
+        *(PyObject **)out = value;
+        return 0;
+    }
+    return -1;
+}
+
+
+/*
+ * returns 1 on success and 0 on failure, like the function it
+ * replaces; callers set the exception
+ */
+
+int
+query_args_parse(query_arg_parser *parser, PyObject *const *args, Py_ssize_t nargs,
+                 PyObject *kwnames, ...)
+{
+    PyObject *values[QUERY_MAX_ARGS] = { 0 };
+    Py_ssize_t n_kw = kwnames ? PyTuple_GET_SIZE(kwnames) : 0;
+    Py_ssize_t i;
+    const char *p;
+    int index;
+    int ok = 1;
+    va_list outs;
+
+    if (PYGETDNS_LOAD(parser->n_args) == 0)  {
+        PYGETDNS_MUTEX_LOCK(query_args_mutex);
+        ok = parser->n_args != 0 || query_args_keys(parser) == 0;
+        PYGETDNS_MUTEX_UNLOCK(query_args_mutex);
+        if (!ok)
+            return 0;
+    }
+    if (nargs > parser->n_args)
+        return 0;
+    for (i = 0 ; i < nargs ; i++)
+        values[i] = args[i];
+    for (i = 0 ; i < n_kw ; i++)  {
+        if ((index = query_args_index(parser, PyTuple_GET_ITEM(kwnames, i))) < 0 ||
+            values[index])
+            return 0;
+        values[index] = args[nargs + i];
+    }
+    for (i = 0 ; i < parser->n_required ; i++)
+        if (values[i] == NULL)
+            return 0;
+
+    va_start(outs, kwnames);
+    for (p = parser->format, i = 0 ; *p ; p++)  {
+        void *out;
+
+        if (*p == '|')
+            continue;
+        out = va_arg(outs, void *);
+        if (values[i] && query_args_convert(*p, values[i], out) < 0)  {
+            ok = 0;
+            break;
+        }
+        i++;
+    }
+    va_end(outs);
+    return ok;
+}
+
+#endif /* QUERY_FASTCALL */
@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <getdns/getdns.h>
+#include <getdns/getdns_extra.h>
+#include "pygetdns.h"
+
+#if PY_MAJOR_VERSION >= 3
+
+/*
+ * A getdns_eventloop whose sockets and timers are driven by an
+ * asyncio event loop.  getdns schedules its read, write and
+ * timeout events through the vmt below and we map them onto
+ * add_reader(), add_writer() and call_later(), so queries made
+ * with the *_async() methods are multiplexed with everything else
+ * running on that loop.
+ */
+
+struct pygetdns_asyncio_loop  {
+    getdns_eventloop base;          /* must be first */
+    getdns_ContextObject *owner;    /* not a reference */
+    PyObject *loop;                 /* the asyncio event loop */
+};
+
+/*
+ * per-event state, owned by a capsule that's handed to asyncio
+ * as the self of our ready callbacks.  asyncio may still hold
+ * a handle after getdns has cleared the event, so the capsule
+ * outlives the getdns_eventloop_event and event goes to NULL
+ */
+
+typedef struct  {
+    getdns_eventloop_event *event;
+    pygetdns_asyncio_loop *aloop;
+    int fd;
+    int reading;
+    int writing;
+    PyObject *timer;                /* asyncio.TimerHandle */
+} asyncio_event;
+
+#define ASYNCIO_EVENT_READ      0
+#define ASYNCIO_EVENT_WRITE     1
+#define ASYNCIO_EVENT_TIMEOUT   2
+
+typedef enum  {
+    ASYNC_GENERAL,
+    ASYNC_ADDRESS,
+    ASYNC_HOSTNAME,
+    ASYNC_SERVICE
+} async_query_kind;
+
+
+static PyObject *
+asyncio_event_ready(PyObject *capsule, int which)
+{
+    asyncio_event *ae;
+    getdns_eventloop_event *event;
+    getdns_eventloop_callback cb;
+    getdns_ContextObject *owner;
+
+    if ((ae = PyCapsule_GetPointer(capsule, "asyncio_event")) == NULL)
+        return NULL;
+    if ((event = ae->event) == NULL)    /* cleared after asyncio queued us */
+        Py_RETURN_NONE;
+    if (which == ASYNCIO_EVENT_READ)
+        cb = event->read_cb;
+    else if (which == ASYNCIO_EVENT_WRITE)
+        cb = event->write_cb;
+    else
+        cb = event->timeout_cb;
+    if (!cb)
+        Py_RETURN_NONE;
+    owner = ae->aloop->owner;
+    Py_INCREF(owner);
+    PYGETDNS_BEGIN_LOCKED(owner);
+    context_lock(owner);
+    cb(event->userarg);
+    context_unlock(owner);
+    PYGETDNS_END_LOCKED();
+    Py_DECREF(owner);
+    if (PyErr_Occurred())
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject *
+asyncio_read_ready(PyObject *capsule, PyObject *unused)
+{
+    return asyncio_event_ready(capsule, ASYNCIO_EVENT_READ);
+}
+
+
+static PyObject *
+asyncio_write_ready(PyObject *capsule, PyObject *unused)
+{
+    return asyncio_event_ready(capsule, ASYNCIO_EVENT_WRITE);
+}
+
+
+static PyObject *
+asyncio_timeout_ready(PyObject *capsule, PyObject *unused)
+{
+    return asyncio_event_ready(capsule, ASYNCIO_EVENT_TIMEOUT);
+}
+
+
+static PyMethodDef asyncio_read_def = {
+    "_getdns_read_ready", (PyCFunction)asyncio_read_ready, METH_NOARGS, NULL
+};
+static PyMethodDef asyncio_write_def = {
+    "_getdns_write_ready", (PyCFunction)asyncio_write_ready, METH_NOARGS, NULL
+};
+static PyMethodDef asyncio_timeout_def = {
+    "_getdns_timeout_ready", (PyCFunction)asyncio_timeout_ready, METH_NOARGS, NULL
+};
+
+
+static void
+asyncio_event_free(PyObject *capsule)
+{
+    asyncio_event *ae = PyCapsule_GetPointer(capsule, "asyncio_event");
+
+    Py_XDECREF(ae->timer);
+    PyMem_Free(ae);
+}
+
+
+static int
+asyncio_watch_fd(PyObject *loop, char *method, int fd, PyMethodDef *def, PyObject *capsule)
+{
+    PyObject *func;
+    PyObject *ret;
+
+    if ((func = PyCFunction_New(def, capsule)) == NULL)
+        return -1;
+    ret = PyObject_CallMethod(loop, method, "iO", fd, func);
+    Py_DECREF(func);
+    if (ret == NULL)
+        return -1;
+    Py_DECREF(ret);
+    return 0;
+}
+
+
+static void
+asyncio_unwatch_fd(PyObject *loop, char *method, int fd)
+{
+    PyObject *ret;
+
+    if ((ret = PyObject_CallMethod(loop, method, "i", fd)) == NULL)
+        PyErr_WriteUnraisable(loop);
+    else
+        Py_DECREF(ret);
+}
+
+
+static getdns_return_t
+asyncio_loop_clear(getdns_eventloop *loop, getdns_eventloop_event *event)
+{
+    pygetdns_asyncio_loop *aloop = (pygetdns_asyncio_loop *)loop;
+    PyObject *capsule = (PyObject *)event->ev;
+    asyncio_event *ae;
+    PyObject *ret;
+
+    if (!capsule)
+        return GETDNS_RETURN_GOOD;
+    ae = PyCapsule_GetPointer(capsule, "asyncio_event");
+    if (ae->reading)
+        asyncio_unwatch_fd(aloop->loop, "remove_reader", ae->fd);
+    if (ae->writing)
+        asyncio_unwatch_fd(aloop->loop, "remove_writer", ae->fd);
+    if (ae->timer)  {
+        if ((ret = PyObject_CallMethod(ae->timer, "cancel", NULL)) == NULL)
+            PyErr_WriteUnraisable(aloop->loop);
+        else
+            Py_DECREF(ret);
+        Py_CLEAR(ae->timer);
+    }
+    ae->event = NULL;
+    event->ev = NULL;
+    Py_DECREF(capsule);
+    return GETDNS_RETURN_GOOD;
+}
+
+
+static getdns_return_t
+asyncio_loop_schedule(getdns_eventloop *loop, int fd, uint64_t timeout,
+                      getdns_eventloop_event *event)
+{
+    pygetdns_asyncio_loop *aloop = (pygetdns_asyncio_loop *)loop;
+    asyncio_event *ae;
+    PyObject *capsule;
+    PyObject *func;
+
+    if ((ae = PyMem_Malloc(sizeof(asyncio_event))) == NULL)
+        return GETDNS_RETURN_MEMORY_ERROR;
+    ae->event = event;
+    ae->aloop = aloop;
+    ae->fd = fd;
+    ae->reading = 0;
+    ae->writing = 0;
+    ae->timer = 0;
+    if ((capsule = PyCapsule_New(ae, "asyncio_event", asyncio_event_free)) == NULL)  {
+        PyMem_Free(ae);
+        PyErr_WriteUnraisable(aloop->loop);
+        return GETDNS_RETURN_MEMORY_ERROR;
+    }
+    event->ev = capsule;
+    if (fd >= 0 && event->read_cb)  {
+        if (asyncio_watch_fd(aloop->loop, "add_reader", fd, &asyncio_read_def, capsule) < 0)
+            goto error;
+        ae->reading = 1;
+    }
+    if (fd >= 0 && event->write_cb)  {
+        if (asyncio_watch_fd(aloop->loop, "add_writer", fd, &asyncio_write_def, capsule) < 0)
+            goto error;
+        ae->writing = 1;
+    }
+    if (event->timeout_cb && timeout != TIMEOUT_FOREVER)  {
+        if ((func = PyCFunction_New(&asyncio_timeout_def, capsule)) == NULL)
+            goto error;
+        ae->timer = PyObject_CallMethod(aloop->loop, "call_later", "dO",
+                                        (double)timeout / 1000.0, func);
+        Py_DECREF(func);
+        if (ae->timer == NULL)
+            goto error;
+    }
+    return GETDNS_RETURN_GOOD;
+
+error:
+    PyErr_WriteUnraisable(aloop->loop);
+    (void)asyncio_loop_clear(loop, event);
+    return GETDNS_RETURN_GENERIC_ERROR;
+}
+
+
+static void
+asyncio_loop_cleanup(getdns_eventloop *loop)
+{
+    pygetdns_asyncio_loop *aloop = (pygetdns_asyncio_loop *)loop;
+
+    if (aloop->owner->asyncio_loop == aloop)
+        aloop->owner->asyncio_loop = 0;
+    Py_XDECREF(aloop->loop);
+    PyMem_Free(aloop);
+}
+
+
+/*
+ * asyncio owns the loop, so there's nothing for getdns to run
+ */
+
+static void
+asyncio_loop_run(getdns_eventloop *loop)
+{
+    UNUSED_PARAM(loop);
+}
+
+
+static void
+asyncio_loop_run_once(getdns_eventloop *loop, int blocking)
+{
+    UNUSED_PARAM(loop);
+    UNUSED_PARAM(blocking);
+}
+
+
+static getdns_eventloop_vmt asyncio_loop_vmt = {
+    sizeof(pygetdns_asyncio_loop),
+    asyncio_loop_cleanup,
+    asyncio_loop_schedule,
+    asyncio_loop_clear,
+    asyncio_loop_run,
+    asyncio_loop_run_once
+};
+
+
+/*
+ * point the context's getdns eventloop at an asyncio loop.
+ * Moving to a different asyncio loop is allowed once the
+ * old one has no queries outstanding
+ */
+
+static int
+context_attach_asyncio(getdns_ContextObject *self, getdns_context *context, PyObject *loop)
+{
+    pygetdns_asyncio_loop *aloop;
+    getdns_return_t ret;
+
+    if (self->event_base)  {
+        PyErr_SetString(getdns_error, "Context is bound to a libevent event base");
+        return -1;
+    }
+    if (self->selector)  {
+        PyErr_SetString(getdns_error, "Context is driven through fileno()");
+        return -1;
+    }
+    if (self->asyncio_loop)  {
+        if (self->asyncio_loop->loop == loop)
+            return 0;
+        if (getdns_context_get_num_pending_requests(context, NULL) > 0)  {
+            PyErr_SetString(getdns_error, "Context has queries outstanding on another event loop");
+            return -1;
+        }
+    }
+    if ((aloop = PyMem_Malloc(sizeof(pygetdns_asyncio_loop))) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        return -1;
+    }
+    aloop->base.vmt = &asyncio_loop_vmt;
+    aloop->owner = self;
+    Py_INCREF(loop);
+    aloop->loop = loop;
+    context_lock(self);
+    ret = getdns_context_set_eventloop(context, &aloop->base);
+    context_unlock(self);
+    if (ret != GETDNS_RETURN_GOOD)  {
+        Py_DECREF(loop);
+        PyMem_Free(aloop);
+        PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
+        return -1;
+    }
+    self->asyncio_loop = aloop;
+    return 0;
+}
+
+
+static char *async_method_names[] = {
+    "general_async",
+    "address_async",
+    "hostname_async",
+    "service_async"
+};
+
+
+/*
+ * The loop to attach to: the running one where asyncio has
+ * get_running_loop(), falling back to get_event_loop() when
+ * called outside a coroutine or on Pythons before 3.7
+ */
+
+static PyObject *
+asyncio_running_loop(PyObject *asyncio)
+{
+    PyObject *loop;
+
+    if (PyObject_HasAttrString(asyncio, "get_running_loop"))  {
+        if ((loop = PyObject_CallMethod(asyncio, "get_running_loop", NULL)) != NULL)
+            return loop;
+        if (!PyErr_ExceptionMatches(PyExc_RuntimeError))
+            return NULL;
+        PyErr_Clear();
+    }
+    return PyObject_CallMethod(asyncio, "get_event_loop", NULL);
+}
+
+
+/*
+ * getdns callback for the *_async() methods.  userarg is the
+ * query's flight, and we hold a reference to it until getdns
+ * calls us.  Each waiting future gets its own Result
+ */
+
+static void
+asyncio_callback(getdns_context *context, getdns_callback_type_t type,
+                 getdns_dict *response, void *userarg, getdns_transaction_t tid)
+{
+    PyObject *capsule = (PyObject *)userarg;
+    query_flight *flight = FLIGHT(capsule);
+    PyObject *waiters;
+    PyObject *future;
+    PyObject *done;
+    PyObject *result = 0;
+    PyObject *value;
+    PyObject *ret;
+    getdns_dict *traced = response;
+    uint64_t completed;
+    uint64_t resolving;
+    int is_done;
+    Py_ssize_t i;
+
+    completed = context_stats_now();
+    context_stats_done(flight->owner->stats, flight->request_type, flight->started,
+                       completed, type, response);
+    resolving = flight->trace.hook ? context_stats_now() : 0;
+    context_flight_land(flight->owner, capsule);
+    waiters = flight->waiters;
+    flight->waiters = 0;
+    for (i = 0 ; i < PyList_GET_SIZE(waiters) ; i++)  {
+        future = PyList_GET_ITEM(waiters, i);
+        if ((done = PyObject_CallMethod(future, "done", NULL)) == NULL)  {
+            PyErr_WriteUnraisable(future);
+            continue;
+        }
+        is_done = PyObject_IsTrue(done);
+        Py_DECREF(done);
+        if (is_done)                /* cancelled from the Python side */
+            continue;
+        switch (type)  {
+        case GETDNS_CALLBACK_COMPLETE:
+        case GETDNS_CALLBACK_TIMEOUT:
+            if (result == NULL)  {
+                value = result = result_create(response);
+                response = 0;
+                Py_XINCREF(value);
+            }  else  {
+                value = result_share(result);
+            }
+            if (value == NULL)  {
+                PyErr_Clear();
+                ret = PyObject_CallMethod(future, "set_exception", "O", PyExc_MemoryError);
+                break;
+            }
+            ret = PyObject_CallMethod(future, "set_result", "O", value);
+            Py_DECREF(value);
+            break;
+
+        case GETDNS_CALLBACK_CANCEL:
+            ret = PyObject_CallMethod(future, "cancel", NULL);
+            break;
+
+        default:
+            if ((value = PyObject_CallFunction(getdns_error, "s", "Query failed")) == NULL)  {
+                ret = NULL;
+                break;
+            }
+            ret = PyObject_CallMethod(future, "set_exception", "O", value);
+            Py_DECREF(value);
+            break;
+        }
+        if (ret == NULL)
+            PyErr_WriteUnraisable(future);
+        else
+            Py_DECREF(ret);
+    }
+    if (flight->trace.hook)
+        context_trace_end(&flight->trace, &tid, flight->request_type, flight->started,
+                          completed, resolving, context_stats_now(), type,
+                          (response || result) ? traced : NULL);
+    if (response)                   /* nobody was left to take it */
+        getdns_dict_destroy(response);
+    Py_XDECREF(result);
+    Py_DECREF(waiters);
+    Py_DECREF(capsule);
+}
+
+
+/*
+ * done callback on each waiting future; self is the flight.  If
+ * the caller cancelled it and nobody else is waiting on the
+ * query, we pass that along to getdns
+ */
+
+static PyObject *
+asyncio_future_cancelled(PyObject *capsule, PyObject *future)
+{
+    query_flight *flight = FLIGHT(capsule);
+    getdns_ContextObject *self = flight->owner;
+    getdns_context *context;
+    PyObject *cancelled;
+    int is_cancelled;
+    Py_ssize_t i;
+
+    if ((cancelled = PyObject_CallMethod(future, "cancelled", NULL)) == NULL)
+        return NULL;
+    is_cancelled = PyObject_IsTrue(cancelled);
+    Py_DECREF(cancelled);
+    if (!is_cancelled || flight->waiters == NULL)
+        Py_RETURN_NONE;
+    for (i = 0 ; i < PyList_GET_SIZE(flight->waiters) ; i++)  {
+        if (PyList_GET_ITEM(flight->waiters, i) == future)  {
+            if (PySequence_DelItem(flight->waiters, i) < 0)
+                return NULL;
+            break;
+        }
+    }
+    if (PyList_GET_SIZE(flight->waiters) == 0 && flight->pending &&
+        (context = PyCapsule_GetPointer(self->py_context, "context")) != NULL)  {
+        context_flight_land(self, capsule);
+        context_lock(self);
+        (void)getdns_cancel_callback(context, flight->tid);
+        context_unlock(self);
+    }
+    if (PyErr_Occurred())
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject *
+asyncio_future_done(PyObject *capsule, PyObject *future)
+{
+    PyObject *ret;
+
+    PYGETDNS_BEGIN_LOCKED(FLIGHT(capsule)->owner);
+    ret = asyncio_future_cancelled(capsule, future);
+    PYGETDNS_END_LOCKED();
+    return ret;
+}
+
+
+static PyMethodDef asyncio_future_done_def = {
+    "_getdns_future_done", (PyCFunction)asyncio_future_done, METH_O, NULL
+};
+
+
+/*
+ * start a query, or join an identical one that's already in
+ * flight, and return a future for its Result.  Reverse lookups
+ * aren't shared
+ */
+
+static PyObject *
+context_query_async(getdns_ContextObject *self, async_query_kind kind, char *name,
+                    uint16_t request_type, PyObject *address, PyObject *extensions_obj)
+{
+    getdns_context *context;
+    struct getdns_dict *extensions_dict = 0;
+    struct getdns_dict *addr_dict = 0;
+    PyObject *asyncio;
+    PyObject *loop = 0;
+    PyObject *future = 0;
+    PyObject *query_key = 0;
+    PyObject *flight = 0;
+    PyObject *done_func;
+    PyObject *ret;
+    getdns_transaction_t tid;
+    getdns_return_t gret;
+
+    if ((context = context_get(self)) == NULL)
+        return NULL;
+    if (kind != ASYNC_HOSTNAME &&
+        (query_key = context_query_key(async_method_names[kind], name, request_type, extensions_obj)) == NULL)
+        return NULL;
+    if ((asyncio = PyImport_ImportModule("asyncio")) == NULL)
+        goto error;
+    loop = asyncio_running_loop(asyncio);
+    Py_DECREF(asyncio);
+    if (loop == NULL)
+        goto error;
+    if (context_attach_asyncio(self, context, loop) < 0)
+        goto error;
+    if ((future = PyObject_CallMethod(loop, "create_future", NULL)) == NULL)
+        goto error;
+
+    if ((flight = context_flight_find(self, query_key)) != NULL)  {
+        Py_INCREF(flight);
+        self->queries_coalesced++;
+        if (PyList_Append(FLIGHT(flight)->waiters, future) < 0)
+            goto error;
+    }  else  {
+        if (extensions_get(extensions_obj, &extensions_dict) < 0)  {
+            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+            goto error;
+        }
+        if (kind == ASYNC_HOSTNAME && (addr_dict = getdnsify_addressdict(address)) == NULL)
+            goto error;
+        if ((flight = context_flight_new(self, query_key, 0)) == NULL)
+            goto error;
+        if (PyList_Append(FLIGHT(flight)->waiters, future) < 0)  {
+            context_flight_land(self, flight);
+            goto error;
+        }
+        Py_INCREF(flight);      /* released by asyncio_callback */
+        FLIGHT(flight)->request_type = kind == ASYNC_HOSTNAME ? GETDNS_RRTYPE_PTR :
+            kind == ASYNC_SERVICE ? GETDNS_RRTYPE_SRV : request_type;
+        if (self->trace_hook)
+            context_trace_begin(self, name, address, &FLIGHT(flight)->trace);
+        context_lock(self);
+        FLIGHT(flight)->started = context_stats_submit(self->stats);
+        switch (kind)  {
+        case ASYNC_GENERAL:
+            gret = getdns_general(context, name, request_type, extensions_dict,
+                                  (void *)flight, &tid, asyncio_callback);
+            break;
+        case ASYNC_ADDRESS:
+            gret = getdns_address(context, name, extensions_dict,
+                                  (void *)flight, &tid, asyncio_callback);
+            break;
+        case ASYNC_HOSTNAME:
+            gret = getdns_hostname(context, addr_dict, extensions_dict,
+                                   (void *)flight, &tid, asyncio_callback);
+            break;
+        default:
+            gret = getdns_service(context, name, extensions_dict,
+                                  (void *)flight, &tid, asyncio_callback);
+            break;
+        }
+        context_unlock(self);
+        if (gret != GETDNS_RETURN_GOOD)  {
+            context_stats_done(self->stats, FLIGHT(flight)->request_type, FLIGHT(flight)->started,
+                               context_stats_now(), GETDNS_CALLBACK_ERROR, NULL);
+            context_flight_land(self, flight);
+            Py_DECREF(flight);
+            PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(gret));
+            goto error;
+        }
+        FLIGHT(flight)->tid = tid;
+    }
+
+    done_func = PyCFunction_New(&asyncio_future_done_def, flight);
+    if (done_func == NULL)
+        goto error;
+    ret = PyObject_CallMethod(future, "add_done_callback", "O", done_func);
+    Py_DECREF(done_func);
+    if (ret == NULL)
+        goto error;
+    Py_DECREF(ret);
+    Py_DECREF(flight);
+    Py_DECREF(loop);
+    Py_XDECREF(query_key);
+    extensions_put(extensions_obj, extensions_dict);
+    getdns_dict_destroy(addr_dict);
+    return future;
+
+error:
+    Py_XDECREF(flight);
+    Py_XDECREF(future);
+    Py_XDECREF(loop);
+    Py_XDECREF(query_key);
+    extensions_put(extensions_obj, extensions_dict);
+    getdns_dict_destroy(addr_dict);
+    return NULL;
+}
+
+
+PyObject *
+context_general_async(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "name",
+        "request_type",
+        "extensions",
+        0
+    };
+    char *name;
+    uint16_t request_type;
+    PyObject *extensions_obj = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "sH|O", kwlist,
+                                     &name, &request_type, &extensions_obj))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    return context_query_async(self, ASYNC_GENERAL, name, request_type, 0, extensions_obj);
+}
+
+
+PyObject *
+context_address_async(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "name",
+        "extensions",
+        0
+    };
+    char *name;
+    PyObject *extensions_obj = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|O", kwlist,
+                                     &name, &extensions_obj))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    return context_query_async(self, ASYNC_ADDRESS, name, 0, 0, extensions_obj);
+}
+
+
+PyObject *
+context_hostname_async(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "address",
+        "extensions",
+        0
+    };
+    PyObject *address;
+    PyObject *extensions_obj = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|O", kwlist,
+                                     &address, &extensions_obj))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    return context_query_async(self, ASYNC_HOSTNAME, 0, 0, address, extensions_obj);
+}
+
+
+PyObject *
+context_service_async(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "name",
+        "extensions",
+        0
+    };
+    char *name;
+    PyObject *extensions_obj = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|O", kwlist,
+                                     &name, &extensions_obj))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    return context_query_async(self, ASYNC_SERVICE, name, 0, 0, extensions_obj);
+}
+
+#endif /* PY_MAJOR_VERSION >= 3 */
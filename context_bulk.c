@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <getdns/getdns.h>
+#include <event2/event.h>
+#include <getdns/getdns_ext_libevent.h>
+#include "pygetdns.h"
+
+#define BULK_DEFAULT_CONCURRENCY 64
+#define BULK_SIGNAL_USEC 100000     /* how often to look for signals */
+
+/*
+ * Context.bulk() resolves a whole list of (name, rrtype) queries
+ * in one call.  The queries are copied into C up front, then
+ * submitted to the context's event base from C with at most
+ * `concurrency' outstanding at a time; each completion stashes
+ * its response and submits the next query.  The event loop runs
+ * without the GIL, and nothing is converted to Python until
+ * every query has come back.  Every BULK_SIGNAL_USEC a timer
+ * of ours ends the wait so the GIL can be taken back to check
+ * for signals; an exception from a signal handler cancels what's
+ * still pending.
+ */
+
+struct bulk_state;
+
+typedef struct  {
+    struct bulk_state *state;
+    char *name;
+    uint16_t request_type;
+    int pending;
+    getdns_transaction_t tid;
+    getdns_dict *response;
+    getdns_callback_type_t type;    /* how it finished */
+    uint64_t started;               /* 0 if it was never submitted */
+    uint64_t finished;
+} bulk_query;
+
+typedef struct bulk_state  {
+    getdns_context *context;
+    getdns_dict *extensions;
+    pygetdns_stats *stats;
+    bulk_query *queries;
+    size_t n_queries;
+    size_t next;                /* index of the next query to submit */
+    size_t outstanding;
+    size_t concurrency;
+    int submitting;             /* bulk_submit() is on the stack */
+} bulk_state;
+
+
+static void bulk_submit(bulk_state *state);
+
+
+static void
+bulk_callback(getdns_context *context, getdns_callback_type_t type,
+              getdns_dict *response, void *userarg, getdns_transaction_t tid)
+{
+    bulk_query *query = (bulk_query *)userarg;
+
+    query->type = type;
+    query->finished = context_stats_now();
+    if (type == GETDNS_CALLBACK_CANCEL)
+        getdns_dict_destroy(response);
+    else
+        query->response = response;
+    query->pending = 0;
+    context_stats_returned(query->state->stats);
+    query->state->outstanding--;
+    if (!query->state->submitting)
+        bulk_submit(query->state);
+}
+
+
+/*
+ * top the window back up.  A query that getdns refuses
+ * outright is left with no response.  Callbacks that getdns
+ * makes from inside getdns_general() only open the window,
+ * and this loop refills it, so the stack doesn't grow with
+ * the number of queries
+ */
+
+static void
+bulk_submit(bulk_state *state)
+{
+    bulk_query *query;
+
+    state->submitting = 1;
+    while (state->next < state->n_queries && state->outstanding < state->concurrency)  {
+        query = &state->queries[state->next++];
+        query->pending = 1;
+        state->outstanding++;
+        query->started = context_stats_submit(state->stats);
+        if (getdns_general(state->context, query->name, query->request_type,
+                           state->extensions, (void *)query, &query->tid,
+                           bulk_callback) != GETDNS_RETURN_GOOD)  {
+            query->pending = 0;
+            query->type = GETDNS_CALLBACK_ERROR;
+            query->finished = context_stats_now();
+            context_stats_returned(state->stats);
+            state->outstanding--;
+        }
+    }
+    state->submitting = 0;
+}
+
+
+static void
+bulk_tick_cb(evutil_socket_t fd, short what, void *arg)
+{
+    *(int *)arg = 1;
+}
+
+
+PyObject *
+context_bulk(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "queries",
+        "extensions",
+        "concurrency",
+        0
+    };
+    getdns_context *context;
+    PyObject *queries_obj;
+    PyObject *queries_seq;
+    PyObject *extensions_obj = 0;
+    int concurrency = BULK_DEFAULT_CONCURRENCY;
+    bulk_state state;
+    char **names;
+    size_t *name_lens;
+    size_t names_size = 0;
+    char *name_buf = 0;
+    char *p;
+    PyObject *py_results = 0;
+    PyObject *py_result;
+    bulk_query *query;
+    query_trace trace = { 0, 0 };
+    struct event *tick = 0;
+    struct timeval tv = { 0, BULK_SIGNAL_USEC };
+    int ticked;
+    int ret = 0;
+    int interrupted = 0;
+    size_t i;
+
+    if ((context = context_get(self)) == NULL)
+        return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|Oi", kwlist,
+                                     &queries_obj, &extensions_obj, &concurrency))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if (concurrency < 1)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if (self->selector)  {
+        PyErr_SetString(getdns_error, "Context is driven through fileno()");
+        return NULL;
+    }
+    if ((queries_seq = PySequence_Fast(queries_obj, "queries must be a sequence")) == NULL)
+        return NULL;
+
+    memset(&state, 0, sizeof(state));
+    state.context = context;
+    state.stats = self->stats;
+    state.n_queries = (size_t)PySequence_Fast_GET_SIZE(queries_seq);
+    state.concurrency = (size_t)concurrency;
+    state.queries = (bulk_query *)PyMem_Malloc((state.n_queries + 1) * sizeof(bulk_query));
+    names = (char **)PyMem_Malloc((state.n_queries + 1) * sizeof(char *));
+    name_lens = (size_t *)PyMem_Malloc((state.n_queries + 1) * sizeof(size_t));
+    if (!state.queries || !names || !name_lens)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        goto done;
+    }
+    memset(state.queries, 0, (state.n_queries + 1) * sizeof(bulk_query));
+
+    /*
+     * copy the names into one buffer, since the Python strings
+     * aren't ours to hold on to once the GIL has been dropped
+     */
+    for (i = 0 ; i < state.n_queries ; i++)  {
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(queries_seq, i), "sH",
+                              &names[i], &state.queries[i].request_type))  {
+            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+            goto done;
+        }
+        name_lens[i] = strlen(names[i]) + 1;
+        names_size += name_lens[i];
+    }
+    if ((name_buf = (char *)PyMem_Malloc(names_size + 1)) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        goto done;
+    }
+    for (i = 0, p = name_buf ; i < state.n_queries ; p += name_lens[i], i++)  {
+        memcpy(p, names[i], name_lens[i]);
+        state.queries[i].state = &state;
+        state.queries[i].name = p;
+    }
+    if (extensions_get(extensions_obj, &state.extensions) < 0)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        goto done;
+    }
+    if (context_attach_libevent(self, context) < 0)
+        goto done;
+    if ((tick = evtimer_new(self->event_base, bulk_tick_cb, &ticked)) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        goto done;
+    }
+
+    context_lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    bulk_submit(&state);
+    Py_END_ALLOW_THREADS
+    while (state.outstanding > 0 && ret == 0)  {
+        ticked = 0;
+        evtimer_add(tick, &tv);
+        Py_BEGIN_ALLOW_THREADS
+        while (state.outstanding > 0 && !ticked)  {
+            if ((ret = event_base_loop(self->event_base, EVLOOP_ONCE)) != 0)
+                break;
+        }
+        Py_END_ALLOW_THREADS
+        evtimer_del(tick);
+        if (PyErr_CheckSignals() < 0)  {
+            interrupted = 1;
+            break;
+        }
+    }
+    if (state.outstanding > 0)  {   /* interrupted, or the event loop gave up on us */
+        state.next = state.n_queries;
+        for (i = 0 ; i < state.n_queries ; i++)  {
+            if (state.queries[i].pending)
+                (void)getdns_cancel_callback(context, state.queries[i].tid);
+        }
+    }
+    context_unlock(self);
+    if (interrupted)
+        goto done;
+
+    /*
+     * the counts of queries submitted and outstanding are kept as
+     * they go, but histograms and traces want the GIL, so they're
+     * caught up afterwards
+     */
+    for (i = 0 ; i < state.n_queries ; i++)  {
+        query = &state.queries[i];
+        if (query->started == 0)
+            continue;
+        context_stats_record(self->stats, query->request_type, query->started,
+                             query->finished, query->type, query->response);
+        if (self->trace_hook)  {
+            context_trace_begin(self, query->name, NULL, &trace);
+            context_trace_end(&trace, query->type == GETDNS_CALLBACK_ERROR ? NULL : &query->tid,
+                              query->request_type, query->started, query->finished, 0, 0,
+                              query->type, query->response);
+        }
+    }
+
+    if ((py_results = PyList_New((Py_ssize_t)state.n_queries)) == NULL)
+        goto done;
+    for (i = 0 ; i < state.n_queries ; i++)  {
+        if (state.queries[i].response)  {
+            py_result = result_create(state.queries[i].response);
+            state.queries[i].response = 0;
+            if (py_result == NULL)  {
+                Py_CLEAR(py_results);
+                goto done;
+            }
+        }  else  {
+            Py_INCREF(Py_None);
+            py_result = Py_None;
+        }
+        PyList_SET_ITEM(py_results, (Py_ssize_t)i, py_result);
+    }
+
+done:
+    if (tick)
+        event_free(tick);
+    if (state.queries)  {
+        for (i = 0 ; i < state.n_queries ; i++)
+            getdns_dict_destroy(state.queries[i].response);
+    }
+    extensions_put(extensions_obj, state.extensions);
+    PyMem_Free(name_buf);
+    PyMem_Free(name_lens);
+    PyMem_Free(names);
+    PyMem_Free(state.queries);
+    Py_DECREF(queries_seq);
+    return py_results;
+}
@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <Python.h>
+#include <time.h>
+#include <getdns/getdns.h>
+#include "pygetdns.h"
+
+/*
+ * An optional cache of synchronous query responses, enabled by
+ * setting Context.cache_size to the maximum number of entries.
+ * Entries are keyed on the method, the lower-cased name, the
+ * request type and the extensions (which is also where the
+ * query class comes from), and expire with the smallest TTL in
+ * the answer, or in the authority section for negative answers.
+ *
+ * The cache keeps a Result that owns the response; each hit
+ * hands out a new Result that borrows the response from it, so
+ * no getdns data is copied and the caller gets its own
+ * attribute values.  The least recently used entry is evicted
+ * when the cache is full.  Everything here runs with the GIL
+ * held.
+ */
+
+typedef struct cache_entry  {
+    struct cache_entry *prev;
+    struct cache_entry *next;
+    PyObject *key;
+    PyObject *result;           /* owns the response */
+    double expires;
+} cache_entry;
+
+struct pygetdns_cache  {
+    PyObject *entries;          /* key -> capsule holding a cache_entry */
+    cache_entry lru;            /* list head; lru.next is the most recent */
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long expirations;
+};
+
+
+static double
+cache_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+static void
+cache_unlink(cache_entry *entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+}
+
+
+static void
+cache_link(pygetdns_cache *cache, cache_entry *entry)
+{
+    entry->next = cache->lru.next;
+    entry->prev = &cache->lru;
+    cache->lru.next->prev = entry;
+    cache->lru.next = entry;
+}
+
+
+static void
+cache_remove(pygetdns_cache *cache, cache_entry *entry)
+{
+    cache_unlink(entry);
+    (void)PyDict_DelItem(cache->entries, entry->key);
+    Py_DECREF(entry->key);
+    Py_DECREF(entry->result);
+    PyMem_Free(entry);
+}
+
+
+/*
+ * smallest TTL of the records in one section of each reply.
+ * Returns 0 if there aren't any
+ */
+
+static int
+section_min_ttl(struct getdns_list *replies, char *section_name, uint32_t *min_ttl)
+{
+    struct getdns_dict *reply;
+    struct getdns_list *section;
+    struct getdns_dict *rr;
+    size_t n_replies;
+    size_t n_rrs;
+    size_t i, j;
+    uint32_t ttl;
+    int found = 0;
+
+    if (getdns_list_get_length(replies, &n_replies) != GETDNS_RETURN_GOOD)
+        return 0;
+    for (i = 0 ; i < n_replies ; i++)  {
+        if (getdns_list_get_dict(replies, i, &reply) != GETDNS_RETURN_GOOD ||
+            getdns_dict_get_list(reply, section_name, &section) != GETDNS_RETURN_GOOD ||
+            getdns_list_get_length(section, &n_rrs) != GETDNS_RETURN_GOOD)
+            continue;
+        for (j = 0 ; j < n_rrs ; j++)  {
+            if (getdns_list_get_dict(section, j, &rr) != GETDNS_RETURN_GOOD ||
+                getdns_dict_get_int(rr, "ttl", &ttl) != GETDNS_RETURN_GOOD)
+                continue;
+            if (!found || ttl < *min_ttl)
+                *min_ttl = ttl;
+            found = 1;
+        }
+    }
+    return found;
+}
+
+
+/*
+ * how long a response may be cached for, in seconds.  Only
+ * good and NXDOMAIN responses are kept; timeouts and the like
+ * get 0
+ */
+
+static uint32_t
+response_ttl(struct getdns_dict *response)
+{
+    uint32_t status;
+    struct getdns_list *replies;
+    uint32_t ttl = 0;
+
+    if (response == NULL ||
+        getdns_dict_get_int(response, "status", &status) != GETDNS_RETURN_GOOD)
+        return 0;
+    if (status != GETDNS_RESPSTATUS_GOOD && status != GETDNS_RESPSTATUS_NO_NAME)
+        return 0;
+    if (getdns_dict_get_list(response, "replies_tree", &replies) != GETDNS_RETURN_GOOD)
+        return 0;
+    if (section_min_ttl(replies, "answer", &ttl) || section_min_ttl(replies, "authority", &ttl))
+        return ttl;
+    return 0;
+}
+
+
+/*
+ * drop every entry, keeping the counters.  Called when a setting
+ * changes, since the cached answers might no longer be the ones
+ * we'd get
+ */
+
+void
+context_cache_flush(getdns_ContextObject *self)
+{
+    pygetdns_cache *cache = self->cache;
+
+    if (cache == NULL)
+        return;
+    while (cache->lru.next != &cache->lru)
+        cache_remove(cache, cache->lru.next);
+}
+
+
+/*
+ * flush, and zero the counters too: for a pooled Context given
+ * back, so that the next lessee starts afresh
+ */
+
+void
+context_cache_reset(getdns_ContextObject *self)
+{
+    pygetdns_cache *cache = self->cache;
+
+    if (cache == NULL)
+        return;
+    context_cache_flush(self);
+    cache->hits = cache->misses = 0;
+    cache->evictions = cache->expirations = 0;
+}
+
+
+void
+context_cache_free(getdns_ContextObject *self)
+{
+    if (self->cache == NULL)
+        return;
+    context_cache_flush(self);
+    Py_DECREF(self->cache->entries);
+    PyMem_Free(self->cache);
+    self->cache = NULL;
+}
+
+
+/*
+ * setter for Context.cache_size.  Shrinking the cache evicts
+ * the least recently used entries; 0 turns it off and drops it
+ */
+
+int
+context_set_cache_size(getdns_ContextObject *self, PyObject *py_value)
+{
+    long value;
+    pygetdns_cache *cache;
+
+#if PY_MAJOR_VERSION >= 3
+    if (!PyLong_Check(py_value))  {
+#else
+    if (!PyInt_Check(py_value) && !PyLong_Check(py_value))  {
+#endif
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return -1;
+    }
+    value = PyLong_AsLong(py_value);
+    if (value < 0 || value > PY_SSIZE_T_MAX)  {
+        if (!PyErr_Occurred())
+            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return -1;
+    }
+    if (value == 0)  {
+        context_cache_free(self);
+        self->cache_size = 0;
+        return 0;
+    }
+    if ((cache = self->cache) == NULL)  {
+        if ((cache = (pygetdns_cache *)PyMem_Malloc(sizeof(pygetdns_cache))) == NULL)  {
+            PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+            return -1;
+        }
+        memset(cache, 0, sizeof(pygetdns_cache));
+        if ((cache->entries = PyDict_New()) == NULL)  {
+            PyMem_Free(cache);
+            return -1;
+        }
+        cache->lru.next = cache->lru.prev = &cache->lru;
+        self->cache = cache;
+    }
+    self->cache_size = (Py_ssize_t)value;
+    while (PyDict_Size(cache->entries) > self->cache_size)  {
+        cache_remove(cache, cache->lru.prev);
+        cache->evictions++;
+    }
+    return 0;
+}
+
+
+/*
+ * build the key for a query, used by the cache and to spot
+ * identical queries in flight, or NULL with an exception set.
+ * The extensions are keyed as extensions_key() says, so that
+ * equal dicts, and Extensions made from them, give equal keys
+ */
+
+PyObject *
+context_query_key(char *method, char *name, uint16_t request_type, PyObject *extensions)
+{
+    PyObject *py_name;
+    PyObject *lower;
+    PyObject *py_extensions;
+    PyObject *key;
+
+#if PY_MAJOR_VERSION >= 3
+    if ((py_name = PyUnicode_FromString(name)) == NULL)
+#else
+    if ((py_name = PyString_FromString(name)) == NULL)
+#endif
+        return NULL;
+    lower = PyObject_CallMethod(py_name, "lower", NULL);
+    Py_DECREF(py_name);
+    if (lower == NULL)
+        return NULL;
+    if ((py_extensions = extensions_key(extensions)) == NULL)  {
+        Py_DECREF(lower);
+        return NULL;
+    }
+    key = Py_BuildValue("(sNiN)", method, lower, (int)request_type, py_extensions);
+    return key;
+}
+
+
+/*
+ * a new Result for the cached response under key, or NULL if
+ * there isn't a live one (check PyErr_Occurred())
+ */
+
+PyObject *
+context_cache_lookup(getdns_ContextObject *self, PyObject *key)
+{
+    pygetdns_cache *cache = self->cache;
+    PyObject *capsule;
+    cache_entry *entry;
+
+    if ((capsule = PyDict_GetItem(cache->entries, key)) == NULL)  {
+        cache->misses++;
+        return NULL;
+    }
+    entry = (cache_entry *)PyCapsule_GetPointer(capsule, NULL);
+    if (entry->expires <= cache_now())  {
+        cache_remove(cache, entry);
+        cache->expirations++;
+        cache->misses++;
+        return NULL;
+    }
+    cache_unlink(entry);
+    cache_link(cache, entry);
+    cache->hits++;
+    return result_share(entry->result);
+}
+
+
+/*
+ * offer a freshly fetched Result to the cache.  Consumes the
+ * reference to result and returns the Result to hand back to
+ * the caller, which is a new one borrowing the response if it
+ * was cached
+ */
+
+PyObject *
+context_cache_insert(getdns_ContextObject *self, PyObject *key, PyObject *result)
+{
+    pygetdns_cache *cache = self->cache;
+    PyObject *capsule;
+    cache_entry *entry;
+    uint32_t ttl;
+
+    if (result == NULL || cache == NULL)
+        return result;
+    if ((ttl = response_ttl(((getdns_ResultObject *)result)->response)) == 0)
+        return result;
+    if ((capsule = PyDict_GetItem(cache->entries, key)) != NULL)
+        cache_remove(cache, (cache_entry *)PyCapsule_GetPointer(capsule, NULL));
+    while (PyDict_Size(cache->entries) >= self->cache_size)  {
+        cache_remove(cache, cache->lru.prev);
+        cache->evictions++;
+    }
+    if ((entry = (cache_entry *)PyMem_Malloc(sizeof(cache_entry))) == NULL)
+        return result;
+    if ((capsule = PyCapsule_New(entry, NULL, 0)) == NULL)  {
+        PyMem_Free(entry);
+        PyErr_Clear();
+        return result;
+    }
+    if (PyDict_SetItem(cache->entries, key, capsule) < 0)  {
+        Py_DECREF(capsule);
+        PyMem_Free(entry);
+        PyErr_Clear();
+        return result;
+    }
+    Py_DECREF(capsule);
+    Py_INCREF(key);
+    entry->key = key;
+    entry->result = result;
+    entry->expires = cache_now() + (double)ttl;
+    cache_link(cache, entry);
+    return result_share(result);
+}
+
+
+PyObject *
+context_cache_info(getdns_ContextObject *self, PyObject *unused)
+{
+    pygetdns_cache *cache = self->cache;
+
+    if (cache == NULL)
+        return Py_BuildValue("{sksksksksnsn}", "hits", 0UL, "misses", 0UL,
+                             "evictions", 0UL, "expirations", 0UL,
+                             "entries", (Py_ssize_t)0, "cache_size", (Py_ssize_t)0);
+    return Py_BuildValue("{sksksksksnsn}", "hits", cache->hits, "misses", cache->misses,
+                         "evictions", cache->evictions, "expirations", cache->expirations,
+                         "entries", PyDict_Size(cache->entries), "cache_size", self->cache_size);
+}
+
+
+PyObject *
+context_cache_clear(getdns_ContextObject *self, PyObject *unused)
+{
+    context_cache_flush(self);
+    Py_RETURN_NONE;
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <Python.h>
+#include <getdns/getdns.h>
+#include "pygetdns.h"
+
+/*
+ * In-flight query coalescing.  While a query is outstanding its
+ * flight is registered in the context's inflight dict under the
+ * same key the response cache uses, and an identical query made
+ * in the meantime waits for that answer instead of going to
+ * getdns again.  Synchronous callers in other threads block on
+ * the flight's lock; *_async() callers add their future to its
+ * list of waiters (see context_asyncio.c).  Everyone gets their
+ * own Result, sharing the one response.
+ *
+ * A flight is a capsule, so that it can stay alive for as long
+ * as a waiter or a getdns callback still needs it.  The dict
+ * and the counters are only touched with the GIL held.
+ */
+
+static void
+flight_destroy(PyObject *capsule)
+{
+    query_flight *flight = FLIGHT(capsule);
+
+    Py_XDECREF(flight->key);
+    Py_XDECREF(flight->waiters);
+    Py_XDECREF(flight->result);
+    Py_XDECREF(flight->trace.hook);
+    Py_XDECREF(flight->trace.name);
+    if (flight->done)
+        PyThread_free_lock(flight->done);
+    PyMem_Free(flight);
+}
+
+
+/*
+ * borrowed reference to the flight for key, or NULL if nothing
+ * matching is outstanding
+ */
+
+PyObject *
+context_flight_find(getdns_ContextObject *self, PyObject *key)
+{
+    if (key == NULL || self->inflight == NULL)
+        return NULL;
+    return PyDict_GetItem(self->inflight, key);
+}
+
+
+/*
+ * start a new flight and register it under key, which may be
+ * NULL for a query that can't be shared.  A synchronous flight
+ * starts with its lock held.  Returns a new reference
+ */
+
+PyObject *
+context_flight_new(getdns_ContextObject *self, PyObject *key, int sync)
+{
+    query_flight *flight;
+    PyObject *capsule;
+
+    if (self->inflight == NULL && (self->inflight = PyDict_New()) == NULL)
+        return NULL;
+    if ((flight = (query_flight *)PyMem_Malloc(sizeof(query_flight))) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        return NULL;
+    }
+    memset(flight, 0, sizeof(query_flight));
+    if ((capsule = PyCapsule_New(flight, FLIGHT_CAPSULE, flight_destroy)) == NULL)  {
+        PyMem_Free(flight);
+        return NULL;
+    }
+    flight->owner = self;
+    if (sync)  {
+        if ((flight->done = PyThread_allocate_lock()) == NULL)  {
+            Py_DECREF(capsule);
+            PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+            return NULL;
+        }
+        PyThread_acquire_lock(flight->done, WAIT_LOCK);
+    }  else if ((flight->waiters = PyList_New(0)) == NULL)  {
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    if (key)  {
+        if (PyDict_SetItem(self->inflight, key, capsule) < 0)  {
+            Py_DECREF(capsule);
+            return NULL;
+        }
+        Py_INCREF(key);
+        flight->key = key;
+    }
+    flight->pending = 1;
+    self->queries_issued++;
+    return capsule;
+}
+
+
+/*
+ * the flight's query is finished, or has been given up on, so
+ * it stops taking new waiters
+ */
+
+void
+context_flight_land(getdns_ContextObject *self, PyObject *capsule)
+{
+    query_flight *flight = FLIGHT(capsule);
+
+    if (!flight->pending)
+        return;
+    flight->pending = 0;
+    if (flight->key && PyDict_GetItem(self->inflight, flight->key) == capsule)
+        (void)PyDict_DelItem(self->inflight, flight->key);
+}
+
+
+/*
+ * called before a synchronous query.  If the same query is
+ * already outstanding in another thread, waits for it without
+ * the GIL and returns 0 with *result set to a Result for its
+ * response (or NULL with an exception set).  Otherwise returns
+ * 1 with *flight set to a new flight, which the caller must
+ * hand to context_flight_sync_end() once the query is done.
+ *
+ * A thread that holds context_lock() (a callback inside run(),
+ * say) doesn't wait: the flight's owner may be waiting for that
+ * lock to issue its query.  It issues the query itself, with
+ * *flight set to NULL
+ */
+
+int
+context_flight_sync_begin(getdns_ContextObject *self, PyObject *key,
+                          PyObject **flight, PyObject **result)
+{
+    PyObject *capsule;
+    query_flight *f;
+
+    *result = NULL;
+    if ((capsule = context_flight_find(self, key)) == NULL)  {
+        if ((*flight = context_flight_new(self, key, 1)) == NULL)
+            return 0;
+        return 1;
+    }
+    if (PYGETDNS_LOAD(self->lock_owner) == (long)PyThread_get_thread_ident())  {
+        *flight = NULL;
+        return 1;
+    }
+    Py_INCREF(capsule);
+    self->queries_coalesced++;
+    f = FLIGHT(capsule);
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(f->done, WAIT_LOCK);
+    PyThread_release_lock(f->done);
+    Py_END_ALLOW_THREADS
+    if (f->result)
+        *result = result_share(f->result);
+    else if (f->ret != GETDNS_RETURN_GOOD)
+        PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(f->ret));
+    else
+        PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
+    Py_DECREF(capsule);
+    return 0;
+}
+
+
+/*
+ * publish the outcome of a synchronous query to any threads
+ * waiting on it, and drop the caller's reference to the flight
+ * (if it had one)
+ */
+
+void
+context_flight_sync_end(getdns_ContextObject *self, PyObject *flight,
+                        getdns_return_t ret, PyObject *result)
+{
+    query_flight *f;
+
+    if (flight == NULL)
+        return;
+    f = FLIGHT(flight);
+    context_flight_land(self, flight);
+    Py_XINCREF(result);
+    f->result = result;
+    f->ret = ret;
+    PyThread_release_lock(f->done);
+    Py_DECREF(flight);
+}
+
+
+PyObject *
+context_coalesce_info(getdns_ContextObject *self, PyObject *unused)
+{
+    return Py_BuildValue("{sksksn}", "issued", self->queries_issued,
+                         "coalesced", self->queries_coalesced,
+                         "in_flight", self->inflight ? PyDict_Size(self->inflight) : (Py_ssize_t)0);
+}
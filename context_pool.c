@@ -0,0 +1,577 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <Python.h>
+#include <time.h>
+#include <getdns/getdns.h>
+#include <getdns/getdns_extra.h>
+#include "pygetdns.h"
+
+/*
+ * ContextPool: a fixed set of identically configured Contexts,
+ * built once, for programs that would otherwise create and set up
+ * a Context per thread or per request.  A Context is leased with
+ * lease(), which returns a ContextLease usable in a with
+ * statement, or bound to the calling thread for as long as it
+ * lives with thread_context(); the binding is a lease kept in a
+ * threading.local, so it's given back when the thread's locals
+ * are torn down.
+ *
+ * The free list and the counters are only touched with the GIL
+ * held.  A caller that finds the pool empty waits on the pool's
+ * "available" lock with the GIL released.  Giving a Context back
+ * releases that lock if anyone is waiting, and a waiter that
+ * finds more than one free passes the wakeup on, since two
+ * releases can land before the first waiter gets the GIL back.
+ *
+ * A Context given back is made ready for the next lessee: its
+ * cache and its counters are cleared.  One whose settings were
+ * changed while it was out, or that still has queries
+ * outstanding or is tied to an event loop, is retired instead
+ * and a freshly configured one takes its place.  While in the
+ * pool, and for good once retired, a Context refuses to be used
+ * (see context_get()), so a reference kept past the end of a
+ * lease fails loudly rather than running queries on someone
+ * else's Context.
+ *
+ * For reporting, the pool keeps the number of leases, how many
+ * had to wait and for how long, and the integral of the number
+ * leased over time, from which stats() works out utilisation.
+ */
+
+static void
+pool_account(getdns_ContextPoolObject *self)
+{
+    uint64_t now = context_stats_now();
+
+    self->busy_ns += (double)self->leased * (double)(now - self->changed);
+    self->changed = now;
+}
+
+
+static void
+pool_wake(getdns_ContextPoolObject *self)
+{
+    if (self->waiters > 0 && self->signalled == 0)  {
+        self->signalled = 1;
+        PyThread_release_lock(self->available);
+    }
+}
+
+
+/*
+ * take a free Context, waiting up to timeout seconds (forever
+ * if it's negative, or too long for a deadline; see
+ * context_stats_deadline()).  Returns a new reference, or NULL
+ * with an exception set
+ */
+
+#define POOL_POLL_MAX 50000000  /* nanoseconds, see pool_take() */
+
+static PyObject *
+pool_take(getdns_ContextPoolObject *self, double timeout)
+{
+    PyObject *context;
+    uint64_t started = 0;
+    uint64_t deadline = 0;
+    uint64_t now;
+    uint64_t waited;
+    int got;
+#if PY_MAJOR_VERSION >= 3
+    PY_TIMEOUT_T remaining;
+#else
+    struct timespec delay;
+    uint64_t pause;
+#endif
+
+    while (self->n_free == 0)  {
+        if (started == 0)  {
+            started = context_stats_now();
+            if (timeout >= 0.0)
+                deadline = context_stats_deadline(timeout);
+        }
+        if (timeout == 0.0)
+            goto timed_out;
+        self->waiters++;
+#if PY_MAJOR_VERSION >= 3
+        if (deadline == 0)
+            remaining = -1;
+        else  {
+            now = context_stats_now();
+            remaining = deadline > now ? (PY_TIMEOUT_T)((deadline - now) / 1000) : 0;
+            if (remaining > PY_TIMEOUT_MAX)
+                remaining = PY_TIMEOUT_MAX;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        got = PyThread_acquire_lock_timed(self->available, remaining, 0) == PY_LOCK_ACQUIRED;
+        Py_END_ALLOW_THREADS
+#else
+        /*
+         * Python 2 locks have no timed acquire, so a wait with a
+         * deadline polls, backing off from 1ms to POOL_POLL_MAX as
+         * Python 2's own threading.Condition.wait() does
+         */
+        Py_BEGIN_ALLOW_THREADS
+        if (deadline == 0)
+            got = PyThread_acquire_lock(self->available, WAIT_LOCK);
+        else  {
+            pause = 1000000;
+            while (!(got = PyThread_acquire_lock(self->available, NOWAIT_LOCK)) &&
+                   (now = context_stats_now()) < deadline)  {
+                if (pause > deadline - now)
+                    pause = deadline - now;
+                delay.tv_sec = (time_t)(pause / 1000000000ULL);
+                delay.tv_nsec = (long)(pause % 1000000000ULL);
+                nanosleep(&delay, NULL);
+                if ((pause *= 2) > POOL_POLL_MAX)
+                    pause = POOL_POLL_MAX;
+            }
+        }
+        Py_END_ALLOW_THREADS
+#endif
+        self->waiters--;
+        if (got)
+            self->signalled = 0;
+        else if (self->n_free == 0)
+            goto timed_out;
+    }
+    context = self->free[--self->n_free];
+    ((getdns_ContextObject *)context)->pooled = 0;
+    pool_account(self);
+    self->leased++;
+    if (self->leased > self->peak_leased)
+        self->peak_leased = self->leased;
+    self->leases++;
+    if (started)  {
+        waited = (context_stats_now() - started) / 1000;
+        self->waits++;
+        self->wait_usec += waited;
+        if (waited > self->wait_max_usec)
+            self->wait_max_usec = waited;
+    }
+    if (self->n_free > 0)
+        pool_wake(self);
+    return context;
+
+timed_out:
+    self->timeouts++;
+    PyErr_SetString(getdns_error, "Timed out waiting for a Context from the pool");
+    return NULL;
+}
+
+
+static PyObject *pool_context_new(getdns_ContextPoolObject *self);
+
+
+/*
+ * whether a Context given back can go to the next lessee once
+ * its cache and counters are cleared, or has to be replaced
+ */
+
+static int
+pool_reusable(getdns_ContextObject *ctx)
+{
+    getdns_context *context;
+    uint32_t pending;
+
+    if (ctx->settings_changes || ctx->asyncio_loop || ctx->selector || ctx->batching ||
+        (ctx->batch && PyList_GET_SIZE(ctx->batch) > 0) ||
+        (ctx->inflight && PyDict_Size(ctx->inflight) > 0))
+        return 0;
+    if ((context = PyCapsule_GetPointer(ctx->py_context, "context")) == NULL)  {
+        PyErr_Clear();
+        return 0;
+    }
+    context_lock(ctx);
+    pending = getdns_context_get_num_pending_requests(context, NULL);
+    context_unlock(ctx);
+    return pending == 0;
+}
+
+
+/*
+ * leases give their Contexts back too, so this takes the pool's
+ * critical section itself.  Making a replacement can run Python
+ * code, so that's done first, outside it; if it fails, the old
+ * Context is cleared and kept, and the error reported as
+ * unraisable, since this is also called from deallocators
+ */
+
+static void
+pool_give(getdns_ContextPoolObject *self, PyObject *context)
+{
+    getdns_ContextObject *ctx = (getdns_ContextObject *)context;
+    PyObject *fresh = 0;
+    PyObject *type, *value, *traceback;
+    Py_ssize_t i;
+
+    PyErr_Fetch(&type, &value, &traceback);
+    if (!pool_reusable(ctx) && (fresh = pool_context_new(self)) == NULL)
+        PyErr_WriteUnraisable(context);
+    PyErr_Restore(type, value, traceback);
+    if (fresh == NULL)  {
+        context_cache_reset(ctx);
+        context_stats_clear(ctx->stats);
+        ctx->queries_issued = ctx->queries_coalesced = 0;
+    }
+    PYGETDNS_BEGIN_LOCKED(self);
+    if (fresh)  {
+        for (i = 0 ; i < self->n_contexts && self->contexts[i] != context ; i++)
+            ;
+        self->contexts[i] = fresh;
+        ((getdns_ContextObject *)fresh)->pooled = 1;
+        ctx->pooled = 1;
+        context = fresh;
+    }
+    else
+        ctx->pooled = 1;
+    pool_account(self);
+    self->leased--;
+    self->free[self->n_free++] = context;
+    pool_wake(self);
+    PYGETDNS_END_LOCKED();
+    if (fresh)
+        Py_DECREF(ctx);         /* the pool's reference */
+}
+
+
+/*
+ * a new Context with each of settings (a dict, or NULL) set as
+ * an attribute.  Also used for the Resolver's worker contexts
+ */
+
+PyObject *
+context_new_configured(PyObject *settings)
+{
+    PyObject *context;
+    PyObject *key;
+    PyObject *value;
+    Py_ssize_t pos;
+
+    if ((context = PyObject_CallObject((PyObject *)&getdns_ContextType, NULL)) == NULL)
+        return NULL;
+    for (pos = 0 ; settings && PyDict_Next(settings, &pos, &key, &value) ; )  {
+        /* Context quietly ignores attributes it doesn't have */
+        if (!PyObject_HasAttr(context, key))  {
+#if PY_MAJOR_VERSION >= 3
+            PyErr_Format(PyExc_AttributeError, "Context has no setting %R", key);
+#else
+            PyErr_Format(PyExc_AttributeError, "Context has no setting '%s'",
+                         PyString_Check(key) ? PyString_AsString(key) : "?");
+#endif
+            Py_DECREF(context);
+            return NULL;
+        }
+        if (PyObject_SetAttr(context, key, value) < 0)  {
+            Py_DECREF(context);
+            return NULL;
+        }
+    }
+    return context;
+}
+
+
+/*
+ * a Context configured as the pool's others, as yet unchanged
+ */
+
+static PyObject *
+pool_context_new(getdns_ContextPoolObject *self)
+{
+    PyObject *context;
+
+    if ((context = context_new_configured(self->settings)) == NULL)
+        return NULL;
+    ((getdns_ContextObject *)context)->settings_changes = 0;
+    return context;
+}
+
+
+PyObject *
+context_pool_new(PyTypeObject *type, PyObject *args, PyObject *keywds)
+{
+    getdns_ContextPoolObject *self;
+    PyObject *threading;
+    PyObject *context;
+    Py_ssize_t size;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTuple(args, "n:ContextPool", &size))
+        return NULL;
+    if (size < 1)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if ((self = (getdns_ContextPoolObject *)type->tp_alloc(type, 0)) == NULL)
+        return NULL;
+    self->size = size;
+    self->created = self->changed = context_stats_now();
+    if ((self->contexts = PyMem_Malloc(size * sizeof(PyObject *))) == NULL ||
+        (self->free = PyMem_Malloc(size * sizeof(PyObject *))) == NULL ||
+        (self->available = PyThread_allocate_lock()) == NULL)  {
+        Py_DECREF(self);
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        return NULL;
+    }
+    PyThread_acquire_lock(self->available, WAIT_LOCK);
+    if (keywds && (self->settings = PyDict_Copy(keywds)) == NULL)  {
+        Py_DECREF(self);
+        return NULL;
+    }
+    for (i = 0 ; i < size ; i++)  {
+        if ((context = pool_context_new(self)) == NULL)  {
+            Py_DECREF(self);
+            return NULL;
+        }
+        ((getdns_ContextObject *)context)->pooled = 1;
+        self->contexts[self->n_contexts++] = context;
+        self->free[self->n_free++] = context;
+    }
+    if ((threading = PyImport_ImportModule("threading")) == NULL)  {
+        Py_DECREF(self);
+        return NULL;
+    }
+    self->local = PyObject_CallMethod(threading, "local", NULL);
+    Py_DECREF(threading);
+    if (self->local == NULL)  {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *)self;
+}
+
+
+void
+context_pool_dealloc(getdns_ContextPoolObject *self)
+{
+    Py_ssize_t i;
+
+    Py_XDECREF(self->local);
+    Py_XDECREF(self->settings);
+    for (i = 0 ; i < self->n_contexts ; i++)
+        Py_DECREF(self->contexts[i]);
+    PyMem_Free(self->contexts);
+    PyMem_Free(self->free);
+    if (self->available)  {
+        if (!self->signalled)
+            PyThread_release_lock(self->available);
+        PyThread_free_lock(self->available);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static PyObject *
+pool_lease(getdns_ContextPoolObject *self, double timeout)
+{
+    getdns_ContextLeaseObject *lease;
+    PyObject *context;
+
+    if ((context = pool_take(self, timeout)) == NULL)
+        return NULL;
+    if ((lease = PyObject_New(getdns_ContextLeaseObject, &getdns_ContextLeaseType)) == NULL)  {
+        pool_give(self, context);
+        return NULL;
+    }
+    Py_INCREF(self);
+    lease->pool = self;
+    lease->context = context;
+    return (PyObject *)lease;
+}
+
+
+PyObject *
+context_pool_lease(getdns_ContextPoolObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "timeout",
+        0
+    };
+    PyObject *timeout_obj = 0;
+    double timeout = -1.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O", kwlist, &timeout_obj))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if (timeout_obj && timeout_obj != Py_None)  {
+        if ((timeout = PyFloat_AsDouble(timeout_obj)) == -1.0 && PyErr_Occurred())
+            return NULL;
+        if (timeout != timeout)  {
+            PyErr_SetString(getdns_error, "timeout must not be NaN");
+            return NULL;
+        }
+        if (timeout < 0.0)  {
+            PyErr_SetString(getdns_error, "timeout must not be negative");
+            return NULL;
+        }
+    }
+    return pool_lease(self, timeout);
+}
+
+
+/*
+ * the Context bound to the calling thread, leasing one (and
+ * waiting for it, if need be) on the thread's first call
+ */
+
+PyObject *
+context_pool_thread_context(getdns_ContextPoolObject *self, PyObject *unused)
+{
+    PyObject *lease;
+    PyObject *context;
+
+    if ((lease = PyObject_GetAttrString(self->local, "lease")) == NULL)  {
+        if (!PyErr_ExceptionMatches(PyExc_AttributeError))
+            return NULL;
+        PyErr_Clear();
+        if ((lease = pool_lease(self, -1.0)) == NULL)
+            return NULL;
+        if (PyObject_SetAttrString(self->local, "lease", lease) < 0)  {
+            Py_DECREF(lease);
+            return NULL;
+        }
+    }
+    context = ((getdns_ContextLeaseObject *)lease)->context;
+    Py_XINCREF(context);
+    Py_DECREF(lease);
+    if (context == NULL)
+        PyErr_SetString(getdns_error, "The thread's Context has been released");
+    return context;
+}
+
+
+/*
+ * ContextPool.stats(reset=False).  utilisation is the mean
+ * fraction of the pool leased out since it was made (or reset)
+ */
+
+PyObject *
+context_pool_stats(getdns_ContextPoolObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "reset",
+        0
+    };
+    PyObject *reset_obj = 0;
+    PyObject *report;
+    uint64_t elapsed;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O", kwlist, &reset_obj))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    pool_account(self);
+    elapsed = self->changed - self->created;
+    report = Py_BuildValue("{s:n,s:n,s:n,s:n,s:K,s:K,s:K,s:K,s:K,s:d,s:d}",
+                           "size", self->size,
+                           "available", self->n_free,
+                           "leased", self->leased,
+                           "peak_leased", self->peak_leased,
+                           "leases", (unsigned long long)self->leases,
+                           "waits", (unsigned long long)self->waits,
+                           "timeouts", (unsigned long long)self->timeouts,
+                           "wait_total_usec", (unsigned long long)self->wait_usec,
+                           "wait_max_usec", (unsigned long long)self->wait_max_usec,
+                           "wait_mean_usec",
+                           self->waits ? (double)self->wait_usec / (double)self->waits : 0.0,
+                           "utilisation",
+                           elapsed ? self->busy_ns / ((double)elapsed * (double)self->size) : 0.0);
+    if (report && reset_obj && PyObject_IsTrue(reset_obj))  {
+        self->leases = self->waits = self->timeouts = 0;
+        self->wait_usec = self->wait_max_usec = 0;
+        self->peak_leased = self->leased;
+        self->busy_ns = 0.0;
+        self->created = self->changed;
+    }
+    return report;
+}
+
+
+Py_ssize_t
+context_pool_length(getdns_ContextPoolObject *self)
+{
+    return self->size;
+}
+
+
+/*
+ * ContextLease: one Context out of a pool, given back by
+ * release(), at the end of a with statement, or when the lease
+ * goes away
+ */
+
+PyObject *
+context_lease_release(getdns_ContextLeaseObject *self, PyObject *unused)
+{
+    if (self->context)  {
+        pool_give(self->pool, self->context);
+        self->context = 0;
+    }
+    Py_RETURN_NONE;
+}
+
+
+PyObject *
+context_lease_enter(getdns_ContextLeaseObject *self, PyObject *unused)
+{
+    if (self->context == NULL)  {
+        PyErr_SetString(getdns_error, "The Context has been released");
+        return NULL;
+    }
+    Py_INCREF(self->context);
+    return self->context;
+}
+
+
+PyObject *
+context_lease_exit(getdns_ContextLeaseObject *self, PyObject *args)
+{
+    return context_lease_release(self, NULL);
+}
+
+
+PyObject *
+context_lease_get_context(getdns_ContextLeaseObject *self, void *closure)
+{
+    PyObject *context = self->context ? self->context : Py_None;
+
+    Py_INCREF(context);
+    return context;
+}
+
+
+void
+context_lease_dealloc(getdns_ContextLeaseObject *self)
+{
+    if (self->context)
+        pool_give(self->pool, self->context);
+    Py_DECREF(self->pool);
+    PyObject_Del(self);
+}
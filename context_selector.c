@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <Python.h>
+#include <getdns/getdns.h>
+#include <getdns/getdns_extra.h>
+#include "pygetdns.h"
+
+/*
+ * A getdns_eventloop for programs that run their own select(),
+ * poll() or epoll loop and can't hand control to Context.run().
+ * getdns's sockets are registered with an epoll instance of our
+ * own, whose descriptor Context.fileno() hands out: it polls
+ * readable whenever one of them is ready.  Timers are kept in a
+ * binary heap, and Context.next_timeout() says how long the
+ * caller may wait before one is due.  Context.process_events()
+ * (or run_once() and run(), which wait on the same descriptor)
+ * then runs the ready callbacks and the expired timers, with no
+ * extra thread and without blocking.
+ *
+ * getdns clears events from inside callbacks, possibly ones that
+ * are further down the batch epoll_wait() returned, so events
+ * cleared during a step are only freed once it's over.
+ * Everything here runs with the GIL held, and with the Context
+ * locked while callbacks run.  It needs epoll, so it's Linux only
+ * for now.
+ */
+
+#if defined(__linux__)
+
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define SELECTOR_BATCH 64           /* events taken from epoll_wait() at a time */
+#define NO_SLOT ((size_t)-1)
+
+typedef struct selector_event  {
+    getdns_eventloop_event *event;  /* NULL once cleared */
+    int fd;                         /* registered with epoll, or -1 */
+    uint64_t expires;               /* see context_stats_now() */
+    size_t slot;                    /* position in the timer heap, or NO_SLOT */
+    struct selector_event *next_dead;
+} selector_event;
+
+struct pygetdns_selector_loop  {
+    getdns_eventloop base;          /* must be first */
+    getdns_ContextObject *owner;    /* not a reference */
+    int epfd;
+    size_t n_fds;
+    selector_event **timers;        /* min-heap on expires */
+    size_t n_timers;
+    size_t timers_size;
+    selector_event *dead;           /* cleared during a step */
+    int stepping;
+};
+
+
+static void
+timer_swap(pygetdns_selector_loop *sl, size_t a, size_t b)
+{
+    selector_event *tmp = sl->timers[a];
+
+    sl->timers[a] = sl->timers[b];
+    sl->timers[b] = tmp;
+    sl->timers[a]->slot = a;
+    sl->timers[b]->slot = b;
+}
+
+
+static void
+timer_sift(pygetdns_selector_loop *sl, size_t i)
+{
+    size_t child;
+
+    while (i > 0 && sl->timers[i]->expires < sl->timers[(i - 1) / 2]->expires)  {
+        timer_swap(sl, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;)  {
+        child = 2 * i + 1;
+        if (child >= sl->n_timers)
+            break;
+        if (child + 1 < sl->n_timers && sl->timers[child + 1]->expires < sl->timers[child]->expires)
+            child++;
+        if (sl->timers[i]->expires <= sl->timers[child]->expires)
+            break;
+        timer_swap(sl, i, child);
+        i = child;
+    }
+}
+
+
+static int
+timer_add(pygetdns_selector_loop *sl, selector_event *se)
+{
+    selector_event **timers;
+    size_t size;
+
+    if (sl->n_timers == sl->timers_size)  {
+        size = sl->timers_size ? 2 * sl->timers_size : 16;
+        if ((timers = PyMem_Realloc(sl->timers, size * sizeof(selector_event *))) == NULL)
+            return -1;
+        sl->timers = timers;
+        sl->timers_size = size;
+    }
+    se->slot = sl->n_timers++;
+    sl->timers[se->slot] = se;
+    timer_sift(sl, se->slot);
+    return 0;
+}
+
+
+static void
+timer_remove(pygetdns_selector_loop *sl, selector_event *se)
+{
+    size_t i = se->slot;
+
+    if (i == NO_SLOT)
+        return;
+    se->slot = NO_SLOT;
+    if (i != --sl->n_timers)  {
+        sl->timers[i] = sl->timers[sl->n_timers];
+        sl->timers[i]->slot = i;
+        timer_sift(sl, i);
+    }
+}
+
+
+static getdns_return_t
+selector_loop_clear(getdns_eventloop *loop, getdns_eventloop_event *event)
+{
+    pygetdns_selector_loop *sl = (pygetdns_selector_loop *)loop;
+    selector_event *se = (selector_event *)event->ev;
+
+    if (!se)
+        return GETDNS_RETURN_GOOD;
+    if (se->fd >= 0)  {
+        (void)epoll_ctl(sl->epfd, EPOLL_CTL_DEL, se->fd, NULL);
+        sl->n_fds--;
+    }
+    timer_remove(sl, se);
+    se->event = NULL;
+    event->ev = NULL;
+    if (sl->stepping)  {
+        se->next_dead = sl->dead;
+        sl->dead = se;
+    }  else
+        PyMem_Free(se);
+    return GETDNS_RETURN_GOOD;
+}
+
+
+static getdns_return_t
+selector_loop_schedule(getdns_eventloop *loop, int fd, uint64_t timeout,
+                       getdns_eventloop_event *event)
+{
+    pygetdns_selector_loop *sl = (pygetdns_selector_loop *)loop;
+    selector_event *se;
+    struct epoll_event ev;
+
+    if ((se = PyMem_Malloc(sizeof(selector_event))) == NULL)
+        return GETDNS_RETURN_MEMORY_ERROR;
+    se->event = event;
+    se->fd = -1;
+    se->slot = NO_SLOT;
+    se->next_dead = 0;
+    if (fd >= 0 && (event->read_cb || event->write_cb))  {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = (event->read_cb ? EPOLLIN : 0) | (event->write_cb ? EPOLLOUT : 0);
+        ev.data.ptr = se;
+        if (epoll_ctl(sl->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)  {
+            PyMem_Free(se);
+            return GETDNS_RETURN_GENERIC_ERROR;
+        }
+        se->fd = fd;
+        sl->n_fds++;
+    }
+    if (event->timeout_cb && timeout != TIMEOUT_FOREVER)  {
+        se->expires = context_stats_now() + timeout * 1000000ULL;
+        if (timer_add(sl, se) < 0)  {
+            if (se->fd >= 0)  {
+                (void)epoll_ctl(sl->epfd, EPOLL_CTL_DEL, se->fd, NULL);
+                sl->n_fds--;
+            }
+            PyMem_Free(se);
+            return GETDNS_RETURN_MEMORY_ERROR;
+        }
+    }
+    event->ev = se;
+    return GETDNS_RETURN_GOOD;
+}
+
+
+static void
+selector_loop_cleanup(getdns_eventloop *loop)
+{
+    pygetdns_selector_loop *sl = (pygetdns_selector_loop *)loop;
+    selector_event *se;
+
+    if (sl->owner->selector == sl)
+        sl->owner->selector = 0;
+    while ((se = sl->dead) != NULL)  {
+        sl->dead = se->next_dead;
+        PyMem_Free(se);
+    }
+    PyMem_Free(sl->timers);
+    close(sl->epfd);
+    PyMem_Free(sl);
+}
+
+
+/*
+ * the program's own loop does the waiting, through
+ * Context.process_events()
+ */
+
+static void
+selector_loop_run(getdns_eventloop *loop)
+{
+    UNUSED_PARAM(loop);
+}
+
+
+static void
+selector_loop_run_once(getdns_eventloop *loop, int blocking)
+{
+    UNUSED_PARAM(loop);
+    UNUSED_PARAM(blocking);
+}
+
+
+static getdns_eventloop_vmt selector_loop_vmt = {
+    sizeof(pygetdns_selector_loop),
+    selector_loop_cleanup,
+    selector_loop_schedule,
+    selector_loop_clear,
+    selector_loop_run,
+    selector_loop_run_once
+};
+
+
+/*
+ * switch the context over to our selector loop, unless it's
+ * already there.  Like the other event loops, this has to happen
+ * before any query that would need one is made
+ */
+
+int
+context_attach_selector(getdns_ContextObject *self, getdns_context *context)
+{
+    pygetdns_selector_loop *sl;
+    getdns_return_t ret;
+
+    if (self->selector)
+        return 0;
+    if (self->event_base)  {
+        PyErr_SetString(getdns_error, "Context is bound to a libevent event base");
+        return -1;
+    }
+    if (self->asyncio_loop)  {
+        PyErr_SetString(getdns_error, "Context is bound to an asyncio event loop");
+        return -1;
+    }
+    if ((sl = PyMem_Malloc(sizeof(pygetdns_selector_loop))) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        return -1;
+    }
+    memset(sl, 0, sizeof(pygetdns_selector_loop));
+    sl->base.vmt = &selector_loop_vmt;
+    sl->owner = self;
+    if ((sl->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)  {
+        PyMem_Free(sl);
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    context_lock(self);
+    ret = getdns_context_set_eventloop(context, &sl->base);
+    context_unlock(self);
+    if (ret != GETDNS_RETURN_GOOD)  {
+        close(sl->epfd);
+        PyMem_Free(sl);
+        PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
+        return -1;
+    }
+    self->selector = sl;
+    return 0;
+}
+
+
+/*
+ * wait up to wait_ns (forever if it's negative) for a socket or
+ * a timer, then run everything that's ready.  Returns 1 if there
+ * was nothing to wait for, and -1 with an exception set if
+ * epoll_wait() fails.  The GIL is released while we wait
+ */
+
+int
+context_selector_step(getdns_ContextObject *self, int64_t wait_ns)
+{
+    pygetdns_selector_loop *sl = self->selector;
+    struct epoll_event ready[SELECTOR_BATCH];
+    getdns_eventloop_event *event;
+    selector_event *se;
+    uint64_t now;
+    int timeout_ms;
+    int n, i;
+
+    if (sl->n_fds == 0 && sl->n_timers == 0 && wait_ns < 0)
+        return 1;
+    if (sl->n_timers)  {
+        now = context_stats_now();
+        if (sl->timers[0]->expires <= now)
+            wait_ns = 0;
+        else if (wait_ns < 0 || (uint64_t)wait_ns > sl->timers[0]->expires - now)
+            wait_ns = (int64_t)(sl->timers[0]->expires - now);
+    }
+    if (wait_ns < 0)
+        timeout_ms = -1;
+    else if (wait_ns > (int64_t)INT_MAX * 1000000)
+        timeout_ms = INT_MAX;
+    else                /* rounded up, so that the timer has expired */
+        timeout_ms = (int)((wait_ns + 999999) / 1000000);
+    Py_BEGIN_ALLOW_THREADS
+    n = epoll_wait(sl->epfd, ready, SELECTOR_BATCH, timeout_ms);
+    Py_END_ALLOW_THREADS
+    if (n < 0)  {
+        if (errno != EINTR)  {
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        n = 0;
+    }
+    sl->stepping = 1;
+    for (i = 0 ; i < n ; i++)  {
+        se = (selector_event *)ready[i].data.ptr;
+        if ((event = se->event) != NULL && event->read_cb &&
+            (ready[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+            event->read_cb(event->userarg);
+        if ((event = se->event) != NULL && event->write_cb &&
+            (ready[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+            event->write_cb(event->userarg);
+    }
+    now = context_stats_now();
+    while (sl->n_timers && sl->timers[0]->expires <= now)  {
+        se = sl->timers[0];
+        timer_remove(sl, se);
+        if ((event = se->event) != NULL && event->timeout_cb)
+            event->timeout_cb(event->userarg);
+    }
+    sl->stepping = 0;
+    while ((se = sl->dead) != NULL)  {
+        sl->dead = se->next_dead;
+        PyMem_Free(se);
+    }
+    return 0;
+}
+
+
+PyObject *
+context_fileno(getdns_ContextObject *self, PyObject *unused)
+{
+    getdns_context *context;
+
+    if ((context = context_get(self)) == NULL)
+        return NULL;
+    if (context_attach_selector(self, context) < 0)
+        return NULL;
+#if PY_MAJOR_VERSION >= 3
+    return PyLong_FromLong((long)self->selector->epfd);
+#else
+    return PyInt_FromLong((long)self->selector->epfd);
+#endif
+}
+
+
+PyObject *
+context_next_timeout(getdns_ContextObject *self, PyObject *unused)
+{
+    pygetdns_selector_loop *sl = self->selector;
+    uint64_t now;
+
+    if (!sl || sl->n_timers == 0)
+        Py_RETURN_NONE;
+    now = context_stats_now();
+    if (sl->timers[0]->expires <= now)
+        return PyFloat_FromDouble(0.0);
+    return PyFloat_FromDouble((double)(sl->timers[0]->expires - now) / 1e9);
+}
+
+#else /* no epoll */
+
+int
+context_attach_selector(getdns_ContextObject *self, getdns_context *context)
+{
+    PyErr_SetString(getdns_error, "Context.fileno() is not supported on this platform");
+    return -1;
+}
+
+
+int
+context_selector_step(getdns_ContextObject *self, int64_t wait_ns)
+{
+    return 1;
+}
+
+
+PyObject *
+context_fileno(getdns_ContextObject *self, PyObject *unused)
+{
+    (void)context_attach_selector(self, NULL);
+    return NULL;
+}
+
+
+PyObject *
+context_next_timeout(getdns_ContextObject *self, PyObject *unused)
+{
+    Py_RETURN_NONE;
+}
+
+#endif
@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <Python.h>
+#include <time.h>
+#include <getdns/getdns.h>
+#include "pygetdns.h"
+
+/*
+ * Per-context query statistics, returned by Context.stats().
+ * Counters and latency histograms are plain integers updated
+ * with the GIL held, and a query costs two clock reads and a
+ * few additions, so they're always on.  The exceptions are
+ * submitted and outstanding, which bulk() keeps up to date
+ * without the GIL (see context_stats_returned()); those two are
+ * only ever touched with atomic operations.
+ *
+ * Latencies are kept in microseconds in a log-linear ("HDR")
+ * histogram per rrtype: values below STATS_SUB_COUNT get a
+ * bucket each, and every power of two above that is split into
+ * STATS_SUB_COUNT / 2 equal buckets, so any recorded value is
+ * within 1 / (STATS_SUB_COUNT / 2) of its bucket's bounds.
+ * address() lookups, which ask for both A and AAAA, are
+ * recorded under rrtype 0.  The same kind of histogram counts
+ * how many callbacks each turn of the event loop delivered, for
+ * contexts with batch_callbacks set.
+ */
+
+#define STATS_SUB_BITS 5
+#define STATS_SUB_COUNT (1 << STATS_SUB_BITS)
+#define STATS_HALF_COUNT (STATS_SUB_COUNT / 2)
+#define STATS_MAX_BITS 36           /* latencies are capped at 2^36 usec */
+#define STATS_N_BUCKETS (STATS_SUB_COUNT + (STATS_MAX_BITS - STATS_SUB_BITS) * STATS_HALF_COUNT)
+
+typedef struct  {
+    uint16_t request_type;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[STATS_N_BUCKETS];
+} stats_histogram;
+
+struct pygetdns_stats  {
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t timed_out;
+    uint64_t cancelled;
+    uint64_t errored;
+    uint64_t outstanding;
+    stats_histogram **histograms;
+    size_t n_histograms;
+    stats_histogram *last;          /* most recently used, checked first */
+    stats_histogram batches;        /* sizes of batched callback deliveries */
+};
+
+
+/*
+ * nanoseconds on the monotonic clock, the same one
+ * time.monotonic() uses
+ */
+
+uint64_t
+context_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/*
+ * the clock reading `seconds' from now, for a wait that gives
+ * up then.  0 means no deadline, for waits too long to be worth
+ * one (including infinite ones).  Callers reject negative and
+ * NaN timeouts first
+ */
+
+#define STATS_MAX_WAIT 1e9      /* seconds, about 30 years */
+
+uint64_t
+context_stats_deadline(double seconds)
+{
+    if (!(seconds < STATS_MAX_WAIT))
+        return 0;
+    return context_stats_now() + (uint64_t)(seconds * 1e9) + 1;
+}
+
+
+pygetdns_stats *
+context_stats_new(void)
+{
+    pygetdns_stats *stats;
+
+    if ((stats = (pygetdns_stats *)PyMem_Malloc(sizeof(pygetdns_stats))) == NULL)
+        return NULL;
+    memset(stats, 0, sizeof(pygetdns_stats));
+    stats->batches.min = UINT64_MAX;
+    return stats;
+}
+
+
+/*
+ * zero everything but the number outstanding, which the queries
+ * still to come back will count down
+ */
+
+void
+context_stats_clear(pygetdns_stats *stats)
+{
+    uint16_t request_type;
+    size_t i;
+
+    __atomic_store_n(&stats->submitted, 0, __ATOMIC_RELAXED);
+    stats->completed = stats->timed_out = 0;
+    stats->cancelled = stats->errored = 0;
+    for (i = 0 ; i < stats->n_histograms ; i++)  {
+        request_type = stats->histograms[i]->request_type;
+        memset(stats->histograms[i], 0, sizeof(stats_histogram));
+        stats->histograms[i]->request_type = request_type;
+        stats->histograms[i]->min = UINT64_MAX;
+    }
+    memset(&stats->batches, 0, sizeof(stats_histogram));
+    stats->batches.min = UINT64_MAX;
+}
+
+
+void
+context_stats_free(pygetdns_stats *stats)
+{
+    size_t i;
+
+    if (stats == NULL)
+        return;
+    for (i = 0 ; i < stats->n_histograms ; i++)
+        PyMem_Free(stats->histograms[i]);
+    PyMem_Free(stats->histograms);
+    PyMem_Free(stats);
+}
+
+
+static int
+stats_bucket(uint64_t value)
+{
+    int msb = 0;
+    int shift;
+
+    if (value < STATS_SUB_COUNT)
+        return (int)value;
+    if (value >= ((uint64_t)1 << STATS_MAX_BITS))
+        return STATS_N_BUCKETS - 1;
+    while ((value >> msb) > 1)
+        msb++;
+    shift = msb - (STATS_SUB_BITS - 1);
+    return STATS_SUB_COUNT + (shift - 1) * STATS_HALF_COUNT +
+        (int)(value >> shift) - STATS_HALF_COUNT;
+}
+
+
+/*
+ * the lowest and highest values that land in bucket i
+ */
+
+static void
+stats_bucket_bounds(int i, uint64_t *low, uint64_t *high)
+{
+    int shift;
+    uint64_t mantissa;
+
+    if (i < STATS_SUB_COUNT)  {
+        *low = *high = (uint64_t)i;
+        return;
+    }
+    shift = (i - STATS_SUB_COUNT) / STATS_HALF_COUNT + 1;
+    mantissa = (uint64_t)((i - STATS_SUB_COUNT) % STATS_HALF_COUNT + STATS_HALF_COUNT);
+    *low = mantissa << shift;
+    *high = ((mantissa + 1) << shift) - 1;
+}
+
+
+static stats_histogram *
+stats_histogram_for(pygetdns_stats *stats, uint16_t request_type)
+{
+    stats_histogram **histograms;
+    stats_histogram *histogram;
+    size_t i;
+
+    if (stats->last && stats->last->request_type == request_type)
+        return stats->last;
+    for (i = 0 ; i < stats->n_histograms ; i++)  {
+        if (stats->histograms[i]->request_type == request_type)
+            return stats->last = stats->histograms[i];
+    }
+    if ((histogram = (stats_histogram *)PyMem_Malloc(sizeof(stats_histogram))) == NULL)
+        return NULL;
+    if ((histograms = (stats_histogram **)PyMem_Realloc(stats->histograms,
+                                                        (stats->n_histograms + 1) *
+                                                        sizeof(stats_histogram *))) == NULL)  {
+        PyMem_Free(histogram);
+        return NULL;
+    }
+    memset(histogram, 0, sizeof(stats_histogram));
+    histogram->request_type = request_type;
+    histogram->min = UINT64_MAX;
+    histograms[stats->n_histograms++] = histogram;
+    stats->histograms = histograms;
+    return stats->last = histogram;
+}
+
+
+/*
+ * a query has been handed to getdns.  Returns the time, for
+ * passing to context_stats_done() once it's finished
+ */
+
+uint64_t
+context_stats_submit(pygetdns_stats *stats)
+{
+    __atomic_add_fetch(&stats->submitted, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->outstanding, 1, __ATOMIC_RELAXED);
+    return context_stats_now();
+}
+
+
+/*
+ * a query has come back.  Like context_stats_submit() this
+ * doesn't need the GIL, so bulk() calls it from its callback and
+ * records the rest with context_stats_record() afterwards
+ */
+
+void
+context_stats_returned(pygetdns_stats *stats)
+{
+    uint64_t n = __atomic_load_n(&stats->outstanding, __ATOMIC_RELAXED);
+
+    while (n > 0 && !__atomic_compare_exchange_n(&stats->outstanding, &n, n - 1, 0,
+                                                 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+
+/*
+ * a query has finished, one way or another.  type is how getdns
+ * reported it; response (which may be NULL) is only looked at
+ * to spot timeouts reported as complete, as they are for
+ * synchronous queries
+ */
+
+void
+context_stats_done(pygetdns_stats *stats, uint16_t request_type, uint64_t started,
+                   uint64_t finished, getdns_callback_type_t type, getdns_dict *response)
+{
+    context_stats_returned(stats);
+    context_stats_record(stats, request_type, started, finished, type, response);
+}
+
+
+void
+context_stats_record(pygetdns_stats *stats, uint16_t request_type, uint64_t started,
+                     uint64_t finished, getdns_callback_type_t type, getdns_dict *response)
+{
+    stats_histogram *histogram;
+    uint32_t status;
+    uint64_t latency;
+
+    if (type == GETDNS_CALLBACK_COMPLETE && response &&
+        getdns_dict_get_int(response, "status", &status) == GETDNS_RETURN_GOOD &&
+        status == GETDNS_RESPSTATUS_ALL_TIMEOUT)
+        type = GETDNS_CALLBACK_TIMEOUT;
+    switch (type)  {
+    case GETDNS_CALLBACK_COMPLETE:
+        stats->completed++;
+        break;
+    case GETDNS_CALLBACK_TIMEOUT:
+        stats->timed_out++;
+        break;
+    case GETDNS_CALLBACK_CANCEL:
+        stats->cancelled++;
+        return;
+    default:
+        stats->errored++;
+        return;
+    }
+    if ((histogram = stats_histogram_for(stats, request_type)) == NULL)
+        return;
+    latency = finished > started ? (finished - started) / 1000 : 0;
+    histogram->count++;
+    histogram->sum += latency;
+    if (latency < histogram->min)
+        histogram->min = latency;
+    if (latency > histogram->max)
+        histogram->max = latency;
+    histogram->buckets[stats_bucket(latency)]++;
+}
+
+
+/*
+ * a turn of the event loop has delivered n batched callbacks
+ * (see context_batch_flush())
+ */
+
+void
+context_stats_batch(pygetdns_stats *stats, uint64_t n)
+{
+    stats_histogram *histogram = &stats->batches;
+
+    histogram->count++;
+    histogram->sum += n;
+    if (n < histogram->min)
+        histogram->min = n;
+    if (n > histogram->max)
+        histogram->max = n;
+    histogram->buckets[stats_bucket(n)]++;
+}
+
+
+/*
+ * the value at percentile p (0 to 100), reported as the top of
+ * its bucket but never more than the largest value recorded
+ */
+
+static uint64_t
+stats_percentile(stats_histogram *histogram, double p)
+{
+    uint64_t wanted;
+    uint64_t seen = 0;
+    uint64_t low;
+    uint64_t high;
+    int i;
+
+    wanted = (uint64_t)(p / 100.0 * (double)histogram->count + 0.5);
+    if (wanted < 1)
+        wanted = 1;
+    for (i = 0 ; i < STATS_N_BUCKETS ; i++)  {
+        seen += histogram->buckets[i];
+        if (seen >= wanted)  {
+            stats_bucket_bounds(i, &low, &high);
+            return high < histogram->max ? high : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+
+/*
+ * a histogram as a dict.  Latencies have _usec on their keys;
+ * batch sizes are plain counts
+ */
+
+static PyObject *
+stats_histogram_dict(stats_histogram *histogram, int latency)
+{
+    PyObject *buckets;
+    PyObject *bucket;
+    uint64_t low;
+    uint64_t high;
+    int i;
+
+    if ((buckets = PyList_New(0)) == NULL)
+        return NULL;
+    for (i = 0 ; i < STATS_N_BUCKETS ; i++)  {
+        if (histogram->buckets[i] == 0)
+            continue;
+        stats_bucket_bounds(i, &low, &high);
+        if ((bucket = Py_BuildValue("(KKK)", (unsigned long long)low, (unsigned long long)high,
+                                    (unsigned long long)histogram->buckets[i])) == NULL ||
+            PyList_Append(buckets, bucket) < 0)  {
+            Py_XDECREF(bucket);
+            Py_DECREF(buckets);
+            return NULL;
+        }
+        Py_DECREF(bucket);
+    }
+    if (histogram->count == 0)  {
+        return Py_BuildValue("{s:K,s:N}", "count", (unsigned long long)0, "buckets", buckets);
+    }
+    return Py_BuildValue("{s:K,s:K,s:K,s:d,s:K,s:K,s:K,s:K,s:N}",
+                         "count", (unsigned long long)histogram->count,
+                         latency ? "min_usec" : "min", (unsigned long long)histogram->min,
+                         latency ? "max_usec" : "max", (unsigned long long)histogram->max,
+                         latency ? "mean_usec" : "mean",
+                         (double)histogram->sum / (double)histogram->count,
+                         latency ? "p50_usec" : "p50", (unsigned long long)stats_percentile(histogram, 50.0),
+                         latency ? "p90_usec" : "p90", (unsigned long long)stats_percentile(histogram, 90.0),
+                         latency ? "p99_usec" : "p99", (unsigned long long)stats_percentile(histogram, 99.0),
+                         latency ? "p999_usec" : "p999",
+                         (unsigned long long)stats_percentile(histogram, 99.9),
+                         "buckets", buckets);
+}
+
+
+/*
+ * Context.stats(reset=False).  Resetting zeroes everything but
+ * the number of queries outstanding
+ */
+
+PyObject *
+context_stats(getdns_ContextObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "reset",
+        0
+    };
+    pygetdns_stats *stats = self->stats;
+    PyObject *reset_obj = 0;
+    PyObject *latency;
+    PyObject *histogram;
+    PyObject *key;
+    PyObject *report;
+    size_t i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O", kwlist, &reset_obj))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if (stats == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_BAD_CONTEXT_TEXT);
+        return NULL;
+    }
+    if ((latency = PyDict_New()) == NULL)
+        return NULL;
+    for (i = 0 ; i < stats->n_histograms ; i++)  {
+        if (stats->histograms[i]->count == 0)
+            continue;
+#if PY_MAJOR_VERSION >= 3
+        key = PyLong_FromLong((long)stats->histograms[i]->request_type);
+#else
+        key = PyInt_FromLong((long)stats->histograms[i]->request_type);
+#endif
+        if (key == NULL || (histogram = stats_histogram_dict(stats->histograms[i], 1)) == NULL)  {
+            Py_XDECREF(key);
+            Py_DECREF(latency);
+            return NULL;
+        }
+        if (PyDict_SetItem(latency, key, histogram) < 0)  {
+            Py_DECREF(key);
+            Py_DECREF(histogram);
+            Py_DECREF(latency);
+            return NULL;
+        }
+        Py_DECREF(key);
+        Py_DECREF(histogram);
+    }
+    if ((histogram = stats_histogram_dict(&stats->batches, 0)) == NULL)  {
+        Py_DECREF(latency);
+        return NULL;
+    }
+    report = Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K,s:N,s:N}",
+                           "submitted",
+                           (unsigned long long)__atomic_load_n(&stats->submitted, __ATOMIC_RELAXED),
+                           "completed", (unsigned long long)stats->completed,
+                           "timed_out", (unsigned long long)stats->timed_out,
+                           "cancelled", (unsigned long long)stats->cancelled,
+                           "errored", (unsigned long long)stats->errored,
+                           "outstanding",
+                           (unsigned long long)__atomic_load_n(&stats->outstanding, __ATOMIC_RELAXED),
+                           "latency", latency,
+                           "batches", histogram);
+    if (report && reset_obj && PyObject_IsTrue(reset_obj))
+        context_stats_clear(stats);
+    return report;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <Python.h>
+#include <getdns/getdns.h>
+#include "pygetdns.h"
+
+/*
+ * Per-query tracing.  When Context.trace_hook is set, a sample
+ * of the queries made through the context (trace_sample, a
+ * fraction between 0 and 1) are reported to it once they've
+ * finished, as
+ *
+ *   hook(tid, name, rrtype, t_submit, t_complete,
+ *        t_callback_start, t_callback_end, status)
+ *
+ * with the times in nanoseconds on the monotonic clock (see
+ * context_stats_now()).  t_submit is taken just before the query
+ * is handed to getdns and t_complete as soon as getdns is done
+ * with it; the callback times bracket the Python callback, or
+ * the resolution of the *_async() futures, and are None for
+ * synchronous and bulk queries.  status is the response status,
+ * or the callback type if there's no response.
+ *
+ * With no hook set, all a query pays for this is a NULL check.
+ */
+
+static double
+trace_random(getdns_ContextObject *self)
+{
+    uint64_t x = self->trace_random;
+
+    x ^= x >> 12;                   /* xorshift64* */
+    x ^= x << 25;
+    x ^= x >> 27;
+    self->trace_random = x;
+    return (double)((x * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+
+int
+context_set_trace_hook(getdns_ContextObject *self, PyObject *py_value)
+{
+    if (py_value == NULL || py_value == Py_None)  {
+        Py_CLEAR(self->trace_hook);
+        return 0;
+    }
+    if (!PyCallable_Check(py_value))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return -1;
+    }
+    Py_INCREF(py_value);
+    Py_XDECREF(self->trace_hook);
+    self->trace_hook = py_value;
+    return 0;
+}
+
+
+int
+context_set_trace_sample(getdns_ContextObject *self, PyObject *py_value)
+{
+    double sample;
+
+    if (py_value == NULL || !PyNumber_Check(py_value))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return -1;
+    }
+    sample = PyFloat_AsDouble(py_value);
+    if (PyErr_Occurred() || sample < 0.0 || sample > 1.0)  {
+        PyErr_Clear();
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return -1;
+    }
+    self->trace_sample = sample;
+    return 0;
+}
+
+
+/*
+ * decide whether to trace a query that's about to be submitted,
+ * and if so fill in trace.  The name is either a C string or,
+ * for reverse lookups, the address object.  Only called when
+ * self->trace_hook is set
+ */
+
+void
+context_trace_begin(getdns_ContextObject *self, char *name, PyObject *name_obj,
+                    query_trace *trace)
+{
+    if (self->trace_sample < 1.0 && trace_random(self) >= self->trace_sample)
+        return;
+    if (name)  {
+#if PY_MAJOR_VERSION >= 3
+        name_obj = PyUnicode_FromString(name);
+#else
+        name_obj = PyString_FromString(name);
+#endif
+        if (name_obj == NULL)  {
+            PyErr_Clear();
+            return;
+        }
+    }  else  {
+        Py_INCREF(name_obj);
+    }
+    Py_INCREF(self->trace_hook);
+    trace->hook = self->trace_hook;
+    trace->name = name_obj;
+}
+
+
+static PyObject *
+trace_time(uint64_t t)
+{
+    if (t == 0)
+        Py_RETURN_NONE;
+    return PyLong_FromUnsignedLongLong((unsigned long long)t);
+}
+
+
+/*
+ * report a traced query to the hook and let go of trace.  tid
+ * is NULL for synchronous queries, and callback times of 0
+ * are passed as None
+ */
+
+void
+context_trace_end(query_trace *trace, getdns_transaction_t *tid, uint16_t request_type,
+                  uint64_t t_submit, uint64_t t_complete,
+                  uint64_t t_callback_start, uint64_t t_callback_end,
+                  getdns_callback_type_t type, getdns_dict *response)
+{
+    PyObject *ret;
+    PyObject *py_tid;
+    uint32_t status = (uint32_t)type;
+
+    if (trace->hook == NULL)
+        return;
+    if (response)
+        (void)getdns_dict_get_int(response, "status", &status);
+    if (tid)
+        py_tid = PyLong_FromUnsignedLongLong((unsigned long long)*tid);
+    else  {
+        Py_INCREF(Py_None);
+        py_tid = Py_None;
+    }
+    ret = PyObject_CallFunction(trace->hook, "NOiNNNNk", py_tid, trace->name, (int)request_type,
+                                trace_time(t_submit), trace_time(t_complete),
+                                trace_time(t_callback_start), trace_time(t_callback_end),
+                                (unsigned long)status);
+    if (ret == NULL)
+        PyErr_WriteUnraisable(trace->hook);
+    else
+        Py_DECREF(ret);
+    Py_CLEAR(trace->hook);
+    Py_CLEAR(trace->name);
+}
+
+
+/*
+ * bookkeeping once a synchronous query has come back: the
+ * statistics and, if it was sampled, the trace
+ */
+
+void
+context_sync_done(getdns_ContextObject *self, query_trace *trace, uint16_t request_type,
+                  uint64_t started, getdns_return_t ret, getdns_dict *response)
+{
+    uint64_t finished = context_stats_now();
+    getdns_callback_type_t type = GETDNS_CALLBACK_COMPLETE;
+
+    if (ret != GETDNS_RETURN_GOOD)  {
+        type = GETDNS_CALLBACK_ERROR;
+        response = 0;
+    }
+    context_stats_done(self->stats, request_type, started, finished, type, response);
+    context_trace_end(trace, 0, request_type, started, finished, 0, 0, type, response);
+}
@@ -32,6 +32,65 @@
 #include "pygetdns.h"
 
 
+/*
+ * the getdns_context behind a Context, or NULL with an exception
+ * set if there's none or the Context has been given back to the
+ * ContextPool it was leased from
+ */
+
+getdns_context *
+context_get(getdns_ContextObject *self)
+{
+    getdns_context *context;
+
+    if (self->pooled)  {
+        PyErr_SetString(getdns_error, "The Context has been given back to its pool");
+        return NULL;
+    }
+    if ((context = PyCapsule_GetPointer(self->py_context, "context")) == NULL)
+        PyErr_SetString(getdns_error, GETDNS_RETURN_BAD_CONTEXT_TEXT);
+    return context;
+}
+
+
+/*
+ * Serialize use of a context's getdns_context between threads,
+ * now that synchronous queries run without the GIL.  The lock is
+ * recursive so that a callback dispatched from run() may issue
+ * further queries on the same context.  Must be called with the
+ * GIL held; the GIL is dropped while waiting for another thread.
+ */
+
+void
+context_lock(getdns_ContextObject *self)
+{
+    long me = (long)PyThread_get_thread_ident();
+
+    /* only we ever set lock_owner to me */
+    if (PYGETDNS_LOAD(self->lock_owner) == me)  {
+        self->lock_depth++;
+        return;
+    }
+    if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK))  {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+    PYGETDNS_STORE(self->lock_owner, me);
+    self->lock_depth = 1;
+}
+
+
+void
+context_unlock(getdns_ContextObject *self)
+{
+    if (--self->lock_depth == 0)  {
+        PYGETDNS_STORE(self->lock_owner, 0);
+        PyThread_release_lock(self->lock);
+    }
+}
+
+
 /*
  *  Get the address of the Python function object
  *    being passed in by name to the context
@@ -61,49 +120,250 @@ get_callback(char *py_main, char *callback)
     return callback_func;
 }
 
-    
+
+/*
+ * Callback state is handed out from a free list, which is
+ * refilled a slab at a time and never shrinks, so a steady
+ * stream of asynchronous queries doesn't touch malloc at all.
+ * The pool is protected by the GIL, or by userarg_mutex where
+ * there isn't one.
+ */
+
+#define USERARG_SLAB_SIZE 256
+
+static userarg_blob *userarg_free_list = 0;
+PYGETDNS_MUTEX(userarg_mutex);
+
+userarg_blob *
+userarg_blob_new(getdns_ContextObject *self, PyObject *callback_func,
+                 PyObject *userarg, uint16_t request_type)
+{
+    userarg_blob *blob;
+    int i;
+
+    PYGETDNS_MUTEX_LOCK(userarg_mutex);
+    if (userarg_free_list == 0)  {
+        if ((blob = (userarg_blob *)PyMem_Malloc(USERARG_SLAB_SIZE * sizeof(userarg_blob))) == NULL)  {
+            PYGETDNS_MUTEX_UNLOCK(userarg_mutex);
+            PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+            return NULL;
+        }
+        for (i = 0 ; i < USERARG_SLAB_SIZE ; i++)  {
+            blob[i].next = userarg_free_list;
+            userarg_free_list = &blob[i];
+        }
+    }
+    blob = userarg_free_list;
+    userarg_free_list = blob->next;
+    PYGETDNS_MUTEX_UNLOCK(userarg_mutex);
+    Py_INCREF(callback_func);
+    blob->callback_func = callback_func;
+    Py_XINCREF(userarg);
+    blob->userarg = userarg;
+    blob->owner = self;
+    blob->batch = self->batch_callbacks;
+    blob->stats = self->stats;
+    blob->started = 0;
+    blob->request_type = request_type;
+    blob->trace.hook = blob->trace.name = 0;
+    blob->next = 0;
+    return blob;
+}
+
+
 void
-callback_shim(struct getdns_context *context,
-              getdns_callback_type_t type,
-              struct getdns_dict *response,
-              void *userarg,
-              getdns_transaction_t tid)
+userarg_blob_release(userarg_blob *blob)
+{
+    Py_CLEAR(blob->callback_func);
+    Py_CLEAR(blob->userarg);
+    Py_CLEAR(blob->trace.hook);
+    Py_CLEAR(blob->trace.name);
+    PYGETDNS_MUTEX_LOCK(userarg_mutex);
+    blob->next = userarg_free_list;
+    userarg_free_list = blob;
+    PYGETDNS_MUTEX_UNLOCK(userarg_mutex);
+}
+
+
+/*
+ * With batch_callbacks set, callbacks aren't called as each
+ * query completes.  Instead callback_shim() queues a (type,
+ * result, userarg, transaction_id) entry on the context, and
+ * once the turn of the event loop that completed it is over,
+ * context_batch_flush() calls each callback once, with a list of
+ * its entries in the order the queries completed.  Anything
+ * that completes outside a turn of the loop (a cancellation, say)
+ * is delivered straight away, as a list of one.
+ */
+
+static void
+callback_batch(userarg_blob *u, PyObject *py_callback_type, PyObject *py_result,
+               PyObject *py_userarg, PyObject *py_tid)
+{
+    getdns_ContextObject *owner = u->owner;
+    PyObject *entry;
+    PyObject *item;
+    PyObject *ret;
+
+    if ((entry = PyTuple_Pack(4, py_callback_type, py_result, py_userarg,
+                              py_tid ? py_tid : Py_None)) == NULL)  {
+        PyErr_WriteUnraisable(u->callback_func);
+        return;
+    }
+    if (owner->batching)  {
+        if ((owner->batch == NULL && (owner->batch = PyList_New(0)) == NULL) ||
+            (item = PyTuple_Pack(2, u->callback_func, entry)) == NULL)  {
+            PyErr_WriteUnraisable(u->callback_func);
+        }  else  {
+            if (PyList_Append(owner->batch, item) < 0)
+                PyErr_WriteUnraisable(u->callback_func);
+            Py_DECREF(item);
+        }
+        Py_DECREF(entry);
+        return;
+    }
+    if ((ret = PyObject_CallFunction(u->callback_func, "[N]", entry)) == NULL)
+        PyErr_WriteUnraisable(u->callback_func);
+    else
+        Py_DECREF(ret);
+}
+
+
+void
+context_batch_flush(getdns_ContextObject *self)
+{
+    PyObject *batch = self->batch;
+    PyObject *callbacks;
+    PyObject *entries = 0;
+    PyObject *callback;
+    PyObject *list;
+    PyObject *ret;
+    Py_ssize_t n, i, j;
+
+    if (batch == NULL || (n = PyList_GET_SIZE(batch)) == 0)
+        return;
+    context_stats_batch(self->stats, (uint64_t)n);
+    if ((callbacks = PyList_New(0)) == NULL || (entries = PyList_New(0)) == NULL)
+        goto error;
+    for (i = 0 ; i < n ; i++)  {
+        callback = PyTuple_GET_ITEM(PyList_GET_ITEM(batch, i), 0);
+        for (j = 0 ; j < PyList_GET_SIZE(callbacks) ; j++)  {
+            if (PyList_GET_ITEM(callbacks, j) == callback)
+                break;
+        }
+        if (j == PyList_GET_SIZE(callbacks))  {
+            if ((list = PyList_New(0)) == NULL)
+                goto error;
+            if (PyList_Append(callbacks, callback) < 0 || PyList_Append(entries, list) < 0)  {
+                Py_DECREF(list);
+                goto error;
+            }
+            Py_DECREF(list);
+        }
+        if (PyList_Append(PyList_GET_ITEM(entries, j), PyTuple_GET_ITEM(PyList_GET_ITEM(batch, i), 1)) < 0)
+            goto error;
+    }
+    (void)PyList_SetSlice(batch, 0, n, NULL);
+    for (j = 0 ; j < PyList_GET_SIZE(callbacks) ; j++)  {
+        callback = PyList_GET_ITEM(callbacks, j);
+        ret = PyObject_CallFunctionObjArgs(callback, PyList_GET_ITEM(entries, j), NULL);
+        if (ret == NULL)
+            PyErr_WriteUnraisable(callback);
+        else
+            Py_DECREF(ret);
+    }
+    Py_DECREF(callbacks);
+    Py_DECREF(entries);
+    return;
+
+error:
+    PyErr_WriteUnraisable(batch);
+    (void)PyList_SetSlice(batch, 0, n, NULL);
+    Py_XDECREF(callbacks);
+    Py_XDECREF(entries);
+}
+
+
+static void
+callback_deliver(userarg_blob *u, getdns_callback_type_t type,
+                 struct getdns_dict *response, getdns_transaction_t tid)
 {
     PyObject *py_callback_type;
     PyObject *py_result;
     PyObject *py_tid;
     PyObject *py_userarg;
+    PyObject *ret;
+    uint64_t completed;
+    uint64_t callback_started;
 
-    userarg_blob *u = (userarg_blob *)userarg;
+    completed = context_stats_now();
+    context_stats_done(u->stats, u->request_type, u->started, completed, type, response);
 #if PY_MAJOR_VERSION >= 3
     if ((py_callback_type = PyLong_FromLong((long)type)) == NULL)  {
 #else
     if ((py_callback_type = PyInt_FromLong((long)type)) == NULL)  {
 #endif
-        PyObject *err_type, *err_value, *err_traceback;
-        PyErr_Fetch(&err_type, &err_value, &err_traceback);
-        PyErr_Restore(err_type, err_value, err_traceback);
+        PyErr_WriteUnraisable(u->callback_func);
+        userarg_blob_release(u);
         return;
     }
     if (type == GETDNS_CALLBACK_CANCEL)  {
+        Py_INCREF(Py_None);
         py_result = Py_None;
+        Py_INCREF(Py_None);
         py_tid = Py_None;
         py_userarg = Py_None;
     }  else  {
-        py_result = result_create(response);
+        if ((py_result = result_create(response)) == NULL)  {
+            PyErr_WriteUnraisable(u->callback_func);
+            Py_INCREF(Py_None);
+            py_result = Py_None;
+        }
 #if PY_MAJOR_VERSION >= 3
         py_tid = PyLong_FromLong((long)tid);
 #else
         py_tid = PyInt_FromLong((long)tid);
 #endif
-        if (u->userarg)
-#if PY_MAJOR_VERSION >= 3
-            py_userarg = PyUnicode_FromString(u->userarg);
-#else
-            py_userarg = PyString_FromString(u->userarg);
-#endif
+        py_userarg = u->userarg ? u->userarg : Py_None;
+    }
+    if (u->batch)  {
+        callback_batch(u, py_callback_type, py_result, py_userarg, py_tid);
+        if (u->trace.hook)          /* the callback hasn't run yet */
+            context_trace_end(&u->trace, &tid, u->request_type, u->started, completed,
+                              0, 0, type, py_result != Py_None ? response : NULL);
+    }  else  {
+        callback_started = u->trace.hook ? context_stats_now() : 0;
+        ret = PyObject_CallFunctionObjArgs(u->callback_func, py_callback_type, py_result, py_userarg, py_tid, NULL);
+        if (ret == NULL)
+            PyErr_WriteUnraisable(u->callback_func);
         else
-            py_userarg = Py_None;
+            Py_DECREF(ret);
+        if (u->trace.hook)
+            context_trace_end(&u->trace, &tid, u->request_type, u->started, completed,
+                              callback_started, context_stats_now(), type,
+                              py_result != Py_None ? response : NULL);
     }
-    PyObject_CallFunctionObjArgs(u->callback_func, py_callback_type, py_result, py_userarg, py_tid, NULL);
+    Py_DECREF(py_callback_type);
+    Py_DECREF(py_result);
+    Py_XDECREF(py_tid);
+    userarg_blob_release(u);
+}
+
+
+void
+callback_shim(struct getdns_context *context,
+              getdns_callback_type_t type,
+              struct getdns_dict *response,
+              void *userarg,
+              getdns_transaction_t tid)
+{
+    userarg_blob *u = (userarg_blob *)userarg;
+    PyGILState_STATE gstate;
+
+    /* we may be called from an event loop running without the GIL */
+    gstate = PyGILState_Ensure();
+    PYGETDNS_BEGIN_LOCKED(u->owner);
+    callback_deliver(u, type, response, tid);
+    PYGETDNS_END_LOCKED();
+    PyGILState_Release(gstate);
 }
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <Python.h>
+#include <getdns/getdns.h>
+#include "pygetdns.h"
+
+/*
+ * Extensions objects hold a set of query extensions that have
+ * already been checked and converted to a getdns dict, so that
+ * a caller making many queries with the same extensions pays
+ * for the conversion once instead of on every call.  The query
+ * methods (and bulk() and the asyncio methods) take one anywhere
+ * they take an extensions dict, and every query made with it
+ * passes the same getdns dict to getdns, which copies what it
+ * needs, so sharing it between Contexts and threads is safe.
+ *
+ * The object is immutable; it also keeps a copy of the items it
+ * was made from, for repr() and item access, and the part of a
+ * query key that they make up (see context_query_key()), so that
+ * an Extensions and an equal dict hit the same cache entries.
+ */
+
+PyObject *
+extensions_new(PyTypeObject *type, PyObject *args, PyObject *keywds)
+{
+    getdns_ExtensionsObject *self;
+    PyObject *items;
+    PyObject *extensions = 0;
+
+    if (!PyArg_ParseTuple(args, "|O:Extensions", &extensions))
+        return NULL;
+    if ((items = PyDict_New()) == NULL)
+        return NULL;
+    if (extensions && extensions != Py_None)  {
+        if (PyObject_TypeCheck(extensions, &getdns_ExtensionsType))
+            extensions = ((getdns_ExtensionsObject *)extensions)->items;
+        if (!PyDict_Check(extensions))  {
+            Py_DECREF(items);
+            PyErr_SetString(getdns_error, "Expected dict, didn't get one");
+            return NULL;
+        }
+        if (PyDict_Update(items, extensions) < 0)  {
+            Py_DECREF(items);
+            return NULL;
+        }
+    }
+    if (keywds && PyDict_Update(items, keywds) < 0)  {
+        Py_DECREF(items);
+        return NULL;
+    }
+    if ((self = (getdns_ExtensionsObject *)type->tp_alloc(type, 0)) == NULL)  {
+        Py_DECREF(items);
+        return NULL;
+    }
+    self->items = items;
+    if ((self->extensions = extensions_to_getdnsdict((PyDictObject *)items)) == NULL ||
+        (self->key = extensions_key(items)) == NULL)  {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *)self;
+}
+
+
+void
+extensions_dealloc(getdns_ExtensionsObject *self)
+{
+    if (self->extensions)
+        getdns_dict_destroy(self->extensions);
+    Py_XDECREF(self->items);
+    Py_XDECREF(self->key);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+Py_ssize_t
+extensions_length(getdns_ExtensionsObject *self)
+{
+    return PyDict_Size(self->items);
+}
+
+
+PyObject *
+extensions_subscript(getdns_ExtensionsObject *self, PyObject *key)
+{
+    return PyObject_GetItem(self->items, key);
+}
+
+
+PyObject *
+extensions_repr(getdns_ExtensionsObject *self)
+{
+    PyObject *items;
+    PyObject *repr;
+
+    if ((items = PyObject_Repr(self->items)) == NULL)
+        return NULL;
+#if PY_MAJOR_VERSION >= 3
+    repr = PyUnicode_FromFormat("getdns.Extensions(%U)", items);
+#else
+    repr = PyString_FromFormat("getdns.Extensions(%s)", PyString_AsString(items));
+#endif
+    Py_DECREF(items);
+    return repr;
+}
+
+
+/*
+ * the extensions' part of a query key: None if there aren't
+ * any, or the repr() of their items, sorted, so that equal dicts
+ * give equal keys.  Extensions objects worked theirs out when
+ * they were made
+ */
+
+PyObject *
+extensions_key(PyObject *extensions)
+{
+    PyObject *items;
+    PyObject *key;
+
+    if (extensions && PyObject_TypeCheck(extensions, &getdns_ExtensionsType))  {
+        Py_INCREF(((getdns_ExtensionsObject *)extensions)->key);
+        return ((getdns_ExtensionsObject *)extensions)->key;
+    }
+    if (extensions == NULL || !PyDict_Check(extensions) || PyDict_Size(extensions) == 0)  {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    if ((items = PyDict_Items(extensions)) == NULL)
+        return NULL;
+    if (PyList_Sort(items) < 0)  {
+        Py_DECREF(items);
+        return NULL;
+    }
+    key = PyObject_Repr(items);
+    Py_DECREF(items);
+    return key;
+}
+
+
+/*
+ * the getdns dict to pass to a query for the extensions argument
+ * obj, which may be missing, None, a dict or an Extensions.
+ * Returns -1 with an exception set if a dict won't convert.
+ * Hand the dict back with extensions_put() once getdns has it
+ */
+
+int
+extensions_get(PyObject *obj, struct getdns_dict **dict)
+{
+    *dict = 0;
+    if (obj == NULL || obj == Py_None)
+        return 0;
+    if (PyObject_TypeCheck(obj, &getdns_ExtensionsType))  {
+        *dict = ((getdns_ExtensionsObject *)obj)->extensions;
+        return 0;
+    }
+    if ((*dict = extensions_to_getdnsdict((PyDictObject *)obj)) == NULL)
+        return -1;
+    return 0;
+}
+
+
+void
+extensions_put(PyObject *obj, struct getdns_dict *dict)
+{
+    if (dict && !PyObject_TypeCheck(obj, &getdns_ExtensionsType))
+        getdns_dict_destroy(dict);
+}
@@ -54,11 +54,119 @@ static PyObject *get_errorstr_by_id(PyObject *self, PyObject *args, PyObject *ke
 static PyObject *root_trust_anchor(PyObject *self, PyObject *args, PyObject *keywds);
 static void add_getdns_constants(PyObject *g);
 
+/*
+ * In free-threaded builds the methods of objects with state of
+ * their own are called through these wrappers, which run them in
+ * a critical section on self (see PYGETDNS_BEGIN_LOCKED() in
+ * pygetdns.h).  Otherwise LOCKED(f) is just f
+ */
+
+#ifdef Py_GIL_DISABLED
+
+#define LOCKED_WRAPPER(ret_type, f, params, args)   \
+static ret_type                                     \
+f##_locked params                                   \
+{                                                   \
+    ret_type ret;                                   \
+                                                    \
+    PYGETDNS_BEGIN_LOCKED(self);                    \
+    ret = f args;                                   \
+    PYGETDNS_END_LOCKED();                          \
+    return ret;                                     \
+}
+#define LOCKED_NOARGS(f, type) \
+    LOCKED_WRAPPER(PyObject *, f, (type *self, PyObject *unused), (self, unused))
+#define LOCKED_VARARGS(f, type) \
+    LOCKED_WRAPPER(PyObject *, f, (type *self, PyObject *args), (self, args))
+#define LOCKED_KEYWORDS(f, type) \
+    LOCKED_WRAPPER(PyObject *, f, (type *self, PyObject *args, PyObject *keywds), \
+                   (self, args, keywds))
+#define LOCKED_QUERY(f, type) \
+    LOCKED_WRAPPER(PyObject *, f, (type *self, PyObject *const *args, Py_ssize_t nargs, \
+                                   PyObject *kwnames), (self, args, nargs, kwnames))
+#define LOCKED_GETTER(f, type) \
+    LOCKED_WRAPPER(PyObject *, f, (type *self, void *closure), (self, closure))
+#define LOCKED_REPR(f) \
+    LOCKED_WRAPPER(PyObject *, f, (PyObject *self), (self))
+#define LOCKED_SETATTRO(f) \
+    LOCKED_WRAPPER(int, f, (PyObject *self, PyObject *name, PyObject *value), \
+                   (self, name, value))
+#define LOCKED_GETBUFFER(f, type) \
+    LOCKED_WRAPPER(int, f, (type *self, Py_buffer *view, int flags), (self, view, flags))
+#define LOCKED(f) f##_locked
+
+#else
+
+#define LOCKED_NOARGS(f, type)
+#define LOCKED_VARARGS(f, type)
+#define LOCKED_KEYWORDS(f, type)
+#define LOCKED_QUERY(f, type)
+#define LOCKED_GETTER(f, type)
+#define LOCKED_REPR(f)
+#define LOCKED_SETATTRO(f)
+#define LOCKED_GETBUFFER(f, type)
+#define LOCKED(f) f
+
+#endif
+
+LOCKED_GETTER(result_get_just_address_answers, getdns_ResultObject)
+LOCKED_GETTER(result_get_replies_tree, getdns_ResultObject)
+LOCKED_GETTER(result_get_replies_full, getdns_ResultObject)
+LOCKED_GETTER(result_get_status, getdns_ResultObject)
+LOCKED_GETTER(result_get_answer_type, getdns_ResultObject)
+LOCKED_GETTER(result_get_canonical_name, getdns_ResultObject)
+LOCKED_GETTER(result_get_validation_chain, getdns_ResultObject)
+LOCKED_GETTER(result_get_wire, getdns_ResultObject)
+LOCKED_GETTER(result_get_wires, getdns_ResultObject)
+LOCKED_KEYWORDS(result_records, getdns_ResultObject)
+LOCKED_GETBUFFER(result_getbuffer, getdns_ResultObject)
+LOCKED_REPR(result_str)
+
+LOCKED_NOARGS(context_get_api_information, getdns_ContextObject)
+LOCKED_QUERY(context_general, getdns_ContextObject)
+LOCKED_QUERY(context_address, getdns_ContextObject)
+LOCKED_QUERY(context_hostname, getdns_ContextObject)
+LOCKED_QUERY(context_service, getdns_ContextObject)
+LOCKED_KEYWORDS(context_run, getdns_ContextObject)
+LOCKED_KEYWORDS(context_run_once, getdns_ContextObject)
+LOCKED_NOARGS(context_process_events, getdns_ContextObject)
+LOCKED_NOARGS(context_fileno, getdns_ContextObject)
+LOCKED_NOARGS(context_next_timeout, getdns_ContextObject)
+LOCKED_KEYWORDS(context_cancel_callback, getdns_ContextObject)
+LOCKED_KEYWORDS(context_bulk, getdns_ContextObject)
+LOCKED_NOARGS(context_cache_info, getdns_ContextObject)
+LOCKED_NOARGS(context_cache_clear, getdns_ContextObject)
+LOCKED_NOARGS(context_coalesce_info, getdns_ContextObject)
+LOCKED_KEYWORDS(context_stats, getdns_ContextObject)
+LOCKED_KEYWORDS(context_general_async, getdns_ContextObject)
+LOCKED_KEYWORDS(context_address_async, getdns_ContextObject)
+LOCKED_KEYWORDS(context_hostname_async, getdns_ContextObject)
+LOCKED_KEYWORDS(context_service_async, getdns_ContextObject)
+LOCKED_GETTER(context_get_list_setting, getdns_ContextObject)
+LOCKED_REPR(context_str)
+LOCKED_SETATTRO(context_setattro)
+
+LOCKED_KEYWORDS(context_pool_lease, getdns_ContextPoolObject)
+LOCKED_NOARGS(context_pool_thread_context, getdns_ContextPoolObject)
+LOCKED_KEYWORDS(context_pool_stats, getdns_ContextPoolObject)
+LOCKED_NOARGS(context_lease_release, getdns_ContextLeaseObject)
+LOCKED_NOARGS(context_lease_enter, getdns_ContextLeaseObject)
+LOCKED_VARARGS(context_lease_exit, getdns_ContextLeaseObject)
+LOCKED_GETTER(context_lease_get_context, getdns_ContextLeaseObject)
+
+LOCKED_KEYWORDS(resolver_submit, getdns_ResolverObject)
+LOCKED_KEYWORDS(resolver_collect, getdns_ResolverObject)
+LOCKED_KEYWORDS(resolver_bulk, getdns_ResolverObject)
+LOCKED_NOARGS(resolver_close, getdns_ResolverObject)
+
+
 static struct PyMethodDef getdns_methods[] = {
     { "get_errorstr_by_id", (PyCFunction)get_errorstr_by_id,
       METH_VARARGS|METH_KEYWORDS, "return getdns error text by error id" },
     { "root_trust_anchor", (PyCFunction)root_trust_anchor, METH_NOARGS,
       "retrieve default list of trust anchor records used to validate DNSSEC" },
+    { "_bench_converter", (PyCFunction)bench_converter, METH_VARARGS|METH_KEYWORDS,
+      "time a getdns-to-Python converter (for benchmarks/convert-bench.py)" },
     { 0, 0, 0 }
 };
 
@@ -78,27 +186,39 @@ static struct PyModuleDef getdnsdef = {
 };
 #endif
 
-PyMemberDef Result_members[] = {
-    { "just_address_answers", T_OBJECT_EX, offsetof(getdns_ResultObject, just_address_answers),
-      READONLY, "Only the query answers" },
-    { "replies_tree", T_OBJECT_EX, offsetof(getdns_ResultObject, replies_tree),
-      READONLY, "The replies tree dictionary" },
-    { "replies_full", T_OBJECT_EX, offsetof(getdns_ResultObject, replies_full),
-      READONLY, "The entire replies structure returned by getdns" },
-    { "status", T_OBJECT_EX, offsetof(getdns_ResultObject, status), READONLY,
-      "Response status" },
-    { "answer_type", T_OBJECT_EX, offsetof(getdns_ResultObject, answer_type), READONLY, "Answer type" },
-    { "canonical_name", T_OBJECT_EX, offsetof(getdns_ResultObject, canonical_name), READONLY,
-      "Canonical name" },
-    { "validation_chain", T_OBJECT_EX, offsetof(getdns_ResultObject, validation_chain),
-      READONLY, "DNSSEC certificate chain" },
+PyGetSetDef Result_getset[] = {
+    { "just_address_answers", (getter)LOCKED(result_get_just_address_answers), NULL,
+      "Only the query answers", NULL },
+    { "replies_tree", (getter)LOCKED(result_get_replies_tree), NULL,
+      "The replies tree dictionary", NULL },
+    { "replies_full", (getter)LOCKED(result_get_replies_full), NULL,
+      "The entire replies structure returned by getdns", NULL },
+    { "status", (getter)LOCKED(result_get_status), NULL, "Response status", NULL },
+    { "answer_type", (getter)LOCKED(result_get_answer_type), NULL, "Answer type", NULL },
+    { "canonical_name", (getter)LOCKED(result_get_canonical_name), NULL, "Canonical name", NULL },
+    { "validation_chain", (getter)LOCKED(result_get_validation_chain), NULL,
+      "DNSSEC certificate chain", NULL },
+    { "wire", (getter)LOCKED(result_get_wire), NULL,
+      "The first reply in DNS wire format, as a memoryview", NULL },
+    { "wires", (getter)LOCKED(result_get_wires), NULL,
+      "Every reply in DNS wire format, as a tuple of Bindata", NULL },
     { NULL },
 };
 
 static PyMethodDef Result_methods[] = {
+    { "records", (PyCFunction)LOCKED(result_records), METH_VARARGS|METH_KEYWORDS,
+      "Return the records of one type in one section, decoded into tuples" },
     { NULL },
 };
 
+static PyBufferProcs Result_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    0, 0, 0, 0,                 /* old-style buffer interface */
+#endif
+    (getbufferproc)LOCKED(result_getbuffer),
+    0,
+};
+
 
 PyTypeObject getdns_ResultType = {
 #if PY_MAJOR_VERSION >= 3
@@ -115,17 +235,21 @@ PyTypeObject getdns_ResultType = {
     0,                         /*tp_getattr*/
     0,                         /*tp_setattr*/
     0,                         /*tp_compare*/
-    result_str,                /*tp_repr*/
+    LOCKED(result_str),        /*tp_repr*/
     0,                         /*tp_as_number*/
     0,                         /*tp_as_sequence*/
     0,                         /*tp_as_mapping*/
     0,                         /*tp_hash */
     0,                         /*tp_call*/
-    result_str,                /*tp_str*/
+    LOCKED(result_str),        /*tp_str*/
     0,                         /*tp_getattro*/
     0,                         /*tp_setattro*/
-    0,                         /*tp_as_buffer*/
+    &Result_as_buffer,         /*tp_as_buffer*/
+#if PY_MAJOR_VERSION >= 3
     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
+#else
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_NEWBUFFER, /*tp_flags*/
+#endif
     "Result objects",          /* tp_doc */
     0,               /* tp_traverse */
     0,               /* tp_clear */
@@ -134,8 +258,8 @@ PyTypeObject getdns_ResultType = {
     0,               /* tp_iter */
     0,               /* tp_iternext */
     Result_methods,             /* tp_methods */
-    Result_members,             /* tp_members */
-    0,                         /* tp_getset */
+    0,                         /* tp_members */
+    Result_getset,             /* tp_getset */
     0,                         /* tp_base */
     0,                         /* tp_dict */
     0,                         /* tp_descr_get */
@@ -147,60 +271,225 @@ PyTypeObject getdns_ResultType = {
 };
 
 
+static PyMethodDef Bindata_methods[] = {
+    { "tobytes", (PyCFunction)bindata_tobytes, METH_NOARGS,
+      "Return a copy of the data as bytes" },
+    { "hex", (PyCFunction)bindata_hex, METH_NOARGS,
+      "Return the data as a string of hex digits" },
+    { NULL },
+};
+
+static PySequenceMethods Bindata_as_sequence = {
+    (lenfunc)bindata_length,    /* sq_length */
+    0,                          /* sq_concat */
+    0,                          /* sq_repeat */
+    (ssizeargfunc)bindata_item, /* sq_item */
+};
+
+static PyBufferProcs Bindata_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    0, 0, 0, 0,                 /* old-style buffer interface */
+#endif
+    (getbufferproc)bindata_getbuffer,
+    0,
+};
+
+
+PyTypeObject getdns_BindataType = {
+#if PY_MAJOR_VERSION >= 3
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+#endif
+    "getdns.Bindata",          /*tp_name*/
+    sizeof(getdns_BindataObject), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)bindata_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    (reprfunc)bindata_repr,    /*tp_repr*/
+    0,                         /*tp_as_number*/
+    &Bindata_as_sequence,      /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    (hashfunc)bindata_hash,    /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    &Bindata_as_buffer,        /*tp_as_buffer*/
+#if PY_MAJOR_VERSION >= 3
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+#else
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /*tp_flags*/
+#endif
+    "Binary data from a response, shared with the response rather than copied", /* tp_doc */
+    0,               /* tp_traverse */
+    0,               /* tp_clear */
+    bindata_richcompare,       /* tp_richcompare */
+    0,               /* tp_weaklistoffset */
+    0,               /* tp_iter */
+    0,               /* tp_iternext */
+    Bindata_methods,           /* tp_methods */
+};
+
+static PyMappingMethods Extensions_as_mapping = {
+    (lenfunc)extensions_length,         /* mp_length */
+    (binaryfunc)extensions_subscript,   /* mp_subscript */
+    0,                                  /* mp_ass_subscript */
+};
+
+
+PyTypeObject getdns_ExtensionsType = {
+#if PY_MAJOR_VERSION >= 3
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+#endif
+    "getdns.Extensions",       /*tp_name*/
+    sizeof(getdns_ExtensionsObject), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)extensions_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    (reprfunc)extensions_repr, /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    &Extensions_as_mapping,    /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    "Query extensions, converted once and shared by every query made with them", /* tp_doc */
+    0,               /* tp_traverse */
+    0,               /* tp_clear */
+    0,               /* tp_richcompare */
+    0,               /* tp_weaklistoffset */
+    0,               /* tp_iter */
+    0,               /* tp_iternext */
+    0,               /* tp_methods */
+    0,               /* tp_members */
+    0,               /* tp_getset */
+    0,               /* tp_base */
+    0,               /* tp_dict */
+    0,               /* tp_descr_get */
+    0,               /* tp_descr_set */
+    0,               /* tp_dictoffset */
+    0,               /* tp_init */
+    0,               /* tp_alloc */
+    extensions_new,            /* tp_new */
+};
+
 PyMethodDef Context_methods[] = {
-    { "get_api_information", (PyCFunction)context_get_api_information,
+    { "get_api_information", (PyCFunction)LOCKED(context_get_api_information),
       METH_NOARGS, "Return context settings" },
-    { "general", (PyCFunction)context_general, METH_VARARGS|METH_KEYWORDS,
+    { "general", (PyCFunction)(void(*)(void))LOCKED(context_general), QUERY_METH_FLAGS,
       "method for looking up any type of DNS record" },
-    { "address", (PyCFunction)context_address, METH_VARARGS|METH_KEYWORDS,
+    { "address", (PyCFunction)(void(*)(void))LOCKED(context_address), QUERY_METH_FLAGS,
       "method for looking up an address given a host name" },
-    { "hostname", (PyCFunction)context_hostname, METH_VARARGS|METH_KEYWORDS,
+    { "hostname", (PyCFunction)(void(*)(void))LOCKED(context_hostname), QUERY_METH_FLAGS,
       "method for looking up a host name given an IP address" },
-    { "service", (PyCFunction)context_service, METH_VARARGS|METH_KEYWORDS,
+    { "service", (PyCFunction)(void(*)(void))LOCKED(context_service), QUERY_METH_FLAGS,
       "method for looking up relevant SRV record for a name" },
-    { "run", (PyCFunction)context_run, METH_VARARGS|METH_KEYWORDS,
-      "run unprocessed events" },
-    { "cancel_callback", (PyCFunction)context_cancel_callback, METH_VARARGS|METH_KEYWORDS,
+    { "run", (PyCFunction)LOCKED(context_run), METH_VARARGS|METH_KEYWORDS,
+      "run events until no queries are outstanding, or until the timeout" },
+    { "run_once", (PyCFunction)LOCKED(context_run_once), METH_VARARGS|METH_KEYWORDS,
+      "wait for and run one batch of events" },
+    { "process_events", (PyCFunction)LOCKED(context_process_events), METH_NOARGS,
+      "run whatever events are ready, without waiting" },
+    { "fileno", (PyCFunction)LOCKED(context_fileno), METH_NOARGS,
+      "return a descriptor that polls readable when process_events() has work" },
+    { "next_timeout", (PyCFunction)LOCKED(context_next_timeout), METH_NOARGS,
+      "return the seconds until process_events() has a timer to run, or None" },
+    { "cancel_callback", (PyCFunction)LOCKED(context_cancel_callback), METH_VARARGS|METH_KEYWORDS,
       "cancel outstanding callbacks" },
+    { "bulk", (PyCFunction)LOCKED(context_bulk), METH_VARARGS|METH_KEYWORDS,
+      "resolve a list of (name, request_type) queries, returning results in order" },
+    { "cache_info", (PyCFunction)LOCKED(context_cache_info), METH_NOARGS,
+      "return response cache statistics" },
+    { "cache_clear", (PyCFunction)LOCKED(context_cache_clear), METH_NOARGS,
+      "drop all cached responses" },
+    { "coalesce_info", (PyCFunction)LOCKED(context_coalesce_info), METH_NOARGS,
+      "return counts of queries issued and coalesced with one in flight" },
+    { "stats", (PyCFunction)LOCKED(context_stats), METH_VARARGS|METH_KEYWORDS,
+      "return query counters and latency histograms" },
+#if PY_MAJOR_VERSION >= 3
+    { "general_async", (PyCFunction)LOCKED(context_general_async), METH_VARARGS|METH_KEYWORDS,
+      "look up any type of DNS record, returning an asyncio future" },
+    { "address_async", (PyCFunction)LOCKED(context_address_async), METH_VARARGS|METH_KEYWORDS,
+      "look up an address given a host name, returning an asyncio future" },
+    { "hostname_async", (PyCFunction)LOCKED(context_hostname_async), METH_VARARGS|METH_KEYWORDS,
+      "look up a host name given an IP address, returning an asyncio future" },
+    { "service_async", (PyCFunction)LOCKED(context_service_async), METH_VARARGS|METH_KEYWORDS,
+      "look up relevant SRV record for a name, returning an asyncio future" },
+#endif
     { NULL }
 };
 
 PyMemberDef Context_members[] = {
-    { "timeout", T_INT, offsetof(getdns_ContextObject, timeout), 0, "timeout in milliseconds" },
-    { "resolution_type", T_INT, offsetof(getdns_ContextObject, resolution_type), 0,
+    { "timeout", T_ULONGLONG, offsetof(getdns_ContextObject, timeout), READONLY,
+      "timeout in milliseconds" },
+    { "resolution_type", T_INT, offsetof(getdns_ContextObject, resolution_type), READONLY,
       "lookup as recursive or stub resolver" },
-    { "dns_transport_list", T_OBJECT, offsetof(getdns_ContextObject, dns_transport_list), 0, 
-      "ordered list of dns transports" },
-    { "limit_outstanding_queries", T_INT, offsetof(getdns_ContextObject, limit_outstanding_queries),
-      0, "limit on the number of unanswered queries" },
+    { "limit_outstanding_queries", T_USHORT, offsetof(getdns_ContextObject, limit_outstanding_queries),
+      READONLY, "limit on the number of unanswered queries" },
     { "follow_redirects", T_INT, offsetof(getdns_ContextObject, follow_redirects),
-      0, "follow redirects" },
+      READONLY, "follow redirects" },
     { "append_name", T_INT, offsetof(getdns_ContextObject, append_name),
-      0, "append a suffix to the query string before resolving name" },
-    { "dnssec_allowed_skew", T_INT, offsetof(getdns_ContextObject, dnssec_allowed_skew), 0,
+      READONLY, "append a suffix to the query string before resolving name" },
+    { "dnssec_allowed_skew", T_UINT, offsetof(getdns_ContextObject, dnssec_allowed_skew), READONLY,
       "number of seconds of skew allowed when checking RRSIG Expiration and Inception fields" },
-    { "edns_maximum_udp_payload_size", T_INT, offsetof(getdns_ContextObject, edns_maximum_udp_payload_size),
-      0, "edns maximum udp payload size" },
-    { "edns_extended_rcode", T_INT, offsetof(getdns_ContextObject, edns_extended_rcode),
-      0, "edns extended rcode" },
-    { "edns_do_bit", T_INT, offsetof(getdns_ContextObject, edns_do_bit),
-      0, "edns do bit" },
-    { "edns_version", T_INT, offsetof(getdns_ContextObject, edns_version), 0, "edns version" },
-    { "namespaces", T_OBJECT, offsetof(getdns_ContextObject, namespaces), 0,
-      "ordered list of namespaces to be queried" },
-    { "dns_root_servers", T_OBJECT, offsetof(getdns_ContextObject, dns_root_servers), 0,
-      "list of dictionaries of root servers" },
-    { "dnssec_trust_anchors", T_OBJECT, offsetof(getdns_ContextObject, dnssec_trust_anchors), 0,
-      "list of trust anchors" },
-    { "suffix", T_OBJECT, offsetof(getdns_ContextObject, suffix), 0, "list of strings to be appended to search strings" },
-    { "upstream_recursive_servers", T_OBJECT, offsetof(getdns_ContextObject,
-                                                       upstream_recursive_servers), 0,
-      "list of dictionaries defining where a stub resolver will send queries" },
-    { "implementation_string", T_STRING|READONLY, offsetof(getdns_ContextObject, implementation_string), 0,
+    { "edns_maximum_udp_payload_size", T_USHORT, offsetof(getdns_ContextObject, edns_maximum_udp_payload_size),
+      READONLY, "edns maximum udp payload size" },
+    { "edns_extended_rcode", T_UBYTE, offsetof(getdns_ContextObject, edns_extended_rcode),
+      READONLY, "edns extended rcode" },
+    { "edns_do_bit", T_UBYTE, offsetof(getdns_ContextObject, edns_do_bit),
+      READONLY, "edns do bit" },
+    { "edns_version", T_UBYTE, offsetof(getdns_ContextObject, edns_version), READONLY, "edns version" },
+    { "implementation_string", T_STRING, offsetof(getdns_ContextObject, implementation_string), READONLY,
       "string set by the implementer" },
-    { "version_string", T_STRING|READONLY, offsetof(getdns_ContextObject, version_string), 0,
+    { "version_string", T_STRING, offsetof(getdns_ContextObject, version_string), READONLY,
       "string set by the implementer" },
-    {"idle_timeout", T_INT, offsetof(getdns_ContextObject, idle_timeout), 0, "TCP idle timeout" },
+    {"idle_timeout", T_ULONGLONG, offsetof(getdns_ContextObject, idle_timeout), READONLY, "TCP idle timeout" },
+    { "cache_size", T_PYSSIZET, offsetof(getdns_ContextObject, cache_size), READONLY,
+      "maximum number of cached responses, 0 to disable the cache" },
+    { "trace_hook", T_OBJECT, offsetof(getdns_ContextObject, trace_hook), READONLY,
+      "called with the timings of sampled queries, or None" },
+    { "trace_sample", T_DOUBLE, offsetof(getdns_ContextObject, trace_sample), READONLY,
+      "fraction of queries reported to trace_hook" },
+    { "batch_callbacks", T_BOOL, offsetof(getdns_ContextObject, batch_callbacks), READONLY,
+      "deliver callbacks in a list per turn of the event loop" },
+    { NULL }
+};
+
+/* closure is the offset of the cached list in the Context object */
+PyGetSetDef Context_getset[] = {
+    { "dns_transport_list", (getter)LOCKED(context_get_list_setting), NULL,
+      "ordered list of dns transports",
+      (void *)offsetof(getdns_ContextObject, dns_transport_list) },
+    { "namespaces", (getter)LOCKED(context_get_list_setting), NULL,
+      "ordered list of namespaces to be queried",
+      (void *)offsetof(getdns_ContextObject, namespaces) },
+    { "dns_root_servers", (getter)LOCKED(context_get_list_setting), NULL,
+      "list of dictionaries of root servers",
+      (void *)offsetof(getdns_ContextObject, dns_root_servers) },
+    { "dnssec_trust_anchors", (getter)LOCKED(context_get_list_setting), NULL,
+      "list of trust anchors",
+      (void *)offsetof(getdns_ContextObject, dnssec_trust_anchors) },
+    { "suffix", (getter)LOCKED(context_get_list_setting), NULL,
+      "list of strings to be appended to search strings",
+      (void *)offsetof(getdns_ContextObject, suffix) },
+    { "upstream_recursive_servers", (getter)LOCKED(context_get_list_setting), NULL,
+      "list of dictionaries defining where a stub resolver will send queries",
+      (void *)offsetof(getdns_ContextObject, upstream_recursive_servers) },
     { NULL }
 };
 
@@ -220,15 +509,15 @@ PyTypeObject getdns_ContextType = {
     0,                         /* tp_getattr */
     0,                         /* tp_setattr */
     0,                         /*tp_compare*/
-    context_str,               /*tp_repr*/
+    LOCKED(context_str),       /*tp_repr*/
     0,                         /*tp_as_number*/
     0,                         /*tp_as_sequence*/
     0,                         /*tp_as_mapping*/
     0,                         /*tp_hash */
     0,                         /*tp_call*/
-    context_str,                         /*tp_str*/
-    context_getattro,          /*tp_getattro*/
-    context_setattro,          /*tp_setattro*/
+    LOCKED(context_str),                 /*tp_str*/
+    0,                         /*tp_getattro*/
+    LOCKED(context_setattro),  /*tp_setattro*/
     0,                         /*tp_as_buffer*/
     Py_TPFLAGS_DEFAULT,        /*tp_flags*/
     "Context object",          /* tp_doc */
@@ -240,7 +529,7 @@ PyTypeObject getdns_ContextType = {
     0,                         /* tp_iternext       */
     Context_methods,           /* tp_methods        */
     Context_members,           /* tp_members        */
-    0,                         /* tp_getset         */
+    Context_getset,            /* tp_getset         */
     0,                         /* tp_base           */
     0,                         /* tp_dict           */
     0,                         /* tp_descr_get      */
@@ -250,6 +539,200 @@ PyTypeObject getdns_ContextType = {
 };
 
 
+PyMethodDef ContextPool_methods[] = {
+    { "lease", (PyCFunction)LOCKED(context_pool_lease), METH_VARARGS|METH_KEYWORDS,
+      "take a Context from the pool, waiting for one if they're all in use" },
+    { "thread_context", (PyCFunction)LOCKED(context_pool_thread_context), METH_NOARGS,
+      "the Context bound to the calling thread" },
+    { "stats", (PyCFunction)LOCKED(context_pool_stats), METH_VARARGS|METH_KEYWORDS,
+      "return the pool's lease, wait and utilisation counters" },
+    { NULL }
+};
+
+PyMemberDef ContextPool_members[] = {
+    { "size", T_PYSSIZET, offsetof(getdns_ContextPoolObject, size), READONLY,
+      "number of Contexts in the pool" },
+    { NULL }
+};
+
+static PySequenceMethods ContextPool_as_sequence = {
+    (lenfunc)context_pool_length,  /* sq_length */
+};
+
+
+PyTypeObject getdns_ContextPoolType = {
+#if PY_MAJOR_VERSION >= 3
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+#endif
+    "getdns.ContextPool",      /*tp_name*/
+    sizeof(getdns_ContextPoolObject), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)context_pool_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    &ContextPool_as_sequence,  /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    "A pool of identically configured Contexts, leased per call or per thread", /* tp_doc */
+    0,               /* tp_traverse */
+    0,               /* tp_clear */
+    0,               /* tp_richcompare */
+    0,               /* tp_weaklistoffset */
+    0,               /* tp_iter */
+    0,               /* tp_iternext */
+    ContextPool_methods,       /* tp_methods */
+    ContextPool_members,       /* tp_members */
+    0,               /* tp_getset */
+    0,               /* tp_base */
+    0,               /* tp_dict */
+    0,               /* tp_descr_get */
+    0,               /* tp_descr_set */
+    0,               /* tp_dictoffset */
+    0,               /* tp_init */
+    0,               /* tp_alloc */
+    context_pool_new,          /* tp_new */
+};
+
+PyMethodDef ContextLease_methods[] = {
+    { "release", (PyCFunction)LOCKED(context_lease_release), METH_NOARGS,
+      "give the Context back to the pool" },
+    { "__enter__", (PyCFunction)LOCKED(context_lease_enter), METH_NOARGS,
+      "return the leased Context" },
+    { "__exit__", (PyCFunction)LOCKED(context_lease_exit), METH_VARARGS,
+      "give the Context back to the pool" },
+    { NULL }
+};
+
+PyGetSetDef ContextLease_getset[] = {
+    { "context", (getter)LOCKED(context_lease_get_context), NULL,
+      "the leased Context, or None once it's been released", NULL },
+    { NULL }
+};
+
+
+PyTypeObject getdns_ContextLeaseType = {
+#if PY_MAJOR_VERSION >= 3
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+#endif
+    "getdns.ContextLease",     /*tp_name*/
+    sizeof(getdns_ContextLeaseObject), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)context_lease_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    "A Context leased from a ContextPool", /* tp_doc */
+    0,               /* tp_traverse */
+    0,               /* tp_clear */
+    0,               /* tp_richcompare */
+    0,               /* tp_weaklistoffset */
+    0,               /* tp_iter */
+    0,               /* tp_iternext */
+    ContextLease_methods,      /* tp_methods */
+    0,               /* tp_members */
+    ContextLease_getset,       /* tp_getset */
+};
+
+PyMethodDef Resolver_methods[] = {
+    { "submit", (PyCFunction)LOCKED(resolver_submit), METH_VARARGS|METH_KEYWORDS,
+      "queue a lookup for the workers, returning its id" },
+    { "collect", (PyCFunction)LOCKED(resolver_collect), METH_VARARGS|METH_KEYWORDS,
+      "return the lookups that have finished, waiting for one if need be" },
+    { "bulk", (PyCFunction)LOCKED(resolver_bulk), METH_VARARGS|METH_KEYWORDS,
+      "resolve a list of (name, rrtype) queries across the workers" },
+    { "fileno", (PyCFunction)resolver_fileno, METH_NOARGS,
+      "descriptor that polls readable when lookups have finished" },
+    { "close", (PyCFunction)LOCKED(resolver_close), METH_NOARGS,
+      "stop the workers, cancelling what they have outstanding" },
+    { NULL }
+};
+
+PyMemberDef Resolver_members[] = {
+    { "workers", T_PYSSIZET, offsetof(getdns_ResolverObject, n_workers), READONLY,
+      "number of worker threads" },
+    { "concurrency", T_PYSSIZET, offsetof(getdns_ResolverObject, concurrency), READONLY,
+      "queries each worker has outstanding at most" },
+    { "pending", T_PYSSIZET, offsetof(getdns_ResolverObject, pending), READONLY,
+      "queries submitted and not yet collected" },
+    { NULL }
+};
+
+
+PyTypeObject getdns_ResolverType = {
+#if PY_MAJOR_VERSION >= 3
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+#endif
+    "getdns.Resolver",         /*tp_name*/
+    sizeof(getdns_ResolverObject), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)resolver_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    "Worker threads resolving queries with Contexts of their own", /* tp_doc */
+    0,               /* tp_traverse */
+    0,               /* tp_clear */
+    0,               /* tp_richcompare */
+    0,               /* tp_weaklistoffset */
+    0,               /* tp_iter */
+    0,               /* tp_iternext */
+    Resolver_methods,          /* tp_methods */
+    Resolver_members,          /* tp_members */
+    0,               /* tp_getset */
+    0,               /* tp_base */
+    0,               /* tp_dict */
+    0,               /* tp_descr_get */
+    0,               /* tp_descr_set */
+    0,               /* tp_dictoffset */
+    0,               /* tp_init */
+    0,               /* tp_alloc */
+    resolver_new,              /* tp_new */
+};
+
+
 static PyObject *
 get_errorstr_by_id(PyObject *self, PyObject *args, PyObject *keywds)
 {
@@ -288,7 +771,7 @@ root_trust_anchor(PyObject *self, PyObject *args, PyObject *keywds)
     but = gmtime(&anchors_date);
     pdate = PyDateTime_FromDateAndTime(but->tm_year+1900, but->tm_mon+1, but->tm_mday,
                                        but->tm_hour, but->tm_min, but->tm_sec, 0);
-    ta_tuple = PyTuple_Pack(2, glist_to_plist(trust_anchors), pdate);
+    ta_tuple = PyTuple_Pack(2, glist_to_plist(trust_anchors, NULL), pdate);
     Py_INCREF(ta_tuple);
     return ta_tuple;
 }
@@ -306,23 +789,58 @@ PyInit_getdns(void)
         PyErr_SetString(PyExc_ImportError, "Unable to initialize getdns");
         return NULL;
     }
+#ifdef Py_GIL_DISABLED
+    PyUnstable_Module_SetGIL(g, Py_MOD_GIL_NOT_USED);
+#endif
     getdns_error = PyErr_NewException("getdns.error", NULL, NULL);
     Py_INCREF(getdns_error);
     PyModule_AddObject(g, "error", getdns_error);
+    if (response_keys_init() < 0 || result_records_init() < 0)  {
+        PyErr_SetString(PyExc_ImportError, "Unable to initialize getdns");
+        return NULL;
+    }
     getdns_ContextType.tp_new = PyType_GenericNew;
     getdns_ResultType.tp_new = PyType_GenericNew;
+#ifdef RESULT_VECTORCALL
+    getdns_ResultType.tp_vectorcall = result_vectorcall;
+#endif
     if (PyType_Ready(&getdns_ResultType) < 0)  {
         PyErr_SetString(PyExc_ImportError, "Unable to initialize getdns");
         return NULL;
     }
     Py_INCREF(&getdns_ResultType);
     PyModule_AddObject(g, "Result", (PyObject *)&getdns_ResultType);
+    if (PyType_Ready(&getdns_BindataType) < 0)  {
+        PyErr_SetString(PyExc_ImportError, "Unable to initialize getdns");
+        return NULL;
+    }
+    Py_INCREF(&getdns_BindataType);
+    PyModule_AddObject(g, "Bindata", (PyObject *)&getdns_BindataType);
+    if (PyType_Ready(&getdns_ExtensionsType) < 0)  {
+        PyErr_SetString(PyExc_ImportError, "Unable to initialize getdns");
+        return NULL;
+    }
+    Py_INCREF(&getdns_ExtensionsType);
+    PyModule_AddObject(g, "Extensions", (PyObject *)&getdns_ExtensionsType);
     if (PyType_Ready(&getdns_ContextType) < 0)  {
         PyErr_SetString(PyExc_ImportError, "Unable to initialize getdns");
         return NULL;
     }
     Py_INCREF(&getdns_ContextType);
     PyModule_AddObject(g, "Context", (PyObject *)&getdns_ContextType);
+    if (PyType_Ready(&getdns_ContextPoolType) < 0 ||
+        PyType_Ready(&getdns_ContextLeaseType) < 0)  {
+        PyErr_SetString(PyExc_ImportError, "Unable to initialize getdns");
+        return NULL;
+    }
+    Py_INCREF(&getdns_ContextPoolType);
+    PyModule_AddObject(g, "ContextPool", (PyObject *)&getdns_ContextPoolType);
+    if (PyType_Ready(&getdns_ResolverType) < 0)  {
+        PyErr_SetString(PyExc_ImportError, "Unable to initialize getdns");
+        return NULL;
+    }
+    Py_INCREF(&getdns_ResolverType);
+    PyModule_AddObject(g, "Resolver", (PyObject *)&getdns_ResolverType);
     PyModule_AddStringConstant(g, "__version__", PYGETDNS_VERSION);
     add_getdns_constants(g);
     return g;
@@ -342,16 +860,35 @@ initgetdns(void)
     getdns_error = PyErr_NewException("getdns.error", NULL, NULL);
     Py_INCREF(getdns_error);
     PyModule_AddObject(g, "error", getdns_error);
+    if (response_keys_init() < 0 || result_records_init() < 0)
+        return;
     getdns_ContextType.tp_new = PyType_GenericNew;
     getdns_ResultType.tp_new = PyType_GenericNew;
     if (PyType_Ready(&getdns_ResultType) < 0)  
         return;
     Py_INCREF(&getdns_ResultType);
     PyModule_AddObject(g, "Result", (PyObject *)&getdns_ResultType);
+    if (PyType_Ready(&getdns_BindataType) < 0)
+        return;
+    Py_INCREF(&getdns_BindataType);
+    PyModule_AddObject(g, "Bindata", (PyObject *)&getdns_BindataType);
+    if (PyType_Ready(&getdns_ExtensionsType) < 0)
+        return;
+    Py_INCREF(&getdns_ExtensionsType);
+    PyModule_AddObject(g, "Extensions", (PyObject *)&getdns_ExtensionsType);
     if (PyType_Ready(&getdns_ContextType) < 0)
         return;
     Py_INCREF(&getdns_ContextType);
     PyModule_AddObject(g, "Context", (PyObject *)&getdns_ContextType);
+    if (PyType_Ready(&getdns_ContextPoolType) < 0 ||
+        PyType_Ready(&getdns_ContextLeaseType) < 0)
+        return;
+    Py_INCREF(&getdns_ContextPoolType);
+    PyModule_AddObject(g, "ContextPool", (PyObject *)&getdns_ContextPoolType);
+    if (PyType_Ready(&getdns_ResolverType) < 0)
+        return;
+    Py_INCREF(&getdns_ResolverType);
+    PyModule_AddObject(g, "Resolver", (PyObject *)&getdns_ResolverType);
     PyModule_AddStringConstant(g, "__version__", PYGETDNS_VERSION);
     add_getdns_constants(g);
 }
@@ -582,4 +1119,12 @@ add_getdns_constants(PyObject *g)
     PyModule_AddIntConstant(g, "RRTYPE_CAA", 257);
     PyModule_AddIntConstant(g, "RRTYPE_TA", 32768);
     PyModule_AddIntConstant(g, "RRTYPE_DLV", 32769);
+
+/*
+ * Context.address() modes, which are ours rather than getdns's
+ */
+
+    PyModule_AddIntConstant(g, "ADDRESS_MODE_RESULT", ADDRESS_MODE_RESULT);
+    PyModule_AddIntConstant(g, "ADDRESS_MODE_PACKED", ADDRESS_MODE_PACKED);
+    PyModule_AddIntConstant(g, "ADDRESS_MODE_IPADDRESS", ADDRESS_MODE_IPADDRESS);
 }
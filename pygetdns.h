@@ -32,6 +32,8 @@
 #ifndef PYGETDNS_H
 #define PYGETDNS_H
 
+#include <pythread.h>
+
 #define PYGETDNS_VERSION "0.3.1"
 #define GETDNS_DOCSTRING "getdns bindings for Python (see http://www.getdnsapi.net)"
 
@@ -42,6 +44,41 @@
 # define UNUSED_PARAM(x) ((void)(x))
 #endif
 
+#if PY_MAJOR_VERSION < 3
+typedef long Py_hash_t;
+#endif
+
+/*
+ * Free-threaded Pythons (built with Py_GIL_DISABLED) have no GIL
+ * to keep threads out of each other's way, so what it used to
+ * cover is locked explicitly.  Each method of a Context, Result,
+ * ContextPool, ContextLease or Resolver runs in a critical section
+ * on its object (see the LOCKED_*() wrappers in getdns.c), as do
+ * callbacks into a Context from getdns or asyncio.  A critical
+ * section is let go whenever the thread would have dropped the
+ * GIL, so it can't deadlock with context_lock() or with a
+ * callback that queries the same Context.  The few module-wide
+ * tables have a PyMutex each.  With the GIL these compile away
+ */
+
+#ifdef Py_GIL_DISABLED
+#define PYGETDNS_BEGIN_LOCKED(obj) Py_BEGIN_CRITICAL_SECTION(obj)
+#define PYGETDNS_END_LOCKED() Py_END_CRITICAL_SECTION()
+#define PYGETDNS_MUTEX(name) static PyMutex name
+#define PYGETDNS_MUTEX_LOCK(m) PyMutex_Lock(&(m))
+#define PYGETDNS_MUTEX_UNLOCK(m) PyMutex_Unlock(&(m))
+#define PYGETDNS_LOAD(v) __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define PYGETDNS_STORE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#else
+#define PYGETDNS_BEGIN_LOCKED(obj) {
+#define PYGETDNS_END_LOCKED() }
+#define PYGETDNS_MUTEX(name) static int name
+#define PYGETDNS_MUTEX_LOCK(m) ((void)(m))
+#define PYGETDNS_MUTEX_UNLOCK(m) ((void)(m))
+#define PYGETDNS_LOAD(v) (v)
+#define PYGETDNS_STORE(v, x) ((v) = (x))
+#endif
+
 extern PyObject *getdns_error;
 
 typedef struct pygetdns_libevent_callback_data  {
@@ -52,6 +89,9 @@ typedef struct pygetdns_libevent_callback_data  {
 
 typedef struct  {
     PyObject_HEAD
+    struct getdns_dict *response;   /* owned unless shared; converted lazily */
+    PyObject *owner;            /* Result the response is borrowed from, if any */
+    PyObject *keeper;           /* capsule owning the response once Bindata share it */
     PyObject *just_address_answers;
     PyObject *answer_type;
     PyObject *status;
@@ -61,17 +101,84 @@ typedef struct  {
     PyObject *validation_chain;
 } getdns_ResultObject;
 
+#define RESPONSE_CAPSULE "getdns.response"
+
+/* what a synchronous Context.address() returns */
+
+#define ADDRESS_MODE_RESULT 0       /* a Result */
+#define ADDRESS_MODE_PACKED 1       /* a tuple of (family, packed address) */
+#define ADDRESS_MODE_IPADDRESS 2    /* a tuple of ipaddress objects */
+
+
+/*
+ * opaque binary data from a response, without a copy where
+ * we can help it (see bindata.c)
+ */
 
 typedef struct  {
-    PyObject *callback_func;
-    char userarg[BUFSIZ];
+    PyObject_HEAD
+    PyObject *keeper;           /* keeps data alive; NULL if data is our own copy */
+    uint8_t *data;
+    Py_ssize_t size;
+} getdns_BindataObject;
+
+
+/*
+ * query extensions, converted once and shared by every query
+ * made with them (see extensions.c)
+ */
+
+typedef struct  {
+    PyObject_HEAD
+    struct getdns_dict *extensions;
+    PyObject *items;            /* a copy of the dict they were made from */
+    PyObject *key;              /* their part of a query key */
+} getdns_ExtensionsObject;
+
+
+/*
+ * per-query state for callback-style queries.  These come out of
+ * a free-list pool (see context_util.c) rather than the heap, and
+ * go back to it once the callback has run
+ */
+
+typedef struct pygetdns_stats pygetdns_stats;
+
+/*
+ * a query that's been sampled for tracing (see context_trace.c);
+ * both are NULL otherwise
+ */
+
+typedef struct  {
+    PyObject *hook;
+    PyObject *name;
+} query_trace;
+
+typedef struct userarg_blob  {
+    PyObject *callback_func;        /* owned */
+    PyObject *userarg;              /* owned; may be NULL */
+    struct getdns_ContextObject *owner; /* not a reference */
+    int batch;                      /* owner->batch_callbacks when submitted */
+    pygetdns_stats *stats;          /* the querying context's */
+    uint64_t started;               /* see context_stats_submit() */
+    uint16_t request_type;
+    query_trace trace;
+    struct userarg_blob *next;      /* free-list link */
 } userarg_blob;
 
 
+typedef struct pygetdns_asyncio_loop pygetdns_asyncio_loop;
+typedef struct pygetdns_selector_loop pygetdns_selector_loop;
+typedef struct pygetdns_resolver_worker pygetdns_resolver_worker;
+typedef struct pygetdns_resolver_queue pygetdns_resolver_queue;
+typedef struct pygetdns_cache pygetdns_cache;
+
 
-typedef struct {
+
+typedef struct getdns_ContextObject  {
     PyObject_HEAD
     PyObject *py_context;       /* Python capsule containing getdns_context */
+    /* settings, mirrored from getdns by context_update_settings() */
     uint64_t  timeout;          /* timeout attribute (milliseconds) */
     uint64_t  idle_timeout;     /* TCP timeout attribute (milliseconds) */
     getdns_resolution_t resolution_type; /* stub or recursive? */
@@ -81,39 +188,234 @@ typedef struct {
     uint16_t limit_outstanding_queries;
     getdns_redirects_t follow_redirects;
     getdns_append_name_t append_name;
-    getdns_list *suffix;
+    PyObject *suffix;
     uint32_t dnssec_allowed_skew;
     uint16_t edns_maximum_udp_payload_size;
     uint8_t edns_extended_rcode;
     uint8_t edns_do_bit;
     uint8_t edns_version;
-    getdns_namespace_t *namespaces;
-    getdns_list *dns_root_servers;
-    getdns_list *dnssec_trust_anchors;
-    getdns_list *upstream_recursive_servers;
-    getdns_transport_list_t *dns_transport_list;
+    PyObject *namespaces;
+    PyObject *dns_root_servers;
+    PyObject *dnssec_trust_anchors;
+    PyObject *upstream_recursive_servers;
+    PyObject *dns_transport_list;
     struct event_base *event_base;
+    pygetdns_asyncio_loop *asyncio_loop; /* set while driven by asyncio */
+    pygetdns_selector_loop *selector; /* set once fileno() has been called */
+    char batch_callbacks;       /* deliver callbacks a loop turn at a time */
+    int batching;               /* in a loop turn; see context_batch_flush() */
+    PyObject *batch;            /* (callback, entry) pairs awaiting delivery */
+    pygetdns_cache *cache;      /* response cache; NULL when disabled */
+    Py_ssize_t cache_size;      /* maximum number of cached responses */
+    PyObject *inflight;         /* outstanding queries by key, see context_flight.c */
+    unsigned long queries_issued;
+    unsigned long queries_coalesced;
+    pygetdns_stats *stats;      /* see context_stats.c */
+    PyObject *trace_hook;       /* see context_trace.c */
+    double trace_sample;
+    uint64_t trace_random;
     char *implementation_string;
     char *version_string;
+    PyThread_type_lock lock;    /* serializes use of the getdns_context */
+    long lock_owner;            /* thread ident of the lock holder */
+    int  lock_depth;            /* recursion count for lock_owner */
+    char pooled;                /* in a ContextPool's free list, or retired */
+    unsigned long settings_changes; /* see pool_give() */
 } getdns_ContextObject;
 
 
+/*
+ * an outstanding query that identical queries can wait on,
+ * kept in a capsule
+ */
+
+typedef struct  {
+    getdns_ContextObject *owner;    /* not a reference */
+    PyObject *key;                  /* NULL if it can't be shared */
+    PyObject *waiters;              /* futures, for *_async() queries */
+    PyThread_type_lock done;        /* held until a synchronous query is done */
+    PyObject *result;
+    getdns_return_t ret;
+    getdns_transaction_t tid;
+    uint64_t started;
+    uint16_t request_type;
+    query_trace trace;
+    int pending;
+} query_flight;
+
+#define FLIGHT_CAPSULE "getdns.flight"
+#define FLIGHT(capsule) ((query_flight *)PyCapsule_GetPointer((capsule), FLIGHT_CAPSULE))
+
+
+/*
+ * a pool of identically configured Contexts (see context_pool.c)
+ */
+
+typedef struct getdns_ContextPoolObject  {
+    PyObject_HEAD
+    PyObject **contexts;        /* all of them, for dealloc */
+    PyObject **free;            /* a stack of those not leased */
+    PyObject *settings;         /* for replacements; NULL for the defaults */
+    Py_ssize_t size;
+    Py_ssize_t n_contexts;
+    Py_ssize_t n_free;
+    PyThread_type_lock available; /* released when a waiter can go */
+    int waiters;
+    int signalled;
+    PyObject *local;            /* threading.local, for thread_context() */
+    Py_ssize_t leased;
+    Py_ssize_t peak_leased;
+    uint64_t leases;
+    uint64_t waits;
+    uint64_t timeouts;
+    uint64_t wait_usec;
+    uint64_t wait_max_usec;
+    uint64_t created;           /* context_stats_now() times */
+    uint64_t changed;
+    double busy_ns;             /* integral of leased over time */
+} getdns_ContextPoolObject;
+
+typedef struct  {
+    PyObject_HEAD
+    getdns_ContextPoolObject *pool;
+    PyObject *context;          /* NULL once released */
+} getdns_ContextLeaseObject;
+
+/*
+ * a set of worker threads, each resolving with its own Context
+ * (see resolver.c)
+ */
+
+typedef struct  {
+    PyObject_HEAD
+    pygetdns_resolver_worker *workers;
+    Py_ssize_t n_workers;
+    Py_ssize_t next_worker;     /* round robin */
+    Py_ssize_t concurrency;     /* per worker */
+    pygetdns_resolver_queue *done;  /* finished queries, for Python */
+    PyThread_type_lock consumer;    /* held by whoever's reading it */
+    PyObject *ready;            /* finished, for collect() */
+    Py_ssize_t pending;         /* submitted and not yet read back */
+    uint64_t next_id;
+    int closed;
+} getdns_ResolverObject;
+
+
+/*
+ * argument parsing for the query methods (see context_args.c)
+ */
+
+#if PY_VERSION_HEX >= 0x03070000
+#define QUERY_FASTCALL 1
+#endif
+
+#define QUERY_MAX_ARGS 8
+
+typedef struct  {
+    const char *format;         /* as for PyArg_ParseTupleAndKeywords() */
+    char **names;
+    PyObject *keys[QUERY_MAX_ARGS]; /* names, interned on first use */
+    int n_args;
+    int n_required;
+} query_arg_parser;
+
+#ifdef QUERY_FASTCALL
+#define QUERY_ARGS PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames
+#define QUERY_METH_FLAGS (METH_FASTCALL|METH_KEYWORDS)
+#define QUERY_PARSE(parser, ...) query_args_parse(&(parser), args, nargs, kwnames, __VA_ARGS__)
+int query_args_parse(query_arg_parser *parser, PyObject *const *args, Py_ssize_t nargs,
+                     PyObject *kwnames, ...);
+#else
+#define QUERY_ARGS PyObject *args, PyObject *keywds
+#define QUERY_METH_FLAGS (METH_VARARGS|METH_KEYWORDS)
+#define QUERY_PARSE(parser, ...) \
+    PyArg_ParseTupleAndKeywords(args, keywds, (parser).format, (parser).names, __VA_ARGS__)
+#endif
+
+
 extern PyTypeObject getdns_ResultType;
 void result_dealloc(getdns_ResultObject *self);
-extern PyObject *result_getattro(PyObject *self, PyObject *nameobj);
-PyObject *py_result(PyObject *result_capsule);
 PyObject *result_create(struct getdns_dict *resp);
+#if PY_VERSION_HEX >= 0x03090000
+#define RESULT_VECTORCALL 1
+PyObject *result_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf,
+                            PyObject *kwnames);
+#endif
+PyObject *result_share(PyObject *origin);
 PyObject *result_str(PyObject *self);
+PyObject *result_get_just_address_answers(getdns_ResultObject *self, void *closure);
+PyObject *result_get_answer_type(getdns_ResultObject *self, void *closure);
+PyObject *result_get_status(getdns_ResultObject *self, void *closure);
+PyObject *result_get_replies_tree(getdns_ResultObject *self, void *closure);
+PyObject *result_get_canonical_name(getdns_ResultObject *self, void *closure);
+PyObject *result_get_replies_full(getdns_ResultObject *self, void *closure);
+PyObject *result_get_validation_chain(getdns_ResultObject *self, void *closure);
+PyObject *result_get_wire(getdns_ResultObject *self, void *closure);
+PyObject *result_get_wires(getdns_ResultObject *self, void *closure);
+int result_getbuffer(getdns_ResultObject *self, Py_buffer *view, int flags);
+PyObject *result_keeper(PyObject *result);
+int result_records_init(void);
+PyObject *result_records(getdns_ResultObject *self, PyObject *args, PyObject *keywds);
+
+extern PyTypeObject getdns_BindataType;
+PyObject *bindata_create(getdns_bindata *data, PyObject *keeper);
+void bindata_dealloc(getdns_BindataObject *self);
+int bindata_getbuffer(getdns_BindataObject *self, Py_buffer *view, int flags);
+Py_ssize_t bindata_length(getdns_BindataObject *self);
+PyObject *bindata_item(getdns_BindataObject *self, Py_ssize_t i);
+PyObject *bindata_tobytes(getdns_BindataObject *self, PyObject *unused);
+PyObject *bindata_hex(getdns_BindataObject *self, PyObject *unused);
+PyObject *bindata_richcompare(PyObject *self, PyObject *other, int op);
+Py_hash_t bindata_hash(getdns_BindataObject *self);
+PyObject *bindata_repr(getdns_BindataObject *self);
+
+extern PyTypeObject getdns_ExtensionsType;
+PyObject *extensions_new(PyTypeObject *type, PyObject *args, PyObject *keywds);
+void extensions_dealloc(getdns_ExtensionsObject *self);
+Py_ssize_t extensions_length(getdns_ExtensionsObject *self);
+PyObject *extensions_subscript(getdns_ExtensionsObject *self, PyObject *key);
+PyObject *extensions_repr(getdns_ExtensionsObject *self);
+PyObject *extensions_key(PyObject *extensions);
+int extensions_get(PyObject *obj, struct getdns_dict **dict);
+void extensions_put(PyObject *obj, struct getdns_dict *dict);
+
+extern PyTypeObject getdns_ContextPoolType;
+extern PyTypeObject getdns_ContextLeaseType;
+PyObject *context_pool_new(PyTypeObject *type, PyObject *args, PyObject *keywds);
+void context_pool_dealloc(getdns_ContextPoolObject *self);
+PyObject *context_pool_lease(getdns_ContextPoolObject *self, PyObject *args, PyObject *keywds);
+PyObject *context_pool_thread_context(getdns_ContextPoolObject *self, PyObject *unused);
+PyObject *context_pool_stats(getdns_ContextPoolObject *self, PyObject *args, PyObject *keywds);
+Py_ssize_t context_pool_length(getdns_ContextPoolObject *self);
+PyObject *context_lease_release(getdns_ContextLeaseObject *self, PyObject *unused);
+PyObject *context_lease_enter(getdns_ContextLeaseObject *self, PyObject *unused);
+PyObject *context_lease_exit(getdns_ContextLeaseObject *self, PyObject *args);
+PyObject *context_lease_get_context(getdns_ContextLeaseObject *self, void *closure);
+void context_lease_dealloc(getdns_ContextLeaseObject *self);
+
+PyObject *context_new_configured(PyObject *settings);
+
+extern PyTypeObject getdns_ResolverType;
+PyObject *resolver_new(PyTypeObject *type, PyObject *args, PyObject *keywds);
+void resolver_dealloc(getdns_ResolverObject *self);
+PyObject *resolver_submit(getdns_ResolverObject *self, PyObject *args, PyObject *keywds);
+PyObject *resolver_collect(getdns_ResolverObject *self, PyObject *args, PyObject *keywds);
+PyObject *resolver_bulk(getdns_ResolverObject *self, PyObject *args, PyObject *keywds);
+PyObject *resolver_fileno(getdns_ResolverObject *self, PyObject *unused);
+PyObject *resolver_close(getdns_ResolverObject *self, PyObject *unused);
 
 int get_status(struct getdns_dict *result_dict);
 int get_answer_type(struct getdns_dict *result_dict);
 char *get_canonical_name(struct getdns_dict *result_dict);
 PyObject *get_just_address_answers(struct getdns_dict *result_dict);
-PyObject *get_replies_tree(struct getdns_dict *result_dict);
-PyObject *get_validation_chain(struct getdns_dict *result_dict);
+PyObject *get_replies_tree(struct getdns_dict *result_dict, PyObject *owner);
+PyObject *get_validation_chain(struct getdns_dict *result_dict, PyObject *owner);
+PyObject *get_address_tuple(struct getdns_dict *result_dict, int mode);
 
+extern PyTypeObject getdns_ContextType;
 int context_init(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
-PyObject *context_getattro(PyObject *self, PyObject *nameobj);
+int context_update_settings(getdns_ContextObject *self, getdns_context *context);
+PyObject *context_get_list_setting(getdns_ContextObject *self, void *closure);
 int context_setattro(PyObject *self, PyObject *attrname, PyObject *value);
 int context_set_timeout(getdns_context *context, PyObject *py_value);
 int context_set_resolution_type(getdns_context *context, PyObject *py_value);
@@ -135,31 +437,96 @@ int context_set_dns_transport_list(getdns_context *context, PyObject *py_value);
 PyObject *context_str(PyObject *self);
 
 PyObject *context_get_api_information(getdns_ContextObject *self, PyObject *unused);
-PyObject *context_general(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
-PyObject *context_address(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
-PyObject *context_hostname(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
-PyObject *context_service(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+PyObject *context_general(getdns_ContextObject *self, QUERY_ARGS);
+PyObject *context_address(getdns_ContextObject *self, QUERY_ARGS);
+PyObject *context_hostname(getdns_ContextObject *self, QUERY_ARGS);
+PyObject *context_service(getdns_ContextObject *self, QUERY_ARGS);
 PyObject *context_run(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+PyObject *context_run_once(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+PyObject *context_process_events(getdns_ContextObject *self, PyObject *unused);
+int context_attach_selector(getdns_ContextObject *self, getdns_context *context);
+int context_selector_step(getdns_ContextObject *self, int64_t wait_ns);
+PyObject *context_fileno(getdns_ContextObject *self, PyObject *unused);
+PyObject *context_next_timeout(getdns_ContextObject *self, PyObject *unused);
 PyObject *context_cancel_callback(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+PyObject *context_bulk(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+int context_set_cache_size(getdns_ContextObject *self, PyObject *py_value);
+PyObject *context_query_key(char *method, char *name, uint16_t request_type, PyObject *extensions);
+PyObject *context_cache_lookup(getdns_ContextObject *self, PyObject *key);
+PyObject *context_cache_insert(getdns_ContextObject *self, PyObject *key, PyObject *result);
+PyObject *context_cache_info(getdns_ContextObject *self, PyObject *unused);
+PyObject *context_cache_clear(getdns_ContextObject *self, PyObject *unused);
+void context_cache_flush(getdns_ContextObject *self);
+PyObject *context_flight_find(getdns_ContextObject *self, PyObject *key);
+PyObject *context_flight_new(getdns_ContextObject *self, PyObject *key, int sync);
+void context_flight_land(getdns_ContextObject *self, PyObject *capsule);
+int context_flight_sync_begin(getdns_ContextObject *self, PyObject *key,
+                              PyObject **flight, PyObject **result);
+void context_flight_sync_end(getdns_ContextObject *self, PyObject *flight,
+                             getdns_return_t ret, PyObject *result);
+PyObject *context_coalesce_info(getdns_ContextObject *self, PyObject *unused);
+void context_cache_reset(getdns_ContextObject *self);
+void context_cache_free(getdns_ContextObject *self);
+uint64_t context_stats_now(void);
+uint64_t context_stats_deadline(double seconds);
+pygetdns_stats *context_stats_new(void);
+void context_stats_clear(pygetdns_stats *stats);
+void context_stats_free(pygetdns_stats *stats);
+uint64_t context_stats_submit(pygetdns_stats *stats);
+void context_stats_returned(pygetdns_stats *stats);
+void context_stats_done(pygetdns_stats *stats, uint16_t request_type, uint64_t started,
+                        uint64_t finished, getdns_callback_type_t type, getdns_dict *response);
+void context_stats_record(pygetdns_stats *stats, uint16_t request_type, uint64_t started,
+                          uint64_t finished, getdns_callback_type_t type, getdns_dict *response);
+void context_stats_batch(pygetdns_stats *stats, uint64_t n);
+PyObject *context_stats(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+int context_set_trace_hook(getdns_ContextObject *self, PyObject *py_value);
+int context_set_trace_sample(getdns_ContextObject *self, PyObject *py_value);
+void context_trace_begin(getdns_ContextObject *self, char *name, PyObject *name_obj,
+                         query_trace *trace);
+void context_trace_end(query_trace *trace, getdns_transaction_t *tid, uint16_t request_type,
+                       uint64_t t_submit, uint64_t t_complete,
+                       uint64_t t_callback_start, uint64_t t_callback_end,
+                       getdns_callback_type_t type, getdns_dict *response);
+void context_sync_done(getdns_ContextObject *self, query_trace *trace, uint16_t request_type,
+                       uint64_t started, getdns_return_t ret, getdns_dict *response);
+int context_attach_libevent(getdns_ContextObject *self, getdns_context *context);
+#if PY_MAJOR_VERSION >= 3
+PyObject *context_general_async(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+PyObject *context_address_async(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+PyObject *context_hostname_async(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+PyObject *context_service_async(getdns_ContextObject *self, PyObject *args, PyObject *keywds);
+#endif
 
 void context_dealloc(getdns_ContextObject *self);
+getdns_context *context_get(getdns_ContextObject *self);
+void context_lock(getdns_ContextObject *self);
+void context_unlock(getdns_ContextObject *self);
 PyObject *get_callback(char *py_main, char *callback);
+userarg_blob *userarg_blob_new(getdns_ContextObject *self, PyObject *callback_func,
+                               PyObject *userarg, uint16_t request_type);
+void userarg_blob_release(userarg_blob *blob);
+void context_batch_flush(getdns_ContextObject *self);
 void callback_shim(struct getdns_context *context, getdns_callback_type_t type,
                    struct getdns_dict *response, void *userarg, getdns_transaction_t tid);
 
 int result_init(getdns_ResultObject *self, PyObject *args, PyObject *keywds);
-PyObject *result_getattro(PyObject *self, PyObject *nameobj);
-int result_setattro(PyObject *self, PyObject *attrname, PyObject *value);
 
 PyObject *pythonify_address_list(getdns_list *list);
-PyObject *glist_to_plist(struct getdns_list *list);
-PyObject *gdict_to_pdict(struct getdns_dict *dict);
-PyObject *convertBinData(getdns_bindata* data, const char* key);
+int response_keys_init(void);
+PyObject *response_key(const char *name);
+PyObject *glist_to_plist(struct getdns_list *list, PyObject *owner);
+PyObject *gdict_to_pdict(struct getdns_dict *dict, PyObject *owner);
+struct getdns_dict *pdict_to_gdict(PyObject *pydict);
+struct getdns_list *plist_to_glist(PyObject *pylist);
+PyObject *convertBinData(getdns_bindata* data, const char* key, PyObject *owner);
 struct getdns_dict *extensions_to_getdnsdict(PyDictObject *);
 PyObject *decode_getdns_response(struct getdns_dict *);
 PyObject *decode_getdns_replies_tree_response(struct getdns_dict *response);
 PyObject *getFullResponse(struct getdns_dict *dict);
 getdns_dict *getdnsify_addressdict(PyObject *pydict);
 
+PyObject *bench_converter(PyObject *self, PyObject *args, PyObject *keywds);
+
 
 #endif /* PYGETDNS_H */
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <Python.h>
+#include <time.h>
+#include <getdns/getdns.h>
+#include "pygetdns.h"
+
+/*
+ * getdns._bench_converter() times the getdns-to-Python converters
+ * (gdict_to_pdict(), glist_to_plist() and convertBinData()) in
+ * isolation, so that changes to them can be measured without a
+ * resolver or a network in the way.  It's driven by
+ * benchmarks/convert-bench.py and isn't part of the API.
+ *
+ * Allocations are counted by wrapping the Python memory and object
+ * allocators for the duration of the run, so anything getdns itself
+ * allocates (or that goes straight to malloc()) isn't included
+ */
+
+#if PY_VERSION_HEX >= 0x03050000
+#define BENCH_COUNT_ALLOCS 1
+#endif
+
+#define BENCH_MAX_BINDATA 4096
+
+typedef struct  {
+    getdns_bindata *items[BENCH_MAX_BINDATA];
+    size_t n_items;
+} bench_bindata;
+
+
+#ifdef BENCH_COUNT_ALLOCS
+
+static size_t bench_allocs;
+static PyMemAllocatorEx bench_mem_orig;
+static PyMemAllocatorEx bench_obj_orig;
+
+
+static void *
+bench_malloc(void *ctx, size_t size)
+{
+    PyMemAllocatorEx *orig = (PyMemAllocatorEx *)ctx;
+
+    bench_allocs++;
+    return orig->malloc(orig->ctx, size);
+}
+
+
+static void *
+bench_calloc(void *ctx, size_t nelem, size_t elsize)
+{
+    PyMemAllocatorEx *orig = (PyMemAllocatorEx *)ctx;
+
+    bench_allocs++;
+    return orig->calloc(orig->ctx, nelem, elsize);
+}
+
+
+static void *
+bench_realloc(void *ctx, void *ptr, size_t new_size)
+{
+    PyMemAllocatorEx *orig = (PyMemAllocatorEx *)ctx;
+
+    if (ptr == NULL)
+        bench_allocs++;
+    return orig->realloc(orig->ctx, ptr, new_size);
+}
+
+
+static void
+bench_free(void *ctx, void *ptr)
+{
+    PyMemAllocatorEx *orig = (PyMemAllocatorEx *)ctx;
+
+    orig->free(orig->ctx, ptr);
+}
+
+
+static void
+bench_count_allocs(int on)
+{
+    PyMemAllocatorEx mem = { &bench_mem_orig, bench_malloc, bench_calloc,
+                             bench_realloc, bench_free };
+    PyMemAllocatorEx obj = { &bench_obj_orig, bench_malloc, bench_calloc,
+                             bench_realloc, bench_free };
+
+    if (on)  {
+        PyMem_GetAllocator(PYMEM_DOMAIN_MEM, &bench_mem_orig);
+        PyMem_GetAllocator(PYMEM_DOMAIN_OBJ, &bench_obj_orig);
+        PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &mem);
+        PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &obj);
+    }  else  {
+        PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &bench_mem_orig);
+        PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &bench_obj_orig);
+    }
+}
+
+#endif
+
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/*
+ * gather every bindata leaf under a dict or list, which is what
+ * convertBinData() gets called on during a full conversion
+ */
+
+static void bench_walk_list(getdns_list *list, bench_bindata *found);
+
+static void
+bench_walk_dict(getdns_dict *dict, bench_bindata *found)
+{
+    getdns_list *keys;
+    getdns_bindata *key;
+    getdns_data_type type;
+    getdns_dict *dict_item;
+    getdns_list *list_item;
+    getdns_bindata *bindata_item;
+    size_t n_keys;
+    size_t i;
+
+    if (getdns_dict_get_names(dict, &keys) != GETDNS_RETURN_GOOD)
+        return;
+    (void)getdns_list_get_length(keys, &n_keys);
+    for (i = 0 ; i < n_keys ; i++)  {
+        if (getdns_list_get_bindata(keys, i, &key) != GETDNS_RETURN_GOOD ||
+            getdns_dict_get_data_type(dict, (char *)key->data, &type) != GETDNS_RETURN_GOOD)
+            continue;
+        switch (type)  {
+        case t_dict:
+            if (getdns_dict_get_dict(dict, (char *)key->data, &dict_item) == GETDNS_RETURN_GOOD)
+                bench_walk_dict(dict_item, found);
+            break;
+        case t_list:
+            if (getdns_dict_get_list(dict, (char *)key->data, &list_item) == GETDNS_RETURN_GOOD)
+                bench_walk_list(list_item, found);
+            break;
+        case t_bindata:
+            if (getdns_dict_get_bindata(dict, (char *)key->data, &bindata_item) ==
+                GETDNS_RETURN_GOOD && found->n_items < BENCH_MAX_BINDATA)
+                found->items[found->n_items++] = bindata_item;
+            break;
+        default:
+            break;
+        }
+    }
+    getdns_list_destroy(keys);
+}
+
+
+static void
+bench_walk_list(getdns_list *list, bench_bindata *found)
+{
+    getdns_data_type type;
+    getdns_dict *dict_item;
+    getdns_list *list_item;
+    getdns_bindata *bindata_item;
+    size_t length;
+    size_t i;
+
+    (void)getdns_list_get_length(list, &length);
+    for (i = 0 ; i < length ; i++)  {
+        if (getdns_list_get_data_type(list, i, &type) != GETDNS_RETURN_GOOD)
+            continue;
+        switch (type)  {
+        case t_dict:
+            if (getdns_list_get_dict(list, i, &dict_item) == GETDNS_RETURN_GOOD)
+                bench_walk_dict(dict_item, found);
+            break;
+        case t_list:
+            if (getdns_list_get_list(list, i, &list_item) == GETDNS_RETURN_GOOD)
+                bench_walk_list(list_item, found);
+            break;
+        case t_bindata:
+            if (getdns_list_get_bindata(list, i, &bindata_item) == GETDNS_RETURN_GOOD &&
+                found->n_items < BENCH_MAX_BINDATA)
+                found->items[found->n_items++] = bindata_item;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+
+/*
+ * one pass of the chosen converter.  Returns the number of
+ * conversions made, or -1 with an exception set
+ */
+
+static long
+bench_pass(const char *converter, PyObject *owner, getdns_dict *response,
+           getdns_list *replies_tree, bench_bindata *leaves)
+{
+    PyObject *converted;
+    size_t i;
+
+    if (!strcmp(converter, "gdict_to_pdict"))  {
+        if ((converted = gdict_to_pdict(response, owner)) == NULL)
+            return -1;
+        Py_DECREF(converted);
+        return 1;
+    }
+    if (!strcmp(converter, "glist_to_plist"))  {
+        if ((converted = glist_to_plist(replies_tree, owner)) == NULL)
+            return -1;
+        Py_DECREF(converted);
+        return 1;
+    }
+    for (i = 0 ; i < leaves->n_items ; i++)  {
+        if ((converted = convertBinData(leaves->items[i], "", owner)) == NULL)
+            return -1;
+        Py_DECREF(converted);
+    }
+    return (long)leaves->n_items;
+}
+
+
+PyObject *
+bench_converter(PyObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "converter",
+        "response",
+        "iterations",
+        0
+    };
+    char *converter;
+    PyObject *response_obj;
+    long iterations = 1000;
+    getdns_dict *response;
+    PyObject *owner;
+    getdns_list *replies_tree = 0;
+    bench_bindata *leaves = 0;
+    uint64_t start;
+    uint64_t elapsed;
+    size_t allocs = 0;
+    long ops = 0;
+    long n;
+    long i;
+    PyObject *report = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "sO|l", kwlist,
+                                     &converter, &response_obj, &iterations))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if ((strcmp(converter, "gdict_to_pdict") && strcmp(converter, "glist_to_plist") &&
+         strcmp(converter, "convertBinData")) || iterations < 1)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if ((response = pdict_to_gdict(response_obj)) == NULL)
+        return NULL;
+    if ((owner = result_create(response)) == NULL)  {   /* converted as a Result would be */
+        getdns_dict_destroy(response);
+        return NULL;
+    }
+    if (!strcmp(converter, "glist_to_plist") &&
+        getdns_dict_get_list(response, "replies_tree", &replies_tree) != GETDNS_RETURN_GOOD)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_NO_SUCH_DICT_NAME_TEXT);
+        goto done;
+    }
+    if (!strcmp(converter, "convertBinData"))  {
+        if ((leaves = (bench_bindata *)PyMem_Malloc(sizeof(bench_bindata))) == NULL)  {
+            PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+            goto done;
+        }
+        leaves->n_items = 0;
+        bench_walk_dict(response, leaves);
+    }
+
+    if (bench_pass(converter, owner, response, replies_tree, leaves) < 0)  /* warm up */
+        goto done;
+#ifdef BENCH_COUNT_ALLOCS
+    bench_allocs = 0;
+    bench_count_allocs(1);
+#endif
+    start = bench_now_ns();
+    for (i = 0 ; i < iterations ; i++)  {
+        if ((n = bench_pass(converter, owner, response, replies_tree, leaves)) < 0)
+            break;
+        ops += n;
+    }
+    elapsed = bench_now_ns() - start;
+#ifdef BENCH_COUNT_ALLOCS
+    bench_count_allocs(0);
+    allocs = bench_allocs;
+#endif
+    if (i < iterations)
+        goto done;
+
+#ifdef BENCH_COUNT_ALLOCS
+    report = Py_BuildValue("{s:K,s:l,s:n}", "ns", (unsigned long long)elapsed,
+                           "ops", ops, "allocs", (Py_ssize_t)allocs);
+#else
+    report = Py_BuildValue("{s:K,s:l,s:O}", "ns", (unsigned long long)elapsed,
+                           "ops", ops, "allocs", Py_None);
+    (void)allocs;
+#endif
+
+done:
+    PyMem_Free(leaves);
+    Py_DECREF(owner);
+    return report;
+}
@@ -96,8 +96,94 @@ get_just_address_answers(struct getdns_dict *result_dict)
 }
 
 
+/*
+ * just_address_answers without the dicts, for Context.address()
+ * in ADDRESS_MODE_PACKED and ADDRESS_MODE_IPADDRESS: a tuple
+ * of (family, packed address) pairs, or of ipaddress objects,
+ * made straight from each entry's address_data.  A name that
+ * doesn't exist has no addresses; any other unsuccessful status
+ * (a timeout, say) is an error, so it can't be mistaken for one.
+ * ipaddress.ip_address is looked up the first time it's needed;
+ * threads that race to do it all import, and the first to take
+ * the mutex keeps its copy
+ */
+
+PYGETDNS_MUTEX(ip_address_mutex);
+
 PyObject *
-get_replies_tree(struct getdns_dict *result_dict)
+get_address_tuple(struct getdns_dict *result_dict, int mode)
+{
+    static PyObject *ip_address_func = 0;
+    PyObject *ip_address = 0;
+    PyObject *spare = 0;
+    struct getdns_list *answers;
+    struct getdns_dict *answer;
+    getdns_bindata *address;
+    size_t length = 0;
+    size_t i;
+    Py_ssize_t n = 0;
+    PyObject *addresses;
+    PyObject *packed;
+    PyObject *item;
+    int status;
+
+    if ((status = get_status(result_dict)) != GETDNS_RESPSTATUS_GOOD &&
+        status != GETDNS_RESPSTATUS_NO_NAME)  {
+        PyErr_Format(getdns_error, "address lookup failed with status %d", status);
+        return NULL;
+    }
+    if (mode == ADDRESS_MODE_IPADDRESS && (ip_address = PYGETDNS_LOAD(ip_address_func)) == NULL)  {
+        PyObject *module;
+
+        if ((module = PyImport_ImportModule("ipaddress")) == NULL)
+            return NULL;
+        ip_address = PyObject_GetAttrString(module, "ip_address");
+        Py_DECREF(module);
+        if (ip_address == NULL)
+            return NULL;
+        PYGETDNS_MUTEX_LOCK(ip_address_mutex);
+        if (ip_address_func == NULL)
+            PYGETDNS_STORE(ip_address_func, ip_address);
+        else  {
+            spare = ip_address;
+            ip_address = ip_address_func;
+        }
+        PYGETDNS_MUTEX_UNLOCK(ip_address_mutex);
+        Py_XDECREF(spare);
+    }
+    if (getdns_dict_get_list(result_dict, "just_address_answers", &answers) == GETDNS_RETURN_GOOD)
+        (void)getdns_list_get_length(answers, &length);
+    if ((addresses = PyTuple_New((Py_ssize_t)length)) == NULL)
+        return NULL;
+    for (i = 0 ; i < length ; i++)  {
+        if (getdns_list_get_dict(answers, i, &answer) != GETDNS_RETURN_GOOD ||
+            getdns_dict_get_bindata(answer, "address_data", &address) != GETDNS_RETURN_GOOD ||
+            (address->size != 4 && address->size != 16))
+            continue;
+        if ((packed = PyBytes_FromStringAndSize((char *)address->data,
+                                                (Py_ssize_t)address->size)) == NULL)
+            goto error;
+        if (mode == ADDRESS_MODE_IPADDRESS)  {
+            item = PyObject_CallFunctionObjArgs(ip_address, packed, NULL);
+            Py_DECREF(packed);
+        }  else
+            item = Py_BuildValue("(iN)", address->size == 4 ? AF_INET : AF_INET6, packed);
+        if (item == NULL)
+            goto error;
+        PyTuple_SET_ITEM(addresses, n++, item);
+    }
+    if (n < (Py_ssize_t)length && _PyTuple_Resize(&addresses, n) < 0)
+        return NULL;
+    return addresses;
+
+error:
+    Py_DECREF(addresses);
+    return NULL;
+}
+
+
+PyObject *
+get_replies_tree(struct getdns_dict *result_dict, PyObject *owner)
 {
     struct getdns_list *replies_tree;
     getdns_return_t ret;
@@ -105,12 +191,12 @@ get_replies_tree(struct getdns_dict *result_dict)
     if ((ret = getdns_dict_get_list(result_dict, "replies_tree", &replies_tree)) !=
         GETDNS_RETURN_GOOD)
         return NULL;
-    return glist_to_plist(replies_tree);
+    return glist_to_plist(replies_tree, owner);
 }
 
 
 PyObject *
-get_validation_chain(struct getdns_dict *result_dict)
+get_validation_chain(struct getdns_dict *result_dict, PyObject *owner)
 {
     struct getdns_list *validation_chain;
     getdns_return_t ret;
@@ -119,7 +205,7 @@ get_validation_chain(struct getdns_dict *result_dict)
         GETDNS_RETURN_GOOD)
         Py_RETURN_NONE;
     else
-        return glist_to_plist(validation_chain);
+        return glist_to_plist(validation_chain, owner);
 }
 
 
@@ -336,6 +422,8 @@ getdnsify_addressdict(PyObject *pydict)
     getdns_bindata addr_data;
     getdns_bindata addr_type;
     PyObject *str;
+    PyObject *py_port;
+    long port = -1;
     unsigned char buf[sizeof(struct in6_addr)];
     int domain;
 
@@ -344,7 +432,19 @@ getdnsify_addressdict(PyObject *pydict)
         PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
         return NULL;
     }
-    if (PyDict_Size(pydict) != 2)  {
+    if ((py_port = PyDict_GetItemString(pydict, "port")) != NULL)  {
+#if PY_MAJOR_VERSION >= 3
+        port = PyLong_Check(py_port) ? PyLong_AsLong(py_port) : -1;
+#else
+        port = (PyInt_Check(py_port) || PyLong_Check(py_port)) ? PyInt_AsLong(py_port) : -1;
+#endif
+        if (port < 0 || port > 65535)  {
+            PyErr_Clear();
+            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+            return NULL;
+        }
+    }
+    if (PyDict_Size(pydict) != (py_port ? 3 : 2))  {
         PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
         return NULL;
     }
@@ -404,6 +504,8 @@ getdnsify_addressdict(PyObject *pydict)
     addr_data.data = (uint8_t *)buf;
     addr_data.size = (domain == AF_INET ? 4 : 16);
     getdns_dict_set_bindata(addr_dict, "address_data", &addr_data);
+    if (port >= 0)
+        getdns_dict_set_int(addr_dict, "port", (uint32_t)port);
     return addr_dict;
 }
 
@@ -482,8 +584,199 @@ pythonify_address_list(getdns_list *list)
 
 
 
+/*
+ * Dict keys for converted responses.  Every RR has a "name",
+ * "type", "class", "ttl" and "rdata", so rather than making and
+ * hashing a new string for each one, the converters take their
+ * keys from a table of interned strings.  The table is filled
+ * with the names in the getdns response schema at import, and
+ * picks up any other names it's asked for, up to KEY_TABLE_MAX
+ * of them; past that, keys are made afresh.  Slots are filled
+ * but never emptied, so lookups don't lock; names are added with
+ * the GIL held, or with key_table_mutex where there isn't one
+ */
+
+#define KEY_TABLE_SIZE 1024     /* slots, a power of 2 */
+#define KEY_TABLE_MAX (KEY_TABLE_SIZE / 2)
+
+typedef struct  {
+    char *name;
+    PyObject *key;
+} response_key_slot;
+
+static response_key_slot key_table[KEY_TABLE_SIZE];
+static int key_table_used;
+PYGETDNS_MUTEX(key_table_mutex);
+
+static const char *schema_keys[] = {
+    /* the response dict */
+    "status", "answer_type", "canonical_name", "just_address_answers",
+    "intermediate_aliases", "replies_full", "replies_tree", "validation_chain",
+    "address_type", "address_data", "srv_addresses", "domain_name", "port",
+    "priority", "weight", "call_reporting", "run_time/ms", "transport",
+    /* each reply */
+    "header", "question", "answer", "authority", "additional",
+    "dnssec_status", "answer_ipv4_address", "answer_ipv6_address",
+    "id", "qr", "opcode", "aa", "tc", "rd", "ra", "z", "ad", "cd", "rcode",
+    "qdcount", "ancount", "nscount", "arcount",
+    "qname", "qtype", "qclass",
+    /* resource records */
+    "name", "type", "class", "ttl", "rdata", "rdata_raw",
+    "udp_payload_size", "extended_rcode", "version", "do",
+    "options", "option_code", "option_data",
+    /* rdata */
+    "ipv4_address", "ipv6_address", "nsdname", "cname", "ptrdname",
+    "dname", "target", "mname", "rname", "serial", "refresh", "retry",
+    "expire", "minimum", "preference", "exchange", "txt_strings",
+    "cpu", "os", "rmailbx", "emailbx", "madname", "mgmname", "newname",
+    "mbox_dname", "txt_dname", "subtype", "hostname",
+    "order", "flags", "service", "regexp", "replacement",
+    "algorithm", "protocol", "public_key", "key_tag", "digest_type",
+    "digest", "type_covered", "labels", "original_ttl",
+    "signature_expiration", "signature_inception", "signers_name",
+    "signature", "next_domain_name", "type_bit_maps", "hash_algorithm",
+    "opt_out", "iterations", "salt", "next_hashed_owner_name",
+    "certificate_usage", "selector", "matching_type",
+    "certificate_association_data", "fingerprint_type", "fingerprint",
+    "tag", "value", "certificate", "hit", "pk_algorithm",
+    "rendezvous_servers", "gateway_type", "gateway", "precedence",
+    0
+};
+
+
+static PyObject *
+key_new(const char *name, size_t len, int intern)
+{
+    PyObject *key;
+
+#if PY_MAJOR_VERSION >= 3
+    if ((key = PyUnicode_FromStringAndSize(name, (Py_ssize_t)len)) != NULL && intern)
+        PyUnicode_InternInPlace(&key);
+#else
+    if ((key = PyString_FromStringAndSize(name, (Py_ssize_t)len)) != NULL && intern)
+        PyString_InternInPlace(&key);
+#endif
+    return key;
+}
+
+
+/*
+ * the slot holding name, or the empty one it would go in.  A
+ * slot's key is set before its name
+ */
+
+static response_key_slot *
+key_table_slot(const char *name, uint32_t hash)
+{
+    response_key_slot *slot;
+    char *slot_name;
+
+    for (slot = &key_table[hash & (KEY_TABLE_SIZE - 1)] ;
+         (slot_name = PYGETDNS_LOAD(slot->name)) != NULL ; )  {
+        if (!strcmp(slot_name, name))
+            return slot;
+        if (++slot == &key_table[KEY_TABLE_SIZE])
+            slot = key_table;
+    }
+    return slot;
+}
+
+
+/*
+ * the key object for name, as a new reference
+ */
+
+PyObject *
+response_key(const char *name)
+{
+    uint32_t hash = 2166136261U;    /* FNV-1a */
+    const char *p;
+    size_t len;
+    response_key_slot *slot;
+    char *slot_name;
+    PyObject *key;
+
+    for (p = name ; *p ; p++)
+        hash = (hash ^ (uint8_t)*p) * 16777619U;
+    len = (size_t)(p - name);
+    slot = key_table_slot(name, hash);
+    if (PYGETDNS_LOAD(slot->name))  {
+        Py_INCREF(slot->key);
+        return slot->key;
+    }
+
+    PYGETDNS_MUTEX_LOCK(key_table_mutex);
+    slot = key_table_slot(name, hash);      /* it may have been added meanwhile */
+    if (PYGETDNS_LOAD(slot->name))  {
+        key = slot->key;
+        Py_INCREF(key);
+    }  else if (key_table_used >= KEY_TABLE_MAX)
+        key = key_new(name, len, 0);
+    else if ((key = key_new(name, len, 1)) != NULL &&
+             (slot_name = (char *)PyMem_Malloc(len + 1)) != NULL)  {
+        memcpy(slot_name, name, len + 1);
+        Py_INCREF(key);
+        slot->key = key;
+        PYGETDNS_STORE(slot->name, slot_name);
+        key_table_used++;
+    }
+    PYGETDNS_MUTEX_UNLOCK(key_table_mutex);
+    return key;
+}
+
+
+int
+response_keys_init(void)
+{
+    const char **name;
+    PyObject *key;
+
+    for (name = schema_keys ; *name ; name++)  {
+        if ((key = response_key(*name)) == NULL)
+            return -1;
+        Py_DECREF(key);
+    }
+    return 0;
+}
+
+
+/*
+ * append to a list or set in a dict, handing over our reference
+ * to value.  A NULL value (failed conversion) fails too
+ */
+
+static int
+list_append(PyObject *list, PyObject *value)
+{
+    int ret;
+
+    if (value == NULL)
+        return -1;
+    ret = PyList_Append(list, value);
+    Py_DECREF(value);
+    return ret;
+}
+
+
+static int
+dict_set(PyObject *dict, char *name, PyObject *value)
+{
+    PyObject *key;
+    int ret = -1;
+
+    if (value == NULL)
+        return -1;
+    if ((key = response_key(name)) != NULL)  {
+        ret = PyDict_SetItem(dict, key, value);
+        Py_DECREF(key);
+    }
+    Py_DECREF(value);
+    return ret;
+}
+
+
 PyObject *
-glist_to_plist(struct getdns_list *list)
+glist_to_plist(struct getdns_list *list, PyObject *owner)
 {
     PyObject *py_list;
     size_t  count;
@@ -505,7 +798,8 @@ glist_to_plist(struct getdns_list *list)
         PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
         return NULL;
     }
-    py_list = PyList_New(0);
+    if ((py_list = PyList_New(0)) == NULL)
+        return NULL;
     for ( i = 0 ; i < count ; i++ )  {
         (void)getdns_list_get_data_type(list, i, &type);
         switch (type)  {
@@ -514,13 +808,13 @@ glist_to_plist(struct getdns_list *list)
                 PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
                 return NULL;
             }
-            if ((py_dict = gdict_to_pdict(dict_item)) == NULL)  {
+            if ((py_dict = gdict_to_pdict(dict_item, owner)) == NULL)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-                return NULL;
+                goto error;
             }
-            if (PyList_Append(py_list, py_dict) == -1)  {
+            if (list_append(py_list, py_dict) == -1)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-                return NULL;
+                goto error;
             }
             break;
 
@@ -529,13 +823,13 @@ glist_to_plist(struct getdns_list *list)
                 PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
                 return NULL;
             }
-            if ((py_locallist = glist_to_plist(list_item)) == NULL)  {
+            if ((py_locallist = glist_to_plist(list_item, owner)) == NULL)  {
                 PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-                return NULL;
+                goto error;
             }
-            if (PyList_Append(py_list, py_locallist) == -1)  {
+            if (list_append(py_list, py_locallist) == -1)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-                return NULL;
+                goto error;
             }
             break;
 
@@ -549,9 +843,9 @@ glist_to_plist(struct getdns_list *list)
 #else
             py_int = PyInt_FromLong((long)localint);
 #endif
-            if (PyList_Append(py_list, py_int) == -1)  {
+            if (list_append(py_list, py_int) == -1)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-                return NULL;
+                goto error;
             }
             break;
 
@@ -560,25 +854,29 @@ glist_to_plist(struct getdns_list *list)
                 PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
                 return NULL;
             }
-            if ((py_bindata = convertBinData(data, "")) == 0)  {
-                return NULL;
+            if ((py_bindata = convertBinData(data, "", owner)) == 0)  {
+                goto error;
             }
-            if (PyList_Append(py_list, py_bindata) == -1)  {
-                return NULL;
+            if (list_append(py_list, py_bindata) == -1)  {
+                goto error;
             }
             break;
 
         default:
             PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-            return NULL;
+            goto error;
         }
     }
     return py_list;
+
+error:
+    Py_DECREF(py_list);
+    return NULL;
 }
 
 
 PyObject *
-gdict_to_pdict(struct getdns_dict *dict)
+gdict_to_pdict(struct getdns_dict *dict, PyObject *owner)
 {
     PyObject *py_dict;
     getdns_list *keys;
@@ -600,36 +898,39 @@ gdict_to_pdict(struct getdns_dict *dict)
         PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
         return NULL;
     }
-    py_dict = PyDict_New();
+    if ((py_dict = PyDict_New()) == NULL)  {
+        getdns_list_destroy(keys);
+        return NULL;
+    }
     (void)getdns_list_get_length(keys, &n_keys);
     for (i = 0 ; i < (int)n_keys ; i++ )  {
         if ((ret = getdns_list_get_bindata(keys, (size_t)i, &key_name)) != GETDNS_RETURN_GOOD)  {
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
+            goto error;
         }
         if (strnlen((char *)key_name->data, 256) == 256)  { /* too long, something's wrong */
             PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-            return NULL;
+            goto error;
         }
         if ((ret = getdns_dict_get_data_type(dict, (char *)key_name->data, &type)) !=
             GETDNS_RETURN_GOOD)  {
             PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-            return NULL;
+            goto error;
         }
         switch (type)  {
         case t_dict:
             if ((ret = getdns_dict_get_dict(dict, (char *)key_name->data, &dict_item)) !=
                 GETDNS_RETURN_GOOD)  {
                 PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-                return NULL;
+                goto error;
             }
-            if ((py_localdict = gdict_to_pdict(dict_item)) == NULL)  {
+            if ((py_localdict = gdict_to_pdict(dict_item, owner)) == NULL)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-                return NULL;
+                goto error;
             }
-            if (PyDict_SetItemString(py_dict, (char *)key_name->data, py_localdict) != 0)  {
+            if (dict_set(py_dict, (char *)key_name->data, py_localdict) != 0)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-                return NULL;
+                goto error;
             }
             break;
 
@@ -637,15 +938,15 @@ gdict_to_pdict(struct getdns_dict *dict)
             if ((ret = getdns_dict_get_list(dict, (char *)key_name->data, &list_item)) !=
                 GETDNS_RETURN_GOOD)  {
                 PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-                return NULL;
+                goto error;
             }
-            if ((py_locallist = glist_to_plist(list_item)) == NULL)  {
+            if ((py_locallist = glist_to_plist(list_item, owner)) == NULL)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-                return NULL;
+                goto error;
             }
-            if (PyDict_SetItemString(py_dict, (char *)key_name->data, py_locallist) != 0)  {
+            if (dict_set(py_dict, (char *)key_name->data, py_locallist) != 0)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-                return NULL;
+                goto error;
             }
             break;
 
@@ -653,16 +954,16 @@ gdict_to_pdict(struct getdns_dict *dict)
             if ((ret = getdns_dict_get_int(dict, (char *)key_name->data, &int_item)) !=
                 GETDNS_RETURN_GOOD)  {
                 PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-                return NULL;
+                goto error;
             }
 #if PY_MAJOR_VERSION >= 3
             py_localint = PyLong_FromLong((long)int_item);
 #else
             py_localint = PyInt_FromLong((long)int_item);
 #endif
-            if (PyDict_SetItemString(py_dict, (char *)key_name->data, py_localint) == -1)  {
+            if (dict_set(py_dict, (char *)key_name->data, py_localint) == -1)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-                return NULL;
+                goto error;
             }
             break;
 
@@ -670,22 +971,153 @@ gdict_to_pdict(struct getdns_dict *dict)
             if ((ret = getdns_dict_get_bindata(dict, (char *)key_name->data, &bindata_item))
                 != GETDNS_RETURN_GOOD)  {
                 PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
-                return NULL;
+                goto error;
             }
-            if ((py_localbindata = convertBinData(bindata_item, "")) == 0)  {
-                return NULL;
+            if ((py_localbindata = convertBinData(bindata_item, "", owner)) == 0)  {
+                goto error;
             }
-            if (PyDict_SetItemString(py_dict, (char *)key_name->data, py_localbindata) == -1)  {
-                return NULL;
+            if (dict_set(py_dict, (char *)key_name->data, py_localbindata) == -1)  {
+                goto error;
             }
             break;
 
         default:
             PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
-            return NULL;
+            goto error;
         }
     }
+    getdns_list_destroy(keys);
     return py_dict;
+
+error:
+    getdns_list_destroy(keys);
+    Py_DECREF(py_dict);
+    return NULL;
+}
+
+
+/*
+ * the reverse of gdict_to_pdict() and glist_to_plist(), for data
+ * that didn't come from getdns in the first place.  Dicts, lists
+ * and ints map across directly; bytes (and strings, as UTF-8)
+ * become bindata.  getdns copies what it's given, so children
+ * are destroyed once they've been added
+ */
+
+static int
+pobj_to_gitem(PyObject *value, struct getdns_dict *dict, char *name,
+              struct getdns_list *list, size_t index)
+{
+    struct getdns_dict *child_dict;
+    struct getdns_list *child_list;
+    getdns_bindata bindata;
+    PyObject *bytes = 0;
+    getdns_return_t ret;
+    long int_value;
+
+    if (PyDict_Check(value))  {
+        if ((child_dict = pdict_to_gdict(value)) == NULL)
+            return -1;
+        ret = dict ? getdns_dict_set_dict(dict, name, child_dict)
+            : getdns_list_set_dict(list, index, child_dict);
+        getdns_dict_destroy(child_dict);
+    }  else if (PyList_Check(value) || PyTuple_Check(value))  {
+        if ((child_list = plist_to_glist(value)) == NULL)
+            return -1;
+        ret = dict ? getdns_dict_set_list(dict, name, child_list)
+            : getdns_list_set_list(list, index, child_list);
+        getdns_list_destroy(child_list);
+#if PY_MAJOR_VERSION >= 3
+    }  else if (PyLong_Check(value))  {
+#else
+    }  else if (PyInt_Check(value) || PyLong_Check(value))  {
+#endif
+        int_value = PyLong_AsLong(value);
+        if (int_value < 0 || int_value > 0xffffffffL)  {
+            PyErr_Clear();
+            PyErr_SetString(getdns_error, GETDNS_RETURN_WRONG_TYPE_REQUESTED_TEXT);
+            return -1;
+        }
+        ret = dict ? getdns_dict_set_int(dict, name, (uint32_t)int_value)
+            : getdns_list_set_int(list, index, (uint32_t)int_value);
+    }  else  {
+        if (PyUnicode_Check(value))  {
+            if ((bytes = PyUnicode_AsUTF8String(value)) == NULL)
+                return -1;
+            value = bytes;
+        }
+        if (!PyBytes_Check(value))  {
+            Py_XDECREF(bytes);
+            PyErr_SetString(getdns_error, GETDNS_RETURN_WRONG_TYPE_REQUESTED_TEXT);
+            return -1;
+        }
+        bindata.data = (uint8_t *)PyBytes_AS_STRING(value);
+        bindata.size = (size_t)PyBytes_GET_SIZE(value);
+        ret = dict ? getdns_dict_set_bindata(dict, name, &bindata)
+            : getdns_list_set_bindata(list, index, &bindata);
+        Py_XDECREF(bytes);
+    }
+    if (ret != GETDNS_RETURN_GOOD)  {
+        PyErr_SetString(getdns_error, getdns_get_errorstr_by_id(ret));
+        return -1;
+    }
+    return 0;
+}
+
+
+struct getdns_list *
+plist_to_glist(PyObject *pylist)
+{
+    struct getdns_list *list;
+    PyObject *seq;
+    Py_ssize_t i;
+
+    if ((seq = PySequence_Fast(pylist, "Expected list, didn't get one")) == NULL)
+        return NULL;
+    list = getdns_list_create();
+    for (i = 0 ; i < PySequence_Fast_GET_SIZE(seq) ; i++)  {
+        if (pobj_to_gitem(PySequence_Fast_GET_ITEM(seq, i), 0, 0, list, (size_t)i) < 0)  {
+            getdns_list_destroy(list);
+            Py_DECREF(seq);
+            return NULL;
+        }
+    }
+    Py_DECREF(seq);
+    return list;
+}
+
+
+struct getdns_dict *
+pdict_to_gdict(PyObject *pydict)
+{
+    struct getdns_dict *dict;
+    Py_ssize_t pos = 0;
+    PyObject *key;
+    PyObject *value;
+    PyObject *key_bytes;
+
+    if (!PyDict_Check(pydict))  {
+        PyErr_SetString(getdns_error, "Expected dict, didn't get one");
+        return NULL;
+    }
+    dict = getdns_dict_create();
+    while (PyDict_Next(pydict, &pos, &key, &value))  {
+#if PY_MAJOR_VERSION >= 3
+        if ((key_bytes = PyUnicode_AsEncodedString(key, "ascii", NULL)) == NULL)  {
+#else
+        if ((key_bytes = PyObject_Str(key)) == NULL)  {
+#endif
+            getdns_dict_destroy(dict);
+            return NULL;
+        }
+        if (pobj_to_gitem(value, dict, PyBytes_AS_STRING(key_bytes), 0, 0) < 0)  {
+            Py_DECREF(key_bytes);
+            getdns_dict_destroy(dict);
+            return NULL;
+        }
+        Py_DECREF(key_bytes);
+    }
+    return dict;
 }
 
 
@@ -725,12 +1157,14 @@ priv_getdns_bindata_is_dname(struct getdns_bindata *bindata)
 }
 
 // Convert bindata into a good representational string or
-// into a buffer. Handles dname, printable, ".",
-// and an ip address if it is under a known key
+// into a getdns.Bindata. Handles dname, printable, ".",
+// and an ip address if it is under a known key.  A Bindata
+// borrows its bytes from owner's response if there's an owner
+// (the Result being converted), and copies them if not
 
 PyObject *
 convertBinData(getdns_bindata* data,
-                    const char* key) 
+                    const char* key, PyObject *owner) 
 {
     size_t i; 
 
@@ -786,10 +1220,12 @@ convertBinData(getdns_bindata* data,
         if (getdns_convert_dns_name_to_fqdn(data, &dname)
             == GETDNS_RETURN_GOOD) {
 #if PY_MAJOR_VERSION >= 3
-            if ((dname_string = PyUnicode_FromString(dname)) != NULL)  {
+            dname_string = PyUnicode_FromString(dname);
 #else
-            if ((dname_string = PyString_FromString(dname)) != NULL)  {
+            dname_string = PyString_FromString(dname);
 #endif
+            free(dname);
+            if (dname_string != NULL)  {
                 return(dname_string);
             }  else  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
@@ -809,24 +1245,23 @@ convertBinData(getdns_bindata* data,
         if (ipStr) {
             PyObject *addr_string;
 #if PY_MAJOR_VERSION >= 3
-            if ((addr_string = PyUnicode_FromString(ipStr)) == NULL)  {
+            addr_string = PyUnicode_FromString(ipStr);
 #else
-            if ((addr_string = PyString_FromString(ipStr)) == NULL)  {
+            addr_string = PyString_FromString(ipStr);
 #endif
+            free(ipStr);
+            if (addr_string == NULL)  {
                 PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
                 return NULL;
             }
             return(addr_string);
         }
     }  else  {                  /* none of the above, treat it like a blob */
-        uint8_t *blob = (uint8_t *)malloc(data->size);
-        
-        memcpy(blob, data->data, data->size);
-#if PY_MAJOR_VERSION >= 3                       
-        return (PyMemoryView_FromMemory((char *)blob, (Py_ssize_t)data->size, PyBUF_READ));
-#else
-        return (PyBuffer_FromMemory(blob, (Py_ssize_t)data->size));
-#endif
+        PyObject *keeper = 0;
+
+        if (owner && (keeper = result_keeper(owner)) == NULL)
+            return NULL;
+        return bindata_create(data, keeper);
     }
     return NULL;                /* should never get here .. */
 }
@@ -863,20 +1298,20 @@ convertToDict(struct getdns_dict* dict) {
         getdns_list_get_bindata(names, i, &nameBin);
         getdns_data_type type;
         getdns_dict_get_data_type(dict, (char*)nameBin->data, &type);
+        PyObject *key = response_key((char*)nameBin->data);
+        if (key == NULL) {
+            getdns_list_destroy(names);
+            Py_DECREF(resultsdict1);
+            return NULL;
+        }
 
         switch (type) {
             case t_bindata:
             {
                 getdns_bindata* data = NULL;
                 getdns_dict_get_bindata(dict, (char*)nameBin->data, &data);
-                PyObject* res = convertBinData(data, (char*)nameBin->data);
-#if PY_MAJOR_VERSION >= 3
-                PyDict_SetItem(resultsdict1, PyUnicode_FromStringAndSize((char *)nameBin->data, 
-                                                                         (Py_ssize_t)nameBin->size), res);
-#else
-                PyDict_SetItem(resultsdict1, PyString_FromStringAndSize((char *)nameBin->data,
-                                                                 (Py_ssize_t)nameBin->size), res);
-#endif
+                PyObject* res = convertBinData(data, (char*)nameBin->data, NULL);
+                PyDict_SetItem(resultsdict1, key, res);
                 break;
             }
             case t_int:
@@ -885,13 +1320,7 @@ convertToDict(struct getdns_dict* dict) {
                 getdns_dict_get_int(dict, (char*)nameBin->data, &res);
                 PyObject* rl1 = Py_BuildValue("i", res);
                 PyObject *res1 = Py_BuildValue("O", rl1);
-#if PY_MAJOR_VERSION >= 3
-                PyDict_SetItem(resultsdict1, PyUnicode_FromStringAndSize((char *)nameBin->data,
-                                                                         (Py_ssize_t)nameBin->size), res1);
-#else
-                PyDict_SetItem(resultsdict1, PyString_FromStringAndSize((char *)nameBin->data,
-                                                                        (Py_ssize_t)nameBin->size), res1);
-#endif
+                PyDict_SetItem(resultsdict1, key, res1);
                 break;
             }
             case t_dict:
@@ -900,13 +1329,7 @@ convertToDict(struct getdns_dict* dict) {
                 getdns_dict_get_dict(dict, (char*)nameBin->data, &subdict);
                 PyObject *rl1 = convertToDict(subdict);
                 PyObject *res1 = Py_BuildValue("O", rl1);
-#if PY_MAJOR_VERSION >= 3
-                PyDict_SetItem(resultsdict1, PyUnicode_FromStringAndSize((char *)nameBin->data,
-                                                                         (Py_ssize_t)nameBin->size), res1);
-#else
-                PyDict_SetItem(resultsdict1, PyString_FromStringAndSize((char *)nameBin->data,
-                                                                        (Py_ssize_t)nameBin->size), res1);
-#endif
+                PyDict_SetItem(resultsdict1, key, res1);
                 break;
             }
             case t_list:
@@ -915,19 +1338,13 @@ convertToDict(struct getdns_dict* dict) {
                 getdns_dict_get_list(dict, (char*)nameBin->data, &list);
                 PyObject *rl1 = convertToList(list);
                 PyObject *res1 = Py_BuildValue("O", rl1);
-#if PY_MAJOR_VERSION >= 3
-                PyObject *key = PyUnicode_FromStringAndSize((char *)nameBin->data,
-                                                            (Py_ssize_t)nameBin->size);
-#else
-                PyObject *key = PyString_FromStringAndSize((char *)nameBin->data,
-                                                           (Py_ssize_t)nameBin->size);
-#endif
                 PyDict_SetItem(resultsdict1, key, res1);
                 break;
             }
             default:
                 break;
         }
+        Py_DECREF(key);
     }
     getdns_list_destroy(names);
     return resultsdict1;
@@ -959,7 +1376,7 @@ convertToList(struct getdns_list* list) {
             {
                 getdns_bindata* data = NULL;
                 getdns_list_get_bindata(list, i, &data);
-                PyObject* res = convertBinData(data, NULL);
+                PyObject* res = convertBinData(data, NULL, NULL);
                 if (res) {
                     PyList_Append(resultslist1, res);
                 } else {
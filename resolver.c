@@ -0,0 +1,954 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <Python.h>
+#include <getdns/getdns.h>
+#include <event2/event.h>
+#include <getdns/getdns_ext_libevent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include "pygetdns.h"
+
+#define RESOLVER_DEFAULT_CONCURRENCY 64
+
+/*
+ * Resolver runs queries on worker threads of its own, each with
+ * a Context (configured like a ContextPool's) and that Context's
+ * libevent base, so lookups spread over as many cores as there
+ * are workers.  The workers never take the GIL.
+ *
+ * Queries are handed over in resolver_jobs, plain C copies of
+ * the name and type, through queues that are lock-free for the
+ * writers: Dmitry Vyukov's intrusive multi-producer, single-
+ * consumer list.  Each worker reads its own inbox, filled round
+ * robin by submit() and bulk(); finished jobs go on the
+ * Resolver's completion queue, read by Python.  A queue's reader
+ * sleeps on the read end of a pipe (a persistent libevent event
+ * for the workers, poll() or the caller's own loop through
+ * fileno() for Python), and writers only write to it when the
+ * reader's "signalled" flag wasn't already set, so a busy reader
+ * isn't sent a byte per job.  A reader clears the flag before it
+ * empties the queue, so a job pushed meanwhile either gets seen
+ * or sends a fresh wakeup.
+ *
+ * Only one Python thread at a time reads the completion queue
+ * (the "consumer" lock).  Whoever has it hands each job to its
+ * owner: a bulk() call's result list, or the ready list that
+ * collect() returns from.
+ */
+
+typedef struct resolver_batch  {
+    PyObject *results;
+    Py_ssize_t remaining;
+    Py_ssize_t refs;            /* jobs in flight, plus the caller */
+} resolver_batch;
+
+typedef struct resolver_job  {
+    struct resolver_job *next;  /* queue and backlog link */
+    struct resolver_job *prev_pending;
+    struct resolver_job *next_pending;
+    pygetdns_resolver_worker *worker;
+    /* these four are only touched with the GIL */
+    PyObject *userarg;
+    PyObject *extensions_obj;
+    resolver_batch *bulk;
+    Py_ssize_t slot;
+    getdns_dict *extensions;
+    uint64_t id;
+    getdns_transaction_t tid;
+    getdns_callback_type_t type;
+    getdns_dict *response;
+    uint16_t request_type;
+    char name[1];
+} resolver_job;
+
+struct pygetdns_resolver_queue  {
+    resolver_job *head;         /* the last job pushed, swapped in by writers */
+    resolver_job *tail;         /* the next to be popped; the reader's */
+    resolver_job stub;
+    int fds[2];
+    int signalled;
+};
+
+struct pygetdns_resolver_worker  {
+    PyObject *context_obj;
+    getdns_context *context;
+    struct event_base *base;
+    struct event *wake;
+    pygetdns_resolver_queue inbox;
+    pygetdns_resolver_queue *done;
+    resolver_job *backlog;      /* taken from the inbox, not yet submitted */
+    resolver_job *backlog_last;
+    resolver_job *in_getdns;    /* submitted, not yet called back */
+    size_t n_pending;
+    size_t concurrency;
+    pthread_t thread;
+    int running;
+    int stopping;
+};
+
+
+static int
+queue_init(pygetdns_resolver_queue *q)
+{
+    memset(q, 0, sizeof(*q));
+    q->head = q->tail = &q->stub;
+    if (pipe(q->fds) < 0)  {
+        q->fds[0] = q->fds[1] = -1;
+        return -1;
+    }
+    (void)fcntl(q->fds[0], F_SETFL, O_NONBLOCK);
+    (void)fcntl(q->fds[1], F_SETFL, O_NONBLOCK);
+    (void)fcntl(q->fds[0], F_SETFD, FD_CLOEXEC);
+    (void)fcntl(q->fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+
+static void
+queue_close(pygetdns_resolver_queue *q)
+{
+    if (q->fds[0] >= 0)  {
+        close(q->fds[0]);
+        close(q->fds[1]);
+    }
+}
+
+
+static void
+queue_push_job(pygetdns_resolver_queue *q, resolver_job *job)
+{
+    resolver_job *prev;
+
+    __atomic_store_n(&job->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&q->head, job, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, job, __ATOMIC_RELEASE);
+}
+
+
+static void
+queue_signal(pygetdns_resolver_queue *q)
+{
+    if (__atomic_exchange_n(&q->signalled, 1, __ATOMIC_SEQ_CST) == 0)
+        (void)write(q->fds[1], "", 1);
+}
+
+
+static void
+queue_push(pygetdns_resolver_queue *q, resolver_job *job)
+{
+    queue_push_job(q, job);
+    queue_signal(q);
+}
+
+
+/*
+ * the reader, before emptying the queue
+ */
+
+static void
+queue_rearm(pygetdns_resolver_queue *q)
+{
+    char buf[64];
+
+    while (read(q->fds[0], buf, sizeof(buf)) > 0)
+        ;
+    (void)__atomic_exchange_n(&q->signalled, 0, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * NULL when the queue's empty, or when a writer is half way
+ * through a push; that writer's wakeup is still to come
+ */
+
+static resolver_job *
+queue_pop(pygetdns_resolver_queue *q)
+{
+    resolver_job *tail = q->tail;
+    resolver_job *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &q->stub)  {
+        if (next == NULL)
+            return NULL;
+        q->tail = tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next)  {
+        q->tail = next;
+        return tail;
+    }
+    if (tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE))
+        return NULL;
+    queue_push_job(q, &q->stub);
+    if ((next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE)) != NULL)  {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+
+/*
+ * the workers
+ */
+
+static void worker_submit(pygetdns_resolver_worker *w);
+
+
+static void
+worker_unlink(pygetdns_resolver_worker *w, resolver_job *job)
+{
+    if (job->prev_pending)
+        job->prev_pending->next_pending = job->next_pending;
+    else
+        w->in_getdns = job->next_pending;
+    if (job->next_pending)
+        job->next_pending->prev_pending = job->prev_pending;
+    w->n_pending--;
+}
+
+
+static void
+worker_callback(getdns_context *context, getdns_callback_type_t type,
+                getdns_dict *response, void *userarg, getdns_transaction_t tid)
+{
+    resolver_job *job = (resolver_job *)userarg;
+    pygetdns_resolver_worker *w = job->worker;
+
+    worker_unlink(w, job);
+    job->type = type;
+    if (type == GETDNS_CALLBACK_CANCEL)
+        getdns_dict_destroy(response);
+    else
+        job->response = response;
+    queue_push(w->done, job);
+    if (!__atomic_load_n(&w->stopping, __ATOMIC_ACQUIRE))
+        worker_submit(w);
+}
+
+
+/*
+ * hand getdns as much of the backlog as the concurrency limit
+ * allows.  Once a job's been pushed on to the completion queue
+ * it belongs to Python, and isn't touched again
+ */
+
+static void
+worker_submit(pygetdns_resolver_worker *w)
+{
+    resolver_job *job;
+
+    while (w->backlog && w->n_pending < w->concurrency)  {
+        job = w->backlog;
+        if ((w->backlog = job->next) == NULL)
+            w->backlog_last = NULL;
+        job->worker = w;
+        job->prev_pending = NULL;
+        if ((job->next_pending = w->in_getdns) != NULL)
+            job->next_pending->prev_pending = job;
+        w->in_getdns = job;
+        w->n_pending++;
+        if (getdns_general(w->context, job->name, job->request_type, job->extensions,
+                           (void *)job, &job->tid, worker_callback) != GETDNS_RETURN_GOOD)  {
+            worker_unlink(w, job);
+            job->type = GETDNS_CALLBACK_ERROR;
+            queue_push(w->done, job);
+        }
+    }
+}
+
+
+static void
+worker_wake(evutil_socket_t fd, short what, void *arg)
+{
+    pygetdns_resolver_worker *w = (pygetdns_resolver_worker *)arg;
+    resolver_job *job;
+
+    queue_rearm(&w->inbox);
+    while ((job = queue_pop(&w->inbox)) != NULL)  {
+        job->next = NULL;
+        if (w->backlog_last)
+            w->backlog_last->next = job;
+        else
+            w->backlog = job;
+        w->backlog_last = job;
+    }
+    if (!__atomic_load_n(&w->stopping, __ATOMIC_ACQUIRE))  {
+        worker_submit(w);
+        return;
+    }
+    while ((job = w->backlog) != NULL)  {
+        w->backlog = job->next;
+        job->type = GETDNS_CALLBACK_CANCEL;
+        queue_push(w->done, job);
+    }
+    w->backlog_last = NULL;
+    while ((job = w->in_getdns) != NULL)  {
+        (void)getdns_cancel_callback(w->context, job->tid);
+        if (w->in_getdns == job)  {    /* getdns didn't call back */
+            worker_unlink(w, job);
+            job->type = GETDNS_CALLBACK_CANCEL;
+            queue_push(w->done, job);
+        }
+    }
+    event_base_loopbreak(w->base);
+}
+
+
+static void *
+worker_main(void *arg)
+{
+    pygetdns_resolver_worker *w = (pygetdns_resolver_worker *)arg;
+
+    (void)event_base_loop(w->base, 0);
+    return NULL;
+}
+
+
+static int
+worker_start(getdns_ResolverObject *self, pygetdns_resolver_worker *w, PyObject *settings)
+{
+    getdns_ContextObject *context_obj;
+    sigset_t all;
+    sigset_t old;
+    int ret;
+
+    if (queue_init(&w->inbox) < 0)  {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    w->done = self->done;
+    w->concurrency = (size_t)self->concurrency;
+    if ((w->context_obj = context_new_configured(settings)) == NULL)
+        return -1;
+    context_obj = (getdns_ContextObject *)w->context_obj;
+    if ((w->context = PyCapsule_GetPointer(context_obj->py_context, "context")) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_BAD_CONTEXT_TEXT);
+        return -1;
+    }
+    if (context_attach_libevent(context_obj, w->context) < 0)
+        return -1;
+    w->base = context_obj->event_base;
+    if ((w->wake = event_new(w->base, w->inbox.fds[0], EV_READ|EV_PERSIST, worker_wake, w)) == NULL ||
+        event_add(w->wake, NULL) < 0)  {
+        PyErr_SetString(getdns_error, "Can't create event");
+        return -1;
+    }
+
+    /* signals are for the Python threads */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    ret = pthread_create(&w->thread, NULL, worker_main, w);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (ret != 0)  {
+        errno = ret;
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    w->running = 1;
+    return 0;
+}
+
+
+/*
+ * the Python side
+ */
+
+static void
+bulk_release(resolver_batch *bulk)
+{
+    if (--bulk->refs == 0)  {
+        Py_DECREF(bulk->results);
+        PyMem_Free(bulk);
+    }
+}
+
+
+static void
+job_free(resolver_job *job)
+{
+    getdns_dict_destroy(job->response);
+    extensions_put(job->extensions_obj, job->extensions);
+    Py_XDECREF(job->extensions_obj);
+    Py_XDECREF(job->userarg);
+    if (job->bulk)
+        bulk_release(job->bulk);
+    free(job);
+}
+
+
+static resolver_job *
+job_new(getdns_ResolverObject *self, const char *name, uint16_t request_type,
+        PyObject *extensions_obj, getdns_dict *extensions)
+{
+    size_t len = strlen(name);
+    resolver_job *job;
+
+    if ((job = (resolver_job *)malloc(sizeof(resolver_job) + len)) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        return NULL;
+    }
+    memset(job, 0, sizeof(resolver_job));
+    memcpy(job->name, name, len + 1);
+    job->request_type = request_type;
+    job->id = ++self->next_id;
+    Py_XINCREF(extensions_obj);
+    job->extensions_obj = extensions_obj;
+    job->extensions = extensions;
+    return job;
+}
+
+
+static pygetdns_resolver_worker *
+resolver_next_worker(getdns_ResolverObject *self)
+{
+    pygetdns_resolver_worker *w = &self->workers[self->next_worker];
+
+    self->next_worker = (self->next_worker + 1) % self->n_workers;
+    return w;
+}
+
+
+/*
+ * pass a finished job on to whoever's waiting for it.  Called
+ * with the consumer lock held
+ */
+
+static int
+resolver_deliver(getdns_ResolverObject *self, resolver_job *job)
+{
+    PyObject *result = Py_None;
+    PyObject *entry;
+    int ret = 0;
+
+    self->pending--;
+    if (job->response)  {
+        result = result_create(job->response);
+        job->response = 0;
+        if (result == NULL)  {
+            job_free(job);
+            return -1;
+        }
+    }  else
+        Py_INCREF(result);
+    if (job->bulk)  {
+        PyList_SetItem(job->bulk->results, job->slot, result);
+        job->bulk->remaining--;
+    }  else  {
+        entry = Py_BuildValue("(iNOK)", (int)job->type, result,
+                              job->userarg ? job->userarg : Py_None,
+                              (unsigned long long)job->id);
+        if (entry == NULL || PyList_Append(self->ready, entry) < 0)
+            ret = -1;
+        Py_XDECREF(entry);
+    }
+    job_free(job);
+    return ret;
+}
+
+
+static int
+resolver_drain(getdns_ResolverObject *self)
+{
+    resolver_job *job;
+    int ret = 0;
+
+    queue_rearm(self->done);
+    while ((job = queue_pop(self->done)) != NULL)  {
+        if (resolver_deliver(self, job) < 0)
+            ret = -1;
+    }
+    return ret;
+}
+
+
+static void
+resolver_consumer_lock(getdns_ResolverObject *self)
+{
+    if (!PyThread_acquire_lock(self->consumer, NOWAIT_LOCK))  {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->consumer, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+
+/*
+ * wait for finished jobs until done(self, arg) says so or the
+ * deadline (in context_stats_now() time; 0 for none) passes.
+ * Returns 1 if done, 0 on timeout, -1 on error, which includes
+ * the Resolver being closed by another thread: close() throws
+ * away the jobs we'd be waiting for
+ */
+
+static int
+resolver_wait(getdns_ResolverObject *self, int (*done)(getdns_ResolverObject *, void *),
+              void *arg, uint64_t deadline)
+{
+    struct pollfd pfd;
+    uint64_t now;
+    int wait_ms;
+    int n;
+
+    for (;;)  {
+        resolver_consumer_lock(self);
+        if (resolver_drain(self) < 0)  {
+            PyThread_release_lock(self->consumer);
+            return -1;
+        }
+        if (done(self, arg))  {
+            PyThread_release_lock(self->consumer);
+            return 1;
+        }
+        if (PYGETDNS_LOAD(self->closed))  {
+            PyThread_release_lock(self->consumer);
+            PyErr_SetString(getdns_error, "Resolver is closed");
+            return -1;
+        }
+        wait_ms = -1;
+        if (deadline)  {
+            now = context_stats_now();
+            if (now >= deadline)  {
+                PyThread_release_lock(self->consumer);
+                return 0;
+            }
+            wait_ms = (int)((deadline - now + 999999) / 1000000);
+        }
+        pfd.fd = self->done->fds[0];
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        Py_BEGIN_ALLOW_THREADS
+        n = poll(&pfd, 1, wait_ms);
+        Py_END_ALLOW_THREADS
+        PyThread_release_lock(self->consumer);
+        if (n < 0 && errno != EINTR)  {
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        if (PyErr_CheckSignals() < 0)
+            return -1;
+    }
+}
+
+
+static int
+resolver_ready(getdns_ResolverObject *self, void *arg)
+{
+    return PyList_GET_SIZE(self->ready) > 0 || self->pending == 0;
+}
+
+
+static int
+resolver_batch_done(getdns_ResolverObject *self, void *arg)
+{
+    return ((resolver_batch *)arg)->remaining == 0;
+}
+
+
+static int
+resolver_check(getdns_ResolverObject *self)
+{
+    if (self->closed || self->workers == NULL)  {
+        PyErr_SetString(getdns_error, "Resolver is closed");
+        return -1;
+    }
+    return 0;
+}
+
+
+PyObject *
+resolver_new(PyTypeObject *type, PyObject *args, PyObject *keywds)
+{
+    getdns_ResolverObject *self;
+    PyObject *settings = 0;
+    PyObject *value;
+    Py_ssize_t n_workers = 0;
+    Py_ssize_t concurrency = RESOLVER_DEFAULT_CONCURRENCY;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTuple(args, "|n:Resolver", &n_workers))
+        return NULL;
+    if (keywds)  {
+        if ((settings = PyDict_Copy(keywds)) == NULL)
+            return NULL;
+        if ((value = PyDict_GetItemString(settings, "workers")) != NULL)  {
+            if ((n_workers = PyNumber_AsSsize_t(value, PyExc_OverflowError)) == -1 && PyErr_Occurred())
+                goto fail;
+            PyDict_DelItemString(settings, "workers");
+        }
+        if ((value = PyDict_GetItemString(settings, "concurrency")) != NULL)  {
+            if ((concurrency = PyNumber_AsSsize_t(value, PyExc_OverflowError)) == -1 && PyErr_Occurred())
+                goto fail;
+            PyDict_DelItemString(settings, "concurrency");
+        }
+    }
+    if (n_workers == 0)
+        n_workers = (Py_ssize_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_workers < 1 || concurrency < 1)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        goto fail;
+    }
+
+    if ((self = (getdns_ResolverObject *)type->tp_alloc(type, 0)) == NULL)
+        goto fail;
+    self->concurrency = concurrency;
+    if ((self->ready = PyList_New(0)) == NULL ||
+        (self->consumer = PyThread_allocate_lock()) == NULL ||
+        (self->done = PyMem_Malloc(sizeof(pygetdns_resolver_queue))) == NULL ||
+        (self->workers = PyMem_Malloc(n_workers * sizeof(pygetdns_resolver_worker))) == NULL)  {
+        if (!PyErr_Occurred())
+            PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        Py_DECREF(self);
+        goto fail;
+    }
+    memset(self->workers, 0, n_workers * sizeof(pygetdns_resolver_worker));
+    for (i = 0 ; i < n_workers ; i++)
+        self->workers[i].inbox.fds[0] = -1;
+    if (queue_init(self->done) < 0)  {
+        PyErr_SetFromErrno(PyExc_OSError);
+        PyMem_Free(self->done);
+        PyMem_Free(self->workers);
+        self->done = 0;
+        self->workers = 0;
+        Py_DECREF(self);
+        goto fail;
+    }
+    for (i = 0 ; i < n_workers ; i++)  {
+        self->n_workers++;
+        if (worker_start(self, &self->workers[i], settings) < 0)  {
+            Py_DECREF(self);
+            goto fail;
+        }
+    }
+    Py_XDECREF(settings);
+    return (PyObject *)self;
+
+fail:
+    Py_XDECREF(settings);
+    return NULL;
+}
+
+
+/*
+ * stop the workers, which cancel whatever they still have, and
+ * throw away everything that hasn't been collected
+ */
+
+PyObject *
+resolver_close(getdns_ResolverObject *self, PyObject *unused)
+{
+    pygetdns_resolver_worker *w;
+    resolver_job *job;
+    Py_ssize_t i;
+
+    if (self->closed || self->workers == NULL)
+        Py_RETURN_NONE;
+    PYGETDNS_STORE(self->closed, 1);
+    for (i = 0 ; i < self->n_workers ; i++)  {
+        w = &self->workers[i];
+        if (w->running)  {
+            __atomic_store_n(&w->stopping, 1, __ATOMIC_RELEASE);
+            queue_signal(&w->inbox);
+        }
+    }
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0 ; i < self->n_workers ; i++)  {
+        w = &self->workers[i];
+        if (w->running)
+            pthread_join(w->thread, NULL);
+        w->running = 0;
+    }
+    Py_END_ALLOW_THREADS
+
+    queue_signal(self->done);   /* for anyone in resolver_wait() */
+    resolver_consumer_lock(self);
+    queue_rearm(self->done);
+    while ((job = queue_pop(self->done)) != NULL)  {
+        self->pending--;
+        job_free(job);
+    }
+    PyThread_release_lock(self->consumer);
+    for (i = 0 ; i < self->n_workers ; i++)  {
+        w = &self->workers[i];
+        if (w->wake)
+            event_free(w->wake);
+        queue_close(&w->inbox);
+        Py_XDECREF(w->context_obj);
+    }
+    PyMem_Free(self->workers);
+    self->workers = 0;
+    Py_RETURN_NONE;
+}
+
+
+void
+resolver_dealloc(getdns_ResolverObject *self)
+{
+    PyObject *ret;
+
+    if (self->workers)  {
+        if ((ret = resolver_close(self, NULL)) == NULL)
+            PyErr_Clear();
+        Py_XDECREF(ret);
+    }
+    if (self->done)  {
+        queue_close(self->done);
+        PyMem_Free(self->done);
+    }
+    if (self->consumer)
+        PyThread_free_lock(self->consumer);
+    Py_XDECREF(self->ready);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+/*
+ * Resolver.submit(name, request_type, extensions=None, userarg=None)
+ * queues a lookup and returns its id
+ */
+
+PyObject *
+resolver_submit(getdns_ResolverObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "name",
+        "request_type",
+        "extensions",
+        "userarg",
+        0
+    };
+    char *name;
+    uint16_t request_type;
+    PyObject *extensions_obj = 0;
+    PyObject *userarg = 0;
+    getdns_dict *extensions;
+    resolver_job *job;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "sH|OO", kwlist,
+                                     &name, &request_type, &extensions_obj, &userarg))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if (resolver_check(self) < 0)
+        return NULL;
+    if (extensions_get(extensions_obj, &extensions) < 0)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if ((job = job_new(self, name, request_type, extensions_obj, extensions)) == NULL)  {
+        extensions_put(extensions_obj, extensions);
+        return NULL;
+    }
+    if (userarg && userarg != Py_None)  {
+        Py_INCREF(userarg);
+        job->userarg = userarg;
+    }
+    self->pending++;
+    queue_push(&resolver_next_worker(self)->inbox, job);
+    return PyLong_FromUnsignedLongLong((unsigned long long)job->id);
+}
+
+
+/*
+ * Resolver.collect(timeout=None) returns a list of the queries
+ * that have finished, as (type, result, userarg, id), waiting up
+ * to timeout seconds for at least one if none have
+ */
+
+PyObject *
+resolver_collect(getdns_ResolverObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "timeout",
+        0
+    };
+    PyObject *timeout_obj = 0;
+    PyObject *ready;
+    double timeout = -1.0;
+    uint64_t deadline = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O", kwlist, &timeout_obj))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if (timeout_obj && timeout_obj != Py_None)  {
+        if ((timeout = PyFloat_AsDouble(timeout_obj)) == -1.0 && PyErr_Occurred())
+            return NULL;
+        if (timeout != timeout)  {
+            PyErr_SetString(getdns_error, "timeout must not be NaN");
+            return NULL;
+        }
+        if (timeout < 0.0)  {
+            PyErr_SetString(getdns_error, "timeout must not be negative");
+            return NULL;
+        }
+        deadline = context_stats_deadline(timeout);
+    }
+    if (self->done == NULL)  {
+        PyErr_SetString(getdns_error, "Resolver is closed");
+        return NULL;
+    }
+    if (resolver_wait(self, resolver_ready, NULL, deadline) < 0)
+        return NULL;
+    ready = self->ready;
+    if ((self->ready = PyList_New(0)) == NULL)  {
+        self->ready = ready;
+        return NULL;
+    }
+    return ready;
+}
+
+
+/*
+ * Resolver.bulk(queries, extensions=None): as Context.bulk(),
+ * with the queries spread over the workers
+ */
+
+PyObject *
+resolver_bulk(getdns_ResolverObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "queries",
+        "extensions",
+        0
+    };
+    PyObject *queries_obj;
+    PyObject *queries_seq;
+    PyObject *extensions_obj = 0;
+    PyObject *shared = 0;
+    PyObject *results = 0;
+    getdns_dict *extensions;
+    resolver_batch *bulk = 0;
+    resolver_job **jobs = 0;
+    pygetdns_resolver_worker *w;
+    char *name;
+    uint16_t request_type;
+    Py_ssize_t n;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|O", kwlist, &queries_obj, &extensions_obj))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if (resolver_check(self) < 0)
+        return NULL;
+    if ((queries_seq = PySequence_Fast(queries_obj, "queries must be a sequence")) == NULL)
+        return NULL;
+    n = PySequence_Fast_GET_SIZE(queries_seq);
+
+    /*
+     * the jobs share one converted copy of the extensions, which
+     * has to outlive them even if we're interrupted
+     */
+    if (extensions_obj && extensions_obj != Py_None &&
+        !PyObject_TypeCheck(extensions_obj, &getdns_ExtensionsType))  {
+        if ((shared = PyObject_CallFunctionObjArgs((PyObject *)&getdns_ExtensionsType,
+                                                   extensions_obj, NULL)) == NULL)
+            goto done;
+        extensions_obj = shared;
+    }
+    if (extensions_get(extensions_obj, &extensions) < 0)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        goto done;
+    }
+    if ((results = PyList_New(n)) == NULL)
+        goto done;
+    for (i = 0 ; i < n ; i++)  {
+        Py_INCREF(Py_None);
+        PyList_SET_ITEM(results, i, Py_None);
+    }
+    if ((bulk = PyMem_Malloc(sizeof(resolver_batch))) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        Py_CLEAR(results);
+        goto done;
+    }
+    Py_INCREF(results);
+    bulk->results = results;
+    bulk->remaining = n;
+    bulk->refs = 1;
+    if ((jobs = PyMem_Malloc((n + 1) * sizeof(resolver_job *))) == NULL)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
+        Py_CLEAR(results);
+        goto done;
+    }
+
+    for (i = 0 ; i < n ; i++)  {
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(queries_seq, i), "sH", &name, &request_type))  {
+            PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+            break;
+        }
+        if ((jobs[i] = job_new(self, name, request_type, extensions_obj, extensions)) == NULL)
+            break;
+        jobs[i]->bulk = bulk;
+        jobs[i]->slot = i;
+        bulk->refs++;
+    }
+    if (i < n)  {
+        while (i-- > 0)
+            job_free(jobs[i]);
+        Py_CLEAR(results);
+        goto done;
+    }
+
+    /* one wakeup per worker, not per job */
+    for (i = 0 ; i < n ; i++)  {
+        self->pending++;
+        queue_push_job(&self->workers[(self->next_worker + i) % self->n_workers].inbox, jobs[i]);
+    }
+    for (i = 0 ; i < self->n_workers && i < n ; i++)  {
+        w = resolver_next_worker(self);
+        queue_signal(&w->inbox);
+    }
+    if (resolver_wait(self, resolver_batch_done, bulk, 0) < 0)
+        Py_CLEAR(results);
+
+done:
+    if (bulk)
+        bulk_release(bulk);
+    PyMem_Free(jobs);
+    Py_XDECREF(shared);
+    Py_DECREF(queries_seq);
+    return results;
+}
+
+
+PyObject *
+resolver_fileno(getdns_ResolverObject *self, PyObject *unused)
+{
+    if (self->done == NULL)  {
+        PyErr_SetString(getdns_error, "Resolver is closed");
+        return NULL;
+    }
+    return PyLong_FromLong((long)self->done->fds[0]);
+}
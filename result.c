@@ -42,139 +42,450 @@
     #define Py_TYPE(ob)  (((PyObject *)(ob))->ob_type)
 #endif
 
+/*
+ * A Result holds on to the getdns response dict and converts
+ * each attribute the first time it's asked for, so callers who
+ * only look at status or just_address_answers never pay for
+ * converting replies_full and replies_tree.  The Result owns the
+ * response dict and destroys it in result_dealloc(), unless it
+ * was made by result_share(), in which case it holds a reference
+ * to the Result that does.
+ *
+ * Bindata objects point into the response too.  Rather than
+ * holding the Result, which would make a cycle through the
+ * cached attributes that nothing would ever collect, they hold
+ * a capsule wrapping the response dict (the "keeper", made
+ * the first time one's needed), which the Result then holds
+ * instead of the dict.  Whichever goes last destroys the dict.
+ *
+ * Results made from Python, with Result(capsule), work on a copy
+ * of the capsule's dict, which stays its creator's (see
+ * result_copy_response())
+ */
+
+static int result_copy_response(getdns_ResultObject *self, getdns_dict *response);
+
 int
 result_init(getdns_ResultObject *self, PyObject *args, PyObject *keywds)
 {
     PyObject *result_capsule;
     struct getdns_dict *result_dict;
-    int  status;
-    int  answer_type;
-    char *canonical_name;
 
-    if (!PyArg_ParseTuple(args, "|O", &result_capsule))  {
+    if (!PyArg_ParseTuple(args, "O", &result_capsule))  {
         PyErr_SetString(PyExc_AttributeError, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
-        Py_DECREF(self);
-        return -1;
-    }
-    if ((result_dict = PyCapsule_GetPointer(result_capsule, "result")) == NULL)  {
-        PyErr_SetString(PyExc_AttributeError, "Unable to initialize result object");
-        Py_DECREF(self);
-        return -1;
-    }
-    if ((self->replies_full = gdict_to_pdict(result_dict)) == NULL)  {
-        Py_DECREF(self);
         return -1;
     }
-    if ((self->replies_tree = get_replies_tree(result_dict)) == NULL)  {
-        Py_DECREF(self);
+    if (self->response)  {
+        PyErr_SetString(PyExc_AttributeError, "Result object already initialized");
         return -1;
     }
-    if ((status = get_status(result_dict)) == 0)  {
-        Py_DECREF(self);
+    if ((result_dict = PyCapsule_GetPointer(result_capsule, "result")) == NULL)  {
+        PyErr_SetString(PyExc_AttributeError, "Unable to initialize result object");
         return -1;
     }
+    return result_copy_response(self, result_dict);
+}
+
+
+void
+result_dealloc(getdns_ResultObject *self)
+{
+    Py_XDECREF(self->just_address_answers);
+    Py_XDECREF(self->answer_type);
+    Py_XDECREF(self->status);
+    Py_XDECREF(self->replies_tree);
+    Py_XDECREF(self->replies_full);
+    Py_XDECREF(self->canonical_name);
+    Py_XDECREF(self->validation_chain);
+    if (self->owner)
+        Py_DECREF(self->owner);
+    else if (self->keeper)
+        Py_DECREF(self->keeper);
+    else if (self->response)
+        getdns_dict_destroy(self->response);
 #if PY_MAJOR_VERSION >= 3
-    self->status = PyLong_FromLong((long)status);
+    Py_TYPE(self)->tp_free((PyObject *)self);
 #else
-    self->status = PyInt_FromLong((long)status);
+    self->ob_type->tp_free((PyObject *)self);
 #endif
-    if ((answer_type = get_answer_type(result_dict)) == 0)  {
-        Py_DECREF(self);
+}
+
+
+static void
+result_keeper_destroy(PyObject *keeper)
+{
+    getdns_dict_destroy((getdns_dict *)PyCapsule_GetPointer(keeper, RESPONSE_CAPSULE));
+}
+
+
+/*
+ * getdns has no call for copying a dict, but setting one into
+ * another copies it.  The outer dict goes in the keeper, which
+ * frees the copy along with it
+ */
+
+static int
+result_copy_response(getdns_ResultObject *self, getdns_dict *response)
+{
+    getdns_dict *holder;
+    getdns_dict *copy;
+
+    if ((holder = getdns_dict_create()) == NULL ||
+        getdns_dict_set_dict(holder, "response", response) != GETDNS_RETURN_GOOD ||
+        getdns_dict_get_dict(holder, "response", &copy) != GETDNS_RETURN_GOOD)  {
+        getdns_dict_destroy(holder);
+        PyErr_SetString(getdns_error, GETDNS_RETURN_MEMORY_ERROR_TEXT);
         return -1;
     }
+    if ((self->keeper = PyCapsule_New(holder, RESPONSE_CAPSULE, result_keeper_destroy)) == NULL)  {
+        getdns_dict_destroy(holder);
+        return -1;
+    }
+    self->response = copy;
+    return 0;
+}
+
+
+/*
+ * the keeper for result's response, for Bindata to hold (a
+ * borrowed reference).  Shared Results use their origin's, which
+ * threads holding different shares may ask for at once, so it's
+ * made under a mutex rather than the share's critical section
+ */
+
+PYGETDNS_MUTEX(keeper_mutex);
+
+PyObject *
+result_keeper(PyObject *result)
+{
+    getdns_ResultObject *self = (getdns_ResultObject *)result;
+    PyObject *keeper;
+
+    while (self->owner)
+        self = (getdns_ResultObject *)self->owner;
+    if ((keeper = PYGETDNS_LOAD(self->keeper)) == NULL)  {
+        PYGETDNS_MUTEX_LOCK(keeper_mutex);
+        if ((keeper = self->keeper) == NULL)  {
+            keeper = PyCapsule_New(self->response, RESPONSE_CAPSULE, result_keeper_destroy);
+            PYGETDNS_STORE(self->keeper, keeper);
+        }
+        PYGETDNS_MUTEX_UNLOCK(keeper_mutex);
+    }
+    return keeper;
+}
+
+
+static PyObject *
+result_int(struct getdns_dict *response, char *name)
+{
+    uint32_t value;
+
+    if (getdns_dict_get_int(response, name, &value) != GETDNS_RETURN_GOOD)
+        return NULL;
 #if PY_MAJOR_VERSION >= 3
-    self->answer_type = PyLong_FromLong((long)answer_type);
+    return PyLong_FromLong((long)value);
 #else
-    self->answer_type = PyInt_FromLong((long)answer_type);
+    return PyInt_FromLong((long)value);
 #endif
-    if ((canonical_name = get_canonical_name(result_dict)) == 0)  
-        self->canonical_name = Py_None;
-    else
+}
+
+
+static PyObject *
+convert_status(struct getdns_dict *response, PyObject *owner)
+{
+    return result_int(response, "status");
+}
+
+
+static PyObject *
+convert_answer_type(struct getdns_dict *response, PyObject *owner)
+{
+    return result_int(response, "answer_type");
+}
+
+
+static PyObject *
+convert_just_address_answers(struct getdns_dict *response, PyObject *owner)
+{
+    return get_just_address_answers(response);
+}
+
+
+static PyObject *
+convert_canonical_name(struct getdns_dict *response, PyObject *owner)
+{
+    getdns_bindata *canonical_name;
+    char *dname = 0;
+    PyObject *py_name;
+
+    if (getdns_dict_get_bindata(response, "canonical_name", &canonical_name) != GETDNS_RETURN_GOOD)
+        return NULL;
+    if (getdns_convert_dns_name_to_fqdn(canonical_name, &dname) != GETDNS_RETURN_GOOD)
 #if PY_MAJOR_VERSION >= 3
-        self->canonical_name = PyUnicode_FromString(canonical_name);
+        return PyUnicode_FromStringAndSize((char *)canonical_name->data,
+                                           (Py_ssize_t)canonical_name->size);
+    py_name = PyUnicode_FromString(dname);
 #else
-        self->canonical_name = PyString_FromString(canonical_name);
+        return PyString_FromStringAndSize((char *)canonical_name->data,
+                                          (Py_ssize_t)canonical_name->size);
+    py_name = PyString_FromString(dname);
 #endif
-    if ((self->just_address_answers = get_just_address_answers(result_dict)) == NULL)  {
-        self->just_address_answers = Py_None;
+    free(dname);
+    return py_name;
+}
+
+
+/*
+ * hand back the cached attribute, converting it first if this
+ * is the first time through.  Anything missing from the response
+ * is None
+ */
+
+typedef PyObject *(*result_converter)(struct getdns_dict *, PyObject *);
+
+static PyObject *
+result_attr(getdns_ResultObject *self, PyObject **slot, result_converter convert)
+{
+    PyObject *value;
+
+    if (*slot == NULL)  {
+        if (self->response == NULL || (value = convert(self->response, (PyObject *)self)) == NULL)  {
+            if (PyErr_Occurred())
+                return NULL;
+            Py_INCREF(Py_None);
+            value = Py_None;
+        }
+        *slot = value;
     }
-    if ((self->validation_chain = get_validation_chain(result_dict)) == NULL)  
-        self->validation_chain = Py_None;
-    return 0;
+    Py_INCREF(*slot);
+    return *slot;
 }
 
 
 PyObject *
-result_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
-{
-    getdns_ResultObject *self;
-
-    self = (getdns_ResultObject *)type->tp_alloc(type, 0);
-    if (self != NULL)  {
-        self->just_address_answers = Py_None;
-        self->answer_type = Py_None;
-        self->status = Py_None;
-        self->replies_tree = Py_None;
-        self->canonical_name = Py_None;
-        self->replies_full = Py_None;
-        self->validation_chain = Py_None;
-    }
-    return (PyObject *)self;
+result_get_just_address_answers(getdns_ResultObject *self, void *closure)
+{
+    return result_attr(self, &self->just_address_answers, convert_just_address_answers);
+}
+
+
+PyObject *
+result_get_answer_type(getdns_ResultObject *self, void *closure)
+{
+    return result_attr(self, &self->answer_type, convert_answer_type);
 }
 
 
+PyObject *
+result_get_status(getdns_ResultObject *self, void *closure)
+{
+    return result_attr(self, &self->status, convert_status);
+}
+
 
+PyObject *
+result_get_replies_tree(getdns_ResultObject *self, void *closure)
+{
+    return result_attr(self, &self->replies_tree, get_replies_tree);
+}
 
 
-void
-result_dealloc(getdns_ResultObject *self)
+PyObject *
+result_get_canonical_name(getdns_ResultObject *self, void *closure)
 {
-    Py_XDECREF(self->just_address_answers);
-    Py_XDECREF(self->answer_type);
-    Py_XDECREF(self->status);
-    Py_XDECREF(self->replies_tree);
-    Py_XDECREF(self->replies_full);
-    Py_XDECREF(self->canonical_name);
-#if PY_MAJOR_VERSION >= 3
-    Py_TYPE(self)->tp_free((PyObject *)self);
-#else
-    self->ob_type->tp_free((PyObject *)self);
-#endif
+    return result_attr(self, &self->canonical_name, convert_canonical_name);
 }
 
 
 PyObject *
-result_getattro(PyObject *self, PyObject *nameobj)
+result_get_replies_full(getdns_ResultObject *self, void *closure)
 {
-    Py_RETURN_NONE;
+    return result_attr(self, &self->replies_full, gdict_to_pdict);
+}
+
+
+PyObject *
+result_get_validation_chain(getdns_ResultObject *self, void *closure)
+{
+    return result_attr(self, &self->validation_chain, get_validation_chain);
+}
+
+
+/*
+ * A Result exports its first reply, as received, through the
+ * buffer protocol, straight out of the response dict.  Anyone
+ * holding the buffer holds the Result too, so it can't go away
+ * underneath them
+ */
+
+static getdns_bindata *
+result_wire(getdns_ResultObject *self)
+{
+    getdns_list *replies_full;
+    getdns_bindata *wire;
+
+    if (self->response == NULL ||
+        getdns_dict_get_list(self->response, "replies_full", &replies_full) != GETDNS_RETURN_GOOD ||
+        getdns_list_get_bindata(replies_full, 0, &wire) != GETDNS_RETURN_GOOD)
+        return NULL;
+    return wire;
+}
+
+
+int
+result_getbuffer(getdns_ResultObject *self, Py_buffer *view, int flags)
+{
+    getdns_bindata *wire;
+
+    if ((wire = result_wire(self)) == NULL)  {
+        PyErr_SetString(PyExc_BufferError, "Result has no wire-format reply");
+        view->obj = NULL;
+        return -1;
+    }
+    return PyBuffer_FillInfo(view, (PyObject *)self, wire->data, (Py_ssize_t)wire->size,
+                             1, flags);
+}
+
+
+PyObject *
+result_get_wire(getdns_ResultObject *self, void *closure)
+{
+    if (result_wire(self) == NULL)
+        Py_RETURN_NONE;
+    return PyMemoryView_FromObject((PyObject *)self);
+}
+
+
+/*
+ * every reply, where wire only has the first: a tuple of
+ * Bindata pointing into the response, in the order getdns
+ * gave them (A before AAAA for address() lookups)
+ */
+
+PyObject *
+result_get_wires(getdns_ResultObject *self, void *closure)
+{
+    getdns_list *replies_full;
+    getdns_bindata *wire;
+    PyObject *keeper;
+    PyObject *wires;
+    PyObject *item;
+    size_t n = 0;
+    size_t i;
+
+    if (self->response &&
+        getdns_dict_get_list(self->response, "replies_full", &replies_full) == GETDNS_RETURN_GOOD)
+        (void)getdns_list_get_length(replies_full, &n);
+    if ((wires = PyTuple_New((Py_ssize_t)n)) == NULL || n == 0)
+        return wires;
+    if ((keeper = result_keeper((PyObject *)self)) == NULL)  {
+        Py_DECREF(wires);
+        return NULL;
+    }
+    for (i = 0 ; i < n ; i++)  {
+        if (getdns_list_get_bindata(replies_full, i, &wire) != GETDNS_RETURN_GOOD)  {
+            Py_DECREF(wires);
+            PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
+            return NULL;
+        }
+        if ((item = bindata_create(wire, keeper)) == NULL)  {
+            Py_DECREF(wires);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(wires, (Py_ssize_t)i, item);
+    }
+    return wires;
 }
 
 
 PyObject *
 result_str(PyObject *self)
 {
-    getdns_ResultObject *me = (getdns_ResultObject *)self;
     PyObject *cname;
+    PyObject *str;
 
-    cname = me->canonical_name;
-    Py_INCREF(cname);
-    return cname;
+    if ((cname = result_get_canonical_name((getdns_ResultObject *)self, NULL)) == NULL)
+        return NULL;
+    str = PyObject_Str(cname);
+    Py_DECREF(cname);
+    return str;
 }
     
 
 
 /*
- * package up a getdns response dict and use it to
- * build a new Python result object
+ * a new Result for a getdns response dict, which it takes
+ * ownership of.  This is what the query methods use, and it
+ * allocates the Result directly rather than going through the
+ * type's tp_new and tp_init with a capsule and argument tuple
  */
 
+static PyObject *
+result_new(PyTypeObject *type, struct getdns_dict *resp)
+{
+    getdns_ResultObject *result;
+
+    if ((result = (getdns_ResultObject *)type->tp_alloc(type, 0)) == NULL)
+        return NULL;
+    result->response = resp;
+    return (PyObject *)result;
+}
+
+
 PyObject *
 result_create(struct getdns_dict *resp)
 {
-    PyObject *result_capsule;
-    PyObject *args;
+    return result_new(&getdns_ResultType, resp);
+}
+
+
+#ifdef RESULT_VECTORCALL
+
+/*
+ * the Result type's vectorcall constructor, for calls from
+ * Python, which pass a "result" capsule as result_init() takes
+ */
+
+PyObject *
+result_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames)
+{
+    struct getdns_dict *resp;
+    PyObject *result;
+
+    if (PyVectorcall_NARGS(nargsf) != 1 || (kwnames && PyTuple_GET_SIZE(kwnames)))  {
+        PyErr_SetString(PyExc_AttributeError, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if ((resp = PyCapsule_GetPointer(args[0], "result")) == NULL)  {
+        PyErr_SetString(PyExc_AttributeError, "Unable to initialize result object");
+        return NULL;
+    }
+    if ((result = result_new((PyTypeObject *)type, NULL)) == NULL)
+        return NULL;
+    if (result_copy_response((getdns_ResultObject *)result, resp) < 0)  {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+#endif
+
+
+/*
+ * a new, unconverted Result for the same response as origin,
+ * which it keeps alive.  Used to hand out cached responses
+ */
+
+PyObject *
+result_share(PyObject *origin)
+{
+    getdns_ResultObject *result;
 
-    result_capsule = PyCapsule_New(resp, "result", 0);
-    args = Py_BuildValue("(O)", result_capsule);
-    return PyObject_CallObject((PyObject *)&getdns_ResultType, args);
+    if ((result = (getdns_ResultObject *)getdns_ResultType.tp_alloc(&getdns_ResultType, 0)) == NULL)
+        return NULL;
+    result->response = ((getdns_ResultObject *)origin)->response;
+    Py_INCREF(origin);
+    result->owner = origin;
+    return (PyObject *)result;
 }
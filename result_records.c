@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2014, Versign, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Verisign, Include. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <Python.h>
+#if PY_MAJOR_VERSION < 3
+#include <structseq.h>
+#endif
+#include <getdns/getdns.h>
+#include "pygetdns.h"
+
+/*
+ * Result.records(rrtype, section) decodes the records of one
+ * type in one section of each reply straight out of the getdns
+ * response, into struct sequences: tuples whose items can also
+ * be got at by name.  The rdata fields come first, under their
+ * names in replies_tree, followed by the TTL, with the owner
+ * name available as an attribute but not part of the tuple, so
+ * an MX record unpacks as (preference, exchange, ttl).  Types
+ * we don't know the layout of give (rdata_raw, ttl).  Nothing
+ * else in the response is converted.
+ */
+
+#define KIND_INT 'i'            /* integer */
+#define KIND_NAME 'n'           /* domain name, as a str */
+#define KIND_BYTES 'b'          /* bytes */
+#define KIND_STR 's'            /* text, as a str */
+#define KIND_STRINGS 't'        /* list of bindata, as a tuple of bytes */
+
+typedef struct  {
+    uint16_t rrtype;            /* 0 for the catch-all */
+    const char *kinds;          /* one KIND_* per rdata field */
+    PyStructSequence_Desc desc;
+    PyTypeObject type;
+} record_spec;
+
+#define TTL_FIELD { "ttl", "time to live, in seconds" }
+#define NAME_FIELD { "name", "owner name" }
+
+static PyStructSequence_Field mx_fields[] = {
+    { "preference", "preference, lowest first" },
+    { "exchange", "mail exchanger" },
+    TTL_FIELD, NAME_FIELD, { 0 }
+};
+
+static PyStructSequence_Field srv_fields[] = {
+    { "priority", "priority, lowest first" },
+    { "weight", "weight among targets of the same priority" },
+    { "port", "port" },
+    { "target", "target host" },
+    TTL_FIELD, NAME_FIELD, { 0 }
+};
+
+static PyStructSequence_Field txt_fields[] = {
+    { "txt_strings", "tuple of character-strings, as bytes" },
+    TTL_FIELD, NAME_FIELD, { 0 }
+};
+
+static PyStructSequence_Field tlsa_fields[] = {
+    { "certificate_usage", "certificate usage" },
+    { "selector", "selector" },
+    { "matching_type", "matching type" },
+    { "certificate_association_data", "certificate association data, as bytes" },
+    TTL_FIELD, NAME_FIELD, { 0 }
+};
+
+static PyStructSequence_Field caa_fields[] = {
+    { "flags", "flags" },
+    { "tag", "property tag" },
+    { "value", "property value, as bytes" },
+    TTL_FIELD, NAME_FIELD, { 0 }
+};
+
+static PyStructSequence_Field soa_fields[] = {
+    { "mname", "primary name server" },
+    { "rname", "responsible mailbox" },
+    { "serial", "serial number" },
+    { "refresh", "refresh interval" },
+    { "retry", "retry interval" },
+    { "expire", "expiry limit" },
+    { "minimum", "negative caching TTL" },
+    TTL_FIELD, NAME_FIELD, { 0 }
+};
+
+static PyStructSequence_Field raw_fields[] = {
+    { "rdata_raw", "rdata in wire format, as bytes" },
+    TTL_FIELD, NAME_FIELD, { 0 }
+};
+
+static record_spec record_specs[] = {
+    { GETDNS_RRTYPE_MX, "in", { "getdns.MXRecord", "MX record", mx_fields, 3 } },
+    { GETDNS_RRTYPE_SRV, "iiin", { "getdns.SRVRecord", "SRV record", srv_fields, 5 } },
+    { GETDNS_RRTYPE_TXT, "t", { "getdns.TXTRecord", "TXT record", txt_fields, 2 } },
+    { GETDNS_RRTYPE_TLSA, "iiib", { "getdns.TLSARecord", "TLSA record", tlsa_fields, 5 } },
+    { GETDNS_RRTYPE_CAA, "isb", { "getdns.CAARecord", "CAA record", caa_fields, 4 } },
+    { GETDNS_RRTYPE_SOA, "nniiiii", { "getdns.SOARecord", "SOA record", soa_fields, 8 } },
+    { 0, "b", { "getdns.Record", "resource record", raw_fields, 2 } },
+};
+
+#define N_RECORD_SPECS (sizeof(record_specs) / sizeof(record_specs[0]))
+
+
+int
+result_records_init(void)
+{
+    size_t i;
+
+    for (i = 0 ; i < N_RECORD_SPECS ; i++)  {
+#if PY_MAJOR_VERSION >= 3
+        if (PyStructSequence_InitType2(&record_specs[i].type, &record_specs[i].desc) < 0)
+            return -1;
+#else
+        PyStructSequence_InitType(&record_specs[i].type, &record_specs[i].desc);
+#endif
+    }
+    return 0;
+}
+
+
+static record_spec *
+record_spec_for(uint16_t rrtype)
+{
+    size_t i;
+
+    for (i = 0 ; i < N_RECORD_SPECS - 1 ; i++)
+        if (record_specs[i].rrtype == rrtype)
+            return &record_specs[i];
+    return &record_specs[N_RECORD_SPECS - 1];
+}
+
+
+static PyObject *
+record_name(getdns_bindata *data)
+{
+    char *fqdn = 0;
+    PyObject *name;
+
+    if (getdns_convert_dns_name_to_fqdn(data, &fqdn) != GETDNS_RETURN_GOOD)  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_GENERIC_ERROR_TEXT);
+        return NULL;
+    }
+#if PY_MAJOR_VERSION >= 3
+    name = PyUnicode_FromString(fqdn);
+#else
+    name = PyString_FromString(fqdn);
+#endif
+    free(fqdn);
+    return name;
+}
+
+
+static PyObject *
+record_strings(getdns_list *list)
+{
+    size_t length = 0;
+    size_t i;
+    getdns_bindata *data;
+    PyObject *strings;
+    PyObject *string;
+
+    (void)getdns_list_get_length(list, &length);
+    if ((strings = PyTuple_New((Py_ssize_t)length)) == NULL)
+        return NULL;
+    for (i = 0 ; i < length ; i++)  {
+        if (getdns_list_get_bindata(list, i, &data) != GETDNS_RETURN_GOOD)
+            string = PyBytes_FromStringAndSize(NULL, 0);
+        else
+            string = PyBytes_FromStringAndSize((char *)data->data, (Py_ssize_t)data->size);
+        if (string == NULL)  {
+            Py_DECREF(strings);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(strings, (Py_ssize_t)i, string);
+    }
+    return strings;
+}
+
+
+/*
+ * one rdata field.  Fields missing from the rdata are None
+ */
+
+static PyObject *
+record_field(getdns_dict *rdata, const char *key, char kind)
+{
+    uint32_t value;
+    getdns_bindata *data;
+    getdns_list *list;
+
+    switch (kind)  {
+    case KIND_INT:
+        if (getdns_dict_get_int(rdata, key, &value) != GETDNS_RETURN_GOOD)
+            break;
+#if PY_MAJOR_VERSION >= 3
+        return PyLong_FromUnsignedLong((unsigned long)value);
+#else
+        return PyInt_FromLong((long)value);
+#endif
+
+    case KIND_STRINGS:
+        if (getdns_dict_get_list(rdata, key, &list) != GETDNS_RETURN_GOOD)
+            break;
+        return record_strings(list);
+
+    default:
+        if (getdns_dict_get_bindata(rdata, key, &data) != GETDNS_RETURN_GOOD)
+            break;
+        if (kind == KIND_NAME)
+            return record_name(data);
+        if (kind == KIND_STR)
+#if PY_MAJOR_VERSION >= 3
+            return PyUnicode_DecodeUTF8((char *)data->data, (Py_ssize_t)data->size, "replace");
+#else
+            return PyString_FromStringAndSize((char *)data->data, (Py_ssize_t)data->size);
+#endif
+        return PyBytes_FromStringAndSize((char *)data->data, (Py_ssize_t)data->size);
+    }
+    Py_RETURN_NONE;
+}
+
+
+static PyObject *
+record_create(record_spec *spec, getdns_dict *rr)
+{
+    PyObject *record;
+    PyObject *item;
+    getdns_dict *rdata = 0;
+    getdns_bindata *owner;
+    int n_fields = (int)strlen(spec->kinds);
+    int i;
+
+    if ((record = PyStructSequence_New(&spec->type)) == NULL)
+        return NULL;
+    (void)getdns_dict_get_dict(rr, "rdata", &rdata);
+    for (i = 0 ; i < n_fields ; i++)  {
+        if (rdata)
+            item = record_field(rdata, spec->desc.fields[i].name, spec->kinds[i]);
+        else  {
+            Py_INCREF(Py_None);
+            item = Py_None;
+        }
+        if (item == NULL)
+            goto error;
+        PyStructSequence_SET_ITEM(record, i, item);
+    }
+    if ((item = record_field(rr, "ttl", KIND_INT)) == NULL)
+        goto error;
+    PyStructSequence_SET_ITEM(record, n_fields, item);
+    if (getdns_dict_get_bindata(rr, "name", &owner) == GETDNS_RETURN_GOOD)
+        item = record_name(owner);
+    else  {
+        Py_INCREF(Py_None);
+        item = Py_None;
+    }
+    if (item == NULL)
+        goto error;
+    PyStructSequence_SET_ITEM(record, n_fields + 1, item);
+    return record;
+
+error:
+    Py_DECREF(record);
+    return NULL;
+}
+
+
+PyObject *
+result_records(getdns_ResultObject *self, PyObject *args, PyObject *keywds)
+{
+    static char *kwlist[] = {
+        "rrtype",
+        "section",
+        0
+    };
+    long rrtype;
+    char *section = "answer";
+    record_spec *spec;
+    getdns_list *replies_tree;
+    getdns_dict *reply;
+    getdns_list *rrs;
+    getdns_dict *rr;
+    uint32_t type;
+    size_t n_replies = 0;
+    size_t n_rrs;
+    size_t i;
+    size_t j;
+    PyObject *records;
+    PyObject *record;
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "l|s", kwlist, &rrtype, &section))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    if (rrtype < 0 || rrtype > 65535 ||
+        (strcmp(section, "answer") && strcmp(section, "authority") &&
+         strcmp(section, "additional")))  {
+        PyErr_SetString(getdns_error, GETDNS_RETURN_INVALID_PARAMETER_TEXT);
+        return NULL;
+    }
+    spec = record_spec_for((uint16_t)rrtype);
+    if ((records = PyList_New(0)) == NULL)
+        return NULL;
+    if (self->response &&
+        getdns_dict_get_list(self->response, "replies_tree", &replies_tree) == GETDNS_RETURN_GOOD)
+        (void)getdns_list_get_length(replies_tree, &n_replies);
+    for (i = 0 ; i < n_replies ; i++)  {
+        n_rrs = 0;
+        if (getdns_list_get_dict(replies_tree, i, &reply) != GETDNS_RETURN_GOOD ||
+            getdns_dict_get_list(reply, section, &rrs) != GETDNS_RETURN_GOOD)
+            continue;
+        (void)getdns_list_get_length(rrs, &n_rrs);
+        for (j = 0 ; j < n_rrs ; j++)  {
+            if (getdns_list_get_dict(rrs, j, &rr) != GETDNS_RETURN_GOOD ||
+                getdns_dict_get_int(rr, "type", &type) != GETDNS_RETURN_GOOD ||
+                type != (uint32_t)rrtype)
+                continue;
+            if ((record = record_create(spec, rr)) == NULL)
+                goto error;
+            if (PyList_Append(records, record) < 0)  {
+                Py_DECREF(record);
+                goto error;
+            }
+            Py_DECREF(record);
+        }
+    }
+    return records;
+
+error:
+    Py_DECREF(records);
+    return NULL;
+}
@@ -49,7 +49,12 @@ getdns_module = Extension('getdns',
                     libraries = [ 'ldns', 'getdns', 'getdns_ext_event', 'event' ],
                     library_dirs = [ '/usr/local/lib' ],
                     sources = [ 'getdns.c', 'pygetdns_util.c', 'context.c',
-                                'context_util.c', 'result.c' ],
+                                'context_util.c', 'context_args.c', 'context_asyncio.c',
+                                'context_bulk.c', 'context_cache.c', 'context_flight.c',
+                                'context_selector.c', 'context_stats.c', 'context_trace.c',
+                                'result.c', 'result_records.c', 'bindata.c',
+                                'extensions.c', 'context_pool.c', 'resolver.c',
+                                'pygetdns_bench.c' ],
                           extra_compile_args = CFLAGS,
                     runtime_library_dirs = [ '/usr/local/lib' ],
                     )